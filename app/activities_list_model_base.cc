@@ -44,6 +44,15 @@ ActivitiesListModelBase::ActivitiesListModelBase(
       sigc::mem_fun(*this, &ActivitiesListModelBase::AfterObjectAdded)));
   all_connections_.emplace_back(app_state->ConnectBeforeActivityDeleted(
       sigc::mem_fun(*this, &ActivitiesListModelBase::BeforeObjectDeleted)));
+  all_connections_.emplace_back(app_state->ConnectAfterActivitiesAdded(
+      sigc::mem_fun(*this, &ActivitiesListModelBase::AfterActivitiesAdded)));
+}
+
+void ActivitiesListModelBase::AfterActivitiesAdded(
+    const std::vector<Activity>& activities) noexcept {
+  for (const Activity& a : activities) {
+    AfterObjectAdded(a);
+  }
 }
 
 Glib::RefPtr<Gtk::Widget> ActivitiesListModelBase::CreateRowFromObject(
@@ -55,13 +64,10 @@ Glib::RefPtr<Gtk::Widget> ActivitiesListModelBase::CreateRowFromObject(
   g_object_ref_sink(row);
   Glib::RefPtr<Gtk::ListBoxRow> wrapped_row(Glib::wrap(row));
 
-  auto load_result = Task::LoadById(
-      &app_state_->db_for_read_only(),
-      a.task_id());
-  VERIFY(load_result);
-  const Task& t = load_result.value();
+  const TaskRef t = app_state_->tasks().FindById(a.task_id());
+  VERIFY(t);
 
-  const std::string& title = t.name();
+  const std::string& title = t->name();
   hdy_preferences_row_set_title(
       reinterpret_cast<HdyPreferencesRow*>(wrapped_row->gobj()),
       title.c_str());
@@ -102,12 +108,12 @@ void ActivitiesListModelBase::DeleteActivity(
   auto maybe_activity = Activity::LoadById(
       &app_state_->db_for_read_only(), activity_id);
   VERIFY(maybe_activity);
-  auto maybe_task = Task::LoadById(
-      &app_state_->db_for_read_only(), maybe_activity.value().task_id());
-  VERIFY(maybe_task);
+  const TaskRef task = app_state_->tasks().FindById(
+      maybe_activity.value().task_id());
+  VERIFY(task);
   const std::string message =
       (boost::format(_L("Delete activity for task \"%1%\"?")) %
-          maybe_task.value().name()).str();
+          task->name()).str();
   Gtk::MessageDialog message_dlg(
       *parent_window_,
       message,
@@ -45,6 +45,7 @@ class ActivitiesListModelBase: public ListModelBase<Activity> {
   }
 
  private:
+  void AfterActivitiesAdded(const std::vector<Activity>& activities) noexcept;
   void DeleteActivity(Activity::Id activity_id) noexcept;
   void EditActivity(Activity::Id activity_id) noexcept;
 
@@ -4,8 +4,20 @@
 
 #include "app/activity.h"
 
+#include <time.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iterator>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <boost/algorithm/string.hpp>
 
+#include "app/activity_interval_index.h"
+#include "app/daily_task_totals.h"
 #include "app/database.h"
 
 namespace m_time_tracker {
@@ -13,6 +25,87 @@ namespace m_time_tracker {
 namespace {
 constexpr std::string_view kBaseSelectQuery =
     "SELECT id, task_id, start_time, end_time FROM Activities";
+
+// Time spent on tasks during the interval, split into pieces: whole days
+// from DailyTaskTotals between :head_end and :tail_start, and activities
+// clipped to partial days at the interval edges. Scan of activities is
+// limited by the longest activity duration, so it covers only
+// activities, that may overlap edges.
+// Each piece has |day| - start of the time, it belongs to.
+constexpr std::string_view kStatPiecesSubquery = (
+    "(SELECT day, task_id, seconds FROM DailyTaskTotals "
+    "   WHERE day >= :head_end AND day < :tail_start "
+    " UNION ALL "
+    " SELECT :interval_start, task_id, "
+    "   MIN(end_time, :head_end) - MAX(start_time, :interval_start) "
+    "   FROM Activities "
+    "   WHERE start_time < :head_end AND end_time > :interval_start AND "
+    "   start_time > :interval_start - "
+    "       (SELECT MAX(end_time - start_time) FROM Activities) "
+    " UNION ALL "
+    " SELECT :tail_start, task_id, "
+    "   MIN(end_time, :interval_end) - MAX(start_time, :tail_start) "
+    "   FROM Activities "
+    "   WHERE start_time < :interval_end AND end_time > :tail_start AND "
+    "   start_time > :tail_start - "
+    "       (SELECT MAX(end_time - start_time) FROM Activities)"
+    ") AS Pieces");
+
+// Boundaries of whole local days inside the interval, as used in
+// |kStatPiecesSubquery|.
+struct StatDays {
+  Activity::TimePoint head_end;
+  Activity::TimePoint tail_start;
+};
+
+StatDays SplitToWholeDays(
+    const Activity::TimePoint& interval_start,
+    const Activity::TimePoint& interval_end) noexcept {
+  StatDays result;
+  result.head_end = DailyTaskTotals::LocalDayStart(interval_start);
+  if (result.head_end < interval_start) {
+    result.head_end = DailyTaskTotals::NextLocalDayStart(result.head_end);
+  }
+  result.tail_start = DailyTaskTotals::LocalDayStart(interval_end);
+  if (result.head_end > result.tail_start) {
+    // Interval is inside one day, clip all activities to it.
+    result.head_end = interval_end;
+    result.tail_start = interval_end;
+  }
+  return result;
+}
+
+// Start of the bucket of |bucket_kind|, following one, that contains
+// |time_point|. Day boundaries are the same as in DailyTaskTotals.
+Activity::TimePoint NextBucketStart(
+    const Activity::TimePoint& time_point,
+    Activity::BucketKind bucket_kind) noexcept {
+  const std::time_t time_val = static_cast<std::time_t>(
+      time_point.time_since_epoch().count());
+  std::tm local_time{};
+  VERIFY(localtime_r(&time_val, &local_time));
+  switch (bucket_kind) {
+    case Activity::BucketKind::kDay:
+      ++local_time.tm_mday;
+      break;
+    case Activity::BucketKind::kWeek:
+      // tm_wday counts from Sunday; mktime() normalizes day overflow.
+      local_time.tm_mday += 7 - (local_time.tm_wday + 6) % 7;
+      break;
+    case Activity::BucketKind::kMonth:
+      local_time.tm_mday = 1;
+      ++local_time.tm_mon;
+      break;
+  }
+  local_time.tm_hour = 0;
+  local_time.tm_min = 0;
+  local_time.tm_sec = 0;
+  local_time.tm_isdst = -1;
+  const std::time_t result = std::mktime(&local_time);
+  VERIFY(result != -1);
+  return Activity::TimePoint(std::chrono::seconds(result));
+}
+
 }  // namespace
 
 // static
@@ -33,16 +126,16 @@ outcome::std_result<void> Activity::EnsureTableCreated(Database* db) noexcept {
 // static
 outcome::std_result<std::vector<Activity>> Activity::LoadAll(
     Database* db) noexcept {
-  return LoadWithQuery(db, kBaseSelectQuery);
+  return ActivitiesFromSelectResults(db->Select(kBaseSelectQuery));
 }
 
 // static
 outcome::std_result<std::vector<Activity>> Activity::LoadAfter(
     Database* db, const TimePoint& earliest_start_time) noexcept {
   const std::string query = std::string(kBaseSelectQuery) +
-      " WHERE start_time >= " +
-          std::to_string(IntFromTimePoint(earliest_start_time));
-  return LoadWithQuery(db, query);
+      " WHERE start_time >= ?1";
+  return ActivitiesFromSelectResults(
+      db->Select(query, IntFromTimePoint(earliest_start_time)));
 }
 
 // static
@@ -50,18 +143,39 @@ outcome::std_result<std::vector<Activity>> Activity::LoadFiltered(
     Database* db,
     const std::optional<Task::Id> task_id,
     const std::optional<TimePoint> earliest_start_time,
-    const std::optional<TimePoint> latest_start_time) noexcept {
+    const std::optional<TimePoint> latest_start_time,
+    const ActivityIntervalIndex* index) noexcept {
+  if (index) {
+    std::vector<Activity> result;
+    for (const ActivityIntervalIndex::Entry& entry : index->FindFiltered(
+             task_id, earliest_start_time, latest_start_time)) {
+      result.push_back(Activity(
+          entry.id,
+          entry.task_id,
+          TimePointFromInt(entry.start_time),
+          TimePointFromInt(entry.end_time)));
+    }
+    return result;
+  }
+  // Values are bound rather than inlined, so there are at most 8 distinct
+  // query texts and all of them stay in the statement cache.
   std::vector<std::string> conditions;
+  std::unordered_map<std::string, Database::Param> params;
   if (task_id) {
-    conditions.push_back("task_id = " + std::to_string(*task_id));
+    conditions.push_back("task_id = :task_id");
+    params.emplace(":task_id", Database::Param(*task_id));
   }
   if (earliest_start_time) {
-    conditions.push_back("start_time >= " +
-        std::to_string(IntFromTimePoint(*earliest_start_time)));
+    conditions.push_back("start_time >= :earliest_start_time");
+    params.emplace(
+        ":earliest_start_time",
+        Database::Param(IntFromTimePoint(*earliest_start_time)));
   }
   if (latest_start_time) {
-    conditions.push_back("start_time <= " +
-        std::to_string(IntFromTimePoint(*latest_start_time)));
+    conditions.push_back("start_time <= :latest_start_time");
+    params.emplace(
+        ":latest_start_time",
+        Database::Param(IntFromTimePoint(*latest_start_time)));
   }
   std::string query = std::string(kBaseSelectQuery) +
       " WHERE end_time IS NOT NULL ";
@@ -69,67 +183,101 @@ outcome::std_result<std::vector<Activity>> Activity::LoadFiltered(
     query += " AND " + boost::algorithm::join(conditions, " AND ");
   }
 
-  return LoadWithQuery(db, query);
+  return ActivitiesFromSelectResults(db->Select(query, params));
 }
 
 outcome::std_result<void> Activity::Save(Database* db) noexcept {
   VERIFY(!end_time_ || *end_time_ > start_time_);
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  DailyTaskTotals::Changes totals_changes;
+  std::optional<Id> new_id;
   if (id_) {
-    const std::unordered_map<std::string, Database::Param> params = {
-      {":task_id", Database::Param(task_id_)},
-      {":start_time", Database::Param(IntFromTimePoint(start_time_))},
-      {":end_time", Database::Param(IntFromTimePoint(end_time_))},
-      {":id", Database::Param(id_)},
-    };
+    auto subtract_result = SubtractFromTotals(db, *id_, &totals_changes);
+    if (!subtract_result) {
+      return subtract_result.error();
+    }
     auto exec_result = db->Execute(
         "UPDATE Activities SET "
         " task_id=:task_id,"
         " start_time=:start_time,"
         " end_time=:end_time"
         " WHERE id=:id",
-        params);
+        Bind(":task_id", task_id_),
+        Bind(":start_time", IntFromTimePoint(start_time_)),
+        Bind(":end_time", IntFromTimePoint(end_time_)),
+        Bind(":id", *id_));
     if (!exec_result) {
       return exec_result.error();
     }
   } else {
-    const std::unordered_map<std::string, Database::Param> params = {
-      {":task_id", Database::Param(task_id_)},
-      {":start_time", Database::Param(IntFromTimePoint(start_time_))},
-      {":end_time", Database::Param(IntFromTimePoint(end_time_))},
-    };
     auto exec_result = db->Execute(
         "INSERT INTO Activities(task_id, start_time, end_time) VALUES("
         " :task_id,"
         " :start_time,"
         " :end_time"
         ")",
-        params);
+        Bind(":task_id", task_id_),
+        Bind(":start_time", IntFromTimePoint(start_time_)),
+        Bind(":end_time", IntFromTimePoint(end_time_)));
     if (!exec_result) {
       return exec_result.error();
     }
-    id_ = exec_result.value();
+    new_id = exec_result.value();
+  }
+  if (end_time_) {
+    totals_changes.Add(task_id_, start_time_, *end_time_);
+  }
+  auto apply_result = totals_changes.Apply(db);
+  if (!apply_result) {
+    return apply_result.error();
+  }
+  auto commit_result = maybe_transaction.value().Commit();
+  if (!commit_result) {
+    return commit_result.error();
+  }
+  if (new_id) {
+    id_ = new_id;
+  }
+  return outcome::success();
+}
+
+// static
+outcome::std_result<void> Activity::SubtractFromTotals(
+    Database* db,
+    Id id,
+    DailyTaskTotals::Changes* totals_changes) noexcept {
+  const std::string query = std::string(kBaseSelectQuery) +
+      " WHERE id=?1";
+  auto maybe_activities = ActivitiesFromSelectResults(db->Select(query, id));
+  if (!maybe_activities) {
+    return maybe_activities.error();
+  }
+  for (const Activity& activity : maybe_activities.value()) {
+    if (activity.end_time_) {
+      totals_changes->Subtract(
+          activity.task_id_, activity.start_time_, *activity.end_time_);
+    }
   }
   return outcome::success();
 }
 
 // static
-outcome::std_result<std::vector<Activity>> Activity::LoadWithQuery(
-    Database* db, std::string_view query) noexcept {
-  auto maybe_rows = db->Select(query);
+outcome::std_result<std::vector<Activity>>
+    Activity::ActivitiesFromSelectResults(
+        outcome::std_result<SelectRows> maybe_rows) noexcept {
   if (!maybe_rows) {
     return maybe_rows.error();
   }
   SelectRows& rows = maybe_rows.value();
   std::vector<Activity> result;
-  while (true) {
-    const auto next_outcome = rows.NextRow();
-    if (next_outcome == SelectRows::kOutcomeDone) {
-      break;
-    }
-    if (!next_outcome) {
-      return next_outcome.error();
-    }
-    result.emplace_back(CreateFromSelectRow(&rows));
+  for (SelectRows& row : rows) {
+    result.emplace_back(CreateFromSelectRow(&row));
+  }
+  if (!rows.status()) {
+    return rows.status().error();
   }
   return result;
 }
@@ -137,31 +285,95 @@ outcome::std_result<std::vector<Activity>> Activity::LoadWithQuery(
 // static
 // Assumes same column order as specified by kBaseSelectQuery.
 Activity Activity::CreateFromSelectRow(SelectRows* row) noexcept {
-  const std::optional<int64_t> id = row->Int64Column(0);
-  const std::optional<int64_t> task_id = row->Int64Column(1);
-  const std::optional<int64_t> start_time = row->Int64Column(2);
-  const std::optional<int64_t> end_time = row->Int64Column(3);
-  // Check non-null fields.
-  VERIFY(id);
-  VERIFY(task_id);
-  VERIFY(start_time);
+  // Table schema guarantees that only end_time may be NULL.
+  const auto [id, task_id, start_time, end_time] = row->Get<
+      int64_t, int64_t, int64_t, std::optional<int64_t>>();
   std::optional<TimePoint> end_time_point = std::nullopt;
   if (end_time) {
     end_time_point = TimePointFromInt(*end_time);
   }
   return Activity(
-      *id,
-      *task_id,
-      TimePointFromInt(*start_time),
+      id,
+      task_id,
+      TimePointFromInt(start_time),
       end_time_point);
 }
 
+// static
+outcome::std_result<void> Activity::SaveBatch(
+    Database* db, std::vector<Activity>* activities) noexcept {
+  static constexpr size_t kRowsPerInsert = Database::kMaxRowsPerStatement;
+  VERIFY(activities);
+  if (activities->empty()) {
+    return outcome::success();
+  }
+  DailyTaskTotals::Changes totals_changes;
+  for (const Activity& a : *activities) {
+    VERIFY(!a.id_);
+    VERIFY(!a.end_time_ || *a.end_time_ > a.start_time_);
+    if (a.end_time_) {
+      totals_changes.Add(a.task_id_, a.start_time_, *a.end_time_);
+    }
+  }
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  std::string query;
+  std::vector<std::optional<int64_t>> values;
+  values.reserve(std::min(activities->size(), kRowsPerInsert) * 3);
+  std::vector<int64_t> chunk_last_ids;
+  for (size_t chunk_start = 0;
+       chunk_start < activities->size();
+       chunk_start += kRowsPerInsert) {
+    const size_t chunk_size = std::min(
+        kRowsPerInsert, activities->size() - chunk_start);
+    query = "INSERT INTO Activities(task_id, start_time, end_time) VALUES ";
+    values.clear();
+    for (size_t i = chunk_start; i < chunk_start + chunk_size; ++i) {
+      query += (i == chunk_start) ? "(?, ?, ?)" : ", (?, ?, ?)";
+      const Activity& a = (*activities)[i];
+      values.push_back(a.task_id_);
+      values.push_back(IntFromTimePoint(a.start_time_));
+      values.push_back(IntFromTimePoint(a.end_time_));
+    }
+    const auto maybe_last_id = db->ExecuteWithValues(query, values);
+    if (!maybe_last_id) {
+      return maybe_last_id.error();
+    }
+    chunk_last_ids.push_back(maybe_last_id.value());
+  }
+  const auto apply_result = totals_changes.Apply(db);
+  if (!apply_result) {
+    return apply_result.error();
+  }
+  const auto commit_result = maybe_transaction.value().Commit();
+  if (!commit_result) {
+    return commit_result.error();
+  }
+  // Multi-row INSERT runs inside one write transaction, that holds the
+  // single SQLite write lock, so no other connection may take ids in
+  // between and rows of one statement get consecutive ids, ending with
+  // the last insert rowid.
+  for (size_t chunk = 0; chunk < chunk_last_ids.size(); ++chunk) {
+    const size_t chunk_start = chunk * kRowsPerInsert;
+    const size_t chunk_size = std::min(
+        kRowsPerInsert, activities->size() - chunk_start);
+    const Id first_id =
+        chunk_last_ids[chunk] - static_cast<Id>(chunk_size) + 1;
+    for (size_t i = 0; i < chunk_size; ++i) {
+      (*activities)[chunk_start + i].id_ = first_id + static_cast<Id>(i);
+    }
+  }
+  return outcome::success();
+}
+
 // static
 outcome::std_result<Activity> Activity::LoadById(
     Database* db, Id id) noexcept {
   const std::string query = std::string(kBaseSelectQuery) +
-      " WHERE id=" + std::to_string(id);
-  auto maybe_activities = LoadWithQuery(db, query);
+      " WHERE id=?1";
+  auto maybe_activities = ActivitiesFromSelectResults(db->Select(query, id));
   if (!maybe_activities) {
     return maybe_activities.error();
   }
@@ -173,6 +385,38 @@ outcome::std_result<Activity> Activity::LoadById(
   return activities[0];
 }
 
+// static
+outcome::std_result<std::unordered_map<Task::Id, Task::Id>>
+    Activity::LoadStatGroups(
+        Database* db, std::optional<Task::Id> parent_task_id) noexcept {
+  static constexpr std::string_view kQueryForParent = (
+      "SELECT TaskClosure.descendant, TaskClosure.ancestor "
+      " FROM Tasks, TaskClosure "
+      " WHERE Tasks.parent_task_id = :parent_task_id AND "
+      "   TaskClosure.ancestor = Tasks.id");
+  static constexpr std::string_view kQueryForTopLevel = (
+      "SELECT TaskClosure.descendant, TaskClosure.ancestor "
+      " FROM Tasks, TaskClosure "
+      " WHERE Tasks.parent_task_id IS NULL AND "
+      "   TaskClosure.ancestor = Tasks.id");
+  auto maybe_rows = parent_task_id ?
+      db->Select(kQueryForParent, Bind(":parent_task_id", *parent_task_id)) :
+      db->Select(kQueryForTopLevel);
+  if (!maybe_rows) {
+    return maybe_rows.error();
+  }
+  SelectRows& rows = maybe_rows.value();
+  std::unordered_map<Task::Id, Task::Id> result;
+  for (SelectRows& row : rows) {
+    const auto [task_id, group_id] = row.Get<int64_t, int64_t>();
+    result[task_id] = group_id;
+  }
+  if (!rows.status()) {
+    return rows.status().error();
+  }
+  return result;
+}
+
 // static
 outcome::std_result<std::optional<Activity::TimePoint>>
     Activity::LoadEarliestActivityStart(Database* db) noexcept {
@@ -194,17 +438,26 @@ outcome::std_result<std::optional<Activity::TimePoint>>
 
 // static
 outcome::std_result<void> Activity::Delete(Database* db, Id id) noexcept {
-  const std::unordered_map<std::string, Database::Param> params = {
-    {":id", Database::Param(id)},
-  };
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  DailyTaskTotals::Changes totals_changes;
+  auto subtract_result = SubtractFromTotals(db, id, &totals_changes);
+  if (!subtract_result) {
+    return subtract_result.error();
+  }
   auto exec_result = db->Execute(
-      "DELETE FROM Activities WHERE id = :id",
-      params);
-  if (exec_result) {
-    return outcome::success();
-  } else {
+      "DELETE FROM Activities WHERE id = ?1",
+      id);
+  if (!exec_result) {
     return exec_result.error();
   }
+  auto apply_result = totals_changes.Apply(db);
+  if (!apply_result) {
+    return apply_result.error();
+  }
+  return maybe_transaction.value().Commit();
 }
 
 // static
@@ -213,54 +466,352 @@ outcome::std_result<std::vector<Activity::StatEntry>>
         Database* db,
         const TimePoint& interval_start,
         const TimePoint& interval_end,
-        Task::Id parent_task_id) noexcept {
+        Task::Id parent_task_id,
+        const ActivityIntervalIndex* index) noexcept {
   if (interval_start >= interval_end) {
     return std::vector<StatEntry>{};
   }
-  static constexpr std::string_view kQuery = (
-      "SELECT task_id, "
-      " SUM(MIN(end_time, :interval_end) - MAX(start_time, :interval_start)) "
-      " FROM Activities, Tasks "
+  if (index) {
+    return LoadStatsWithIndex(
+        db, *index, interval_start, interval_end, parent_task_id);
+  }
+  // Time of each task is accounted to the child of |parent_task_id|,
+  // whose subtree contains the task. Pieces are summed per task first,
+  // so the hierarchy is joined only once per task.
+  static const std::string kQuery =
+      "SELECT TaskClosure.ancestor AS group_id, SUM(seconds) FROM "
+      " (SELECT task_id, SUM(seconds) AS seconds FROM " +
+      std::string(kStatPiecesSubquery) + " GROUP BY task_id) AS TaskTotals, "
+      " TaskClosure, Tasks "
       " WHERE "
-      " Activities.task_id = Tasks.id AND "
-      " Tasks.parent_task_id = :parent_task_id AND "
-      "((end_time >= :interval_start AND end_time < :interval_end) OR "
-      "  (start_time >= :interval_start AND start_time < :interval_end) OR "
-      "  (start_time < :interval_start AND end_time > :interval_end)) "
-      " GROUP BY task_id");
-  const std::unordered_map<std::string, Database::Param> params = {
-      {":interval_start", Database::Param(IntFromTimePoint(interval_start))},
-      {":interval_end", Database::Param(IntFromTimePoint(interval_end))},
-      {":parent_task_id", Database::Param(parent_task_id)},
-  };
-  return StatsFromSelectResults(db->Select(kQuery, params));
+      " TaskClosure.descendant = TaskTotals.task_id AND "
+      " Tasks.id = TaskClosure.ancestor AND "
+      " Tasks.parent_task_id = :parent_task_id "
+      " GROUP BY group_id "
+      " HAVING SUM(seconds) > 0";
+  const StatDays days = SplitToWholeDays(interval_start, interval_end);
+  return StatsFromSelectResults(db->Select(
+      kQuery,
+      Bind(":interval_start", IntFromTimePoint(interval_start)),
+      Bind(":head_end", IntFromTimePoint(days.head_end)),
+      Bind(":tail_start", IntFromTimePoint(days.tail_start)),
+      Bind(":interval_end", IntFromTimePoint(interval_end)),
+      Bind(":parent_task_id", parent_task_id)));
 }
 
 outcome::std_result<std::vector<Activity::StatEntry>>
     Activity::LoadStatsForTopLevelTasksInInterval(
         Database* db,
         const TimePoint& interval_start,
-        const TimePoint& interval_end) noexcept {
+        const TimePoint& interval_end,
+        const ActivityIntervalIndex* index) noexcept {
   if (interval_start >= interval_end) {
     return std::vector<StatEntry>{};
   }
-  static constexpr std::string_view kQuery = (
-      "SELECT "
-      " (CASE WHEN parent_task_id is not NULL THEN "
-      "    parent_task_id ELSE Tasks.id END) AS group_id,"
-      " SUM(MIN(end_time, :interval_end) - MAX(start_time, :interval_start)) "
-      " FROM Activities, Tasks "
+  if (index) {
+    return LoadStatsWithIndex(
+        db, *index, interval_start, interval_end, std::nullopt);
+  }
+  // Time of each task is accounted to the root of its tree.
+  static const std::string kQuery =
+      "SELECT TaskClosure.ancestor AS group_id, SUM(seconds) FROM "
+      " (SELECT task_id, SUM(seconds) AS seconds FROM " +
+      std::string(kStatPiecesSubquery) + " GROUP BY task_id) AS TaskTotals, "
+      " TaskClosure, Tasks "
       " WHERE "
-      " Activities.task_id = Tasks.id AND "
-      "((end_time >= :interval_start AND end_time < :interval_end) OR "
-      "  (start_time >= :interval_start AND start_time < :interval_end) OR "
-      "  (start_time < :interval_start AND end_time > :interval_end)) "
-      " GROUP BY group_id");
-  const std::unordered_map<std::string, Database::Param> params = {
-      {":interval_start", Database::Param(IntFromTimePoint(interval_start))},
-      {":interval_end", Database::Param(IntFromTimePoint(interval_end))},
+      " TaskClosure.descendant = TaskTotals.task_id AND "
+      " Tasks.id = TaskClosure.ancestor AND "
+      " Tasks.parent_task_id IS NULL "
+      " GROUP BY group_id "
+      " HAVING SUM(seconds) > 0";
+  const StatDays days = SplitToWholeDays(interval_start, interval_end);
+  return StatsFromSelectResults(db->Select(
+      kQuery,
+      Bind(":interval_start", IntFromTimePoint(interval_start)),
+      Bind(":head_end", IntFromTimePoint(days.head_end)),
+      Bind(":tail_start", IntFromTimePoint(days.tail_start)),
+      Bind(":interval_end", IntFromTimePoint(interval_end))));
+}
+
+// static
+outcome::std_result<Activity::TwoLevelStats> Activity::LoadTwoLevelStats(
+    Database* db,
+    const TimePoint& interval_start,
+    const TimePoint& interval_end,
+    std::optional<Task::Id> parent_task_id,
+    const ActivityIntervalIndex* index) noexcept {
+  TwoLevelStats result;
+  if (interval_start >= interval_end) {
+    return result;
+  }
+  std::unordered_map<Task::Id, Duration> task_durations;
+  if (index) {
+    index->AddOverlappingDurations(
+        interval_start, interval_end, &task_durations);
+  } else {
+    static const std::string kQuery =
+        "SELECT task_id, SUM(seconds) FROM " +
+        std::string(kStatPiecesSubquery) + " GROUP BY task_id";
+    const StatDays days = SplitToWholeDays(interval_start, interval_end);
+    auto maybe_rows = db->Select(
+        kQuery,
+        Bind(":interval_start", IntFromTimePoint(interval_start)),
+        Bind(":head_end", IntFromTimePoint(days.head_end)),
+        Bind(":tail_start", IntFromTimePoint(days.tail_start)),
+        Bind(":interval_end", IntFromTimePoint(interval_end)));
+    if (!maybe_rows) {
+      return maybe_rows.error();
+    }
+    SelectRows& rows = maybe_rows.value();
+    for (SelectRows& row : rows) {
+      const auto [task_id, seconds] = row.Get<int64_t, int64_t>();
+      task_durations.emplace(task_id, DurationFromInt(seconds));
+    }
+    if (!rows.status()) {
+      return rows.status().error();
+    }
+  }
+  // Tasks of both levels: children of |parent_task_id| and their
+  // children.
+  static const std::string kLevelsForParent =
+      "(Tasks.parent_task_id = :parent_task_id OR "
+      " Tasks.parent_task_id IN "
+      "   (SELECT id FROM Tasks WHERE parent_task_id = :parent_task_id))";
+  static const std::string kLevelsForTopLevel =
+      "(Tasks.parent_task_id IS NULL OR "
+      " Tasks.parent_task_id IN "
+      "   (SELECT id FROM Tasks WHERE parent_task_id IS NULL))";
+  static const std::string kTasksQueryForParent =
+      "SELECT Tasks.id, Tasks.parent_task_id FROM Tasks WHERE " +
+      kLevelsForParent + " ORDER BY Tasks.id";
+  static const std::string kTasksQueryForTopLevel =
+      "SELECT Tasks.id, Tasks.parent_task_id FROM Tasks WHERE " +
+      kLevelsForTopLevel + " ORDER BY Tasks.id";
+  static const std::string kClosureQueryForParent =
+      "SELECT TaskClosure.descendant, TaskClosure.ancestor "
+      " FROM TaskClosure, Tasks "
+      " WHERE TaskClosure.ancestor = Tasks.id AND " + kLevelsForParent;
+  static const std::string kClosureQueryForTopLevel =
+      "SELECT TaskClosure.descendant, TaskClosure.ancestor "
+      " FROM TaskClosure, Tasks "
+      " WHERE TaskClosure.ancestor = Tasks.id AND " + kLevelsForTopLevel;
+  struct LevelTask {
+    StatEntry stat;
+    std::optional<Task::Id> parent_task_id;
   };
-  return StatsFromSelectResults(db->Select(kQuery, params));
+  // Ordered by id, like results of other stats loaders.
+  std::vector<LevelTask> tasks;
+  {
+    auto maybe_task_rows = parent_task_id ?
+        db->Select(
+            kTasksQueryForParent,
+            Bind(":parent_task_id", *parent_task_id)) :
+        db->Select(kTasksQueryForTopLevel);
+    if (!maybe_task_rows) {
+      return maybe_task_rows.error();
+    }
+    SelectRows& task_rows = maybe_task_rows.value();
+    for (SelectRows& row : task_rows) {
+      const auto [task_id, task_parent_id] =
+          row.Get<int64_t, std::optional<int64_t>>();
+      tasks.push_back(
+          LevelTask{StatEntry(task_id, Duration::zero()), task_parent_id});
+    }
+    if (!task_rows.status()) {
+      return task_rows.status().error();
+    }
+  }
+  std::unordered_map<Task::Id, LevelTask*> level_tasks;
+  for (LevelTask& task : tasks) {
+    level_tasks.emplace(task.stat.task_id, &task);
+  }
+  auto maybe_rows = parent_task_id ?
+      db->Select(
+          kClosureQueryForParent,
+          Bind(":parent_task_id", *parent_task_id)) :
+      db->Select(kClosureQueryForTopLevel);
+  if (!maybe_rows) {
+    return maybe_rows.error();
+  }
+  SelectRows& rows = maybe_rows.value();
+  for (SelectRows& row : rows) {
+    const auto [task_id, group_id] = row.Get<int64_t, int64_t>();
+    const auto it_group = level_tasks.find(group_id);
+    if (it_group == level_tasks.end()) {
+      // Task was added after tasks were loaded.
+      continue;
+    }
+    LevelTask& group = *it_group->second;
+    if (group.parent_task_id == parent_task_id) {
+      result.level.groups[task_id] = group_id;
+    } else {
+      VERIFY(group.parent_task_id);
+      result.child_levels[*group.parent_task_id].groups[task_id] = group_id;
+    }
+    const auto it_duration = task_durations.find(task_id);
+    if (it_duration != task_durations.end()) {
+      group.stat.duration += it_duration->second;
+    }
+  }
+  if (!rows.status()) {
+    return rows.status().error();
+  }
+  for (const LevelTask& task : tasks) {
+    if (task.stat.duration <= Duration::zero()) {
+      continue;
+    }
+    if (task.parent_task_id == parent_task_id) {
+      result.level.stats.push_back(task.stat);
+    } else {
+      result.child_levels[*task.parent_task_id].stats.push_back(task.stat);
+    }
+  }
+  // Only children of listed tasks may be needed for drill-down.
+  for (auto it = result.child_levels.begin();
+       it != result.child_levels.end();) {
+    const bool is_listed = std::any_of(
+        result.level.stats.begin(),
+        result.level.stats.end(),
+        [group_id = it->first](const StatEntry& entry) {
+          return entry.task_id == group_id;
+        });
+    it = is_listed ? std::next(it) : result.child_levels.erase(it);
+  }
+  for (const StatEntry& entry : result.level.stats) {
+    // Ensure level exists even if all time is spent on the task itself.
+    result.child_levels[entry.task_id];
+  }
+  return result;
+}
+
+// static
+outcome::std_result<Activity::BucketedStats> Activity::LoadBucketedStats(
+    Database* db,
+    const TimePoint& interval_start,
+    const TimePoint& interval_end,
+    BucketKind bucket_kind,
+    std::optional<Task::Id> parent_task_id,
+    const ActivityIntervalIndex* index) noexcept {
+  BucketedStats result;
+  for (TimePoint bucket_start = interval_start;
+       bucket_start < interval_end;
+       bucket_start = NextBucketStart(bucket_start, bucket_kind)) {
+    result.bucket_starts.push_back(bucket_start);
+  }
+  if (result.bucket_starts.empty()) {
+    return result;
+  }
+  const auto maybe_groups = LoadStatGroups(db, parent_task_id);
+  if (!maybe_groups) {
+    return maybe_groups.error();
+  }
+  const std::unordered_map<Task::Id, Task::Id>& groups =
+      maybe_groups.value();
+  const size_t bucket_count = result.bucket_starts.size();
+  // Ordered by group id; each value has a duration for each bucket.
+  std::map<Task::Id, std::vector<int64_t>> group_seconds;
+  auto add_seconds = [&](size_t bucket, Task::Id task_id, int64_t seconds) {
+    const auto it = groups.find(task_id);
+    if (it == groups.end()) {
+      return;
+    }
+    std::vector<int64_t>& buckets = group_seconds[it->second];
+    buckets.resize(bucket_count);
+    buckets[bucket] += seconds;
+  };
+  if (index) {
+    std::unordered_map<Task::Id, Duration> task_durations;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+      const TimePoint bucket_end = (bucket + 1 < bucket_count) ?
+          result.bucket_starts[bucket + 1] : interval_end;
+      task_durations.clear();
+      index->AddOverlappingDurations(
+          result.bucket_starts[bucket], bucket_end, &task_durations);
+      for (const auto& [task_id, duration] : task_durations) {
+        add_seconds(bucket, task_id, duration.count());
+      }
+    }
+  } else {
+    // Bucket boundaries are local day starts, so each piece belongs to
+    // exactly one bucket.
+    static const std::string kQuery =
+        "SELECT day, task_id, seconds FROM " +
+        std::string(kStatPiecesSubquery) +
+        " WHERE seconds > 0";
+    const StatDays days = SplitToWholeDays(interval_start, interval_end);
+    auto maybe_rows = db->Select(
+        kQuery,
+        Bind(":interval_start", IntFromTimePoint(interval_start)),
+        Bind(":head_end", IntFromTimePoint(days.head_end)),
+        Bind(":tail_start", IntFromTimePoint(days.tail_start)),
+        Bind(":interval_end", IntFromTimePoint(interval_end)));
+    if (!maybe_rows) {
+      return maybe_rows.error();
+    }
+    SelectRows& rows = maybe_rows.value();
+    for (SelectRows& row : rows) {
+      const auto [day, task_id, seconds] =
+          row.Get<int64_t, int64_t, int64_t>();
+      const auto bucket_it = std::upper_bound(
+          result.bucket_starts.begin(),
+          result.bucket_starts.end(),
+          TimePointFromInt(day));
+      VERIFY(bucket_it != result.bucket_starts.begin());
+      add_seconds(
+          static_cast<size_t>(bucket_it - result.bucket_starts.begin() - 1),
+          task_id,
+          seconds);
+    }
+    if (!rows.status()) {
+      return rows.status().error();
+    }
+  }
+  result.task_ids.reserve(group_seconds.size());
+  for (const auto& [group_id, seconds] : group_seconds) {
+    result.task_ids.push_back(group_id);
+  }
+  result.durations.resize(bucket_count * result.task_ids.size());
+  size_t task_index = 0;
+  for (const auto& [group_id, seconds] : group_seconds) {
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+      result.durations[bucket * result.task_ids.size() + task_index] =
+          DurationFromInt(seconds[bucket]);
+    }
+    ++task_index;
+  }
+  return result;
+}
+
+// static
+outcome::std_result<std::vector<Activity::StatEntry>>
+    Activity::LoadStatsWithIndex(
+        Database* db,
+        const ActivityIntervalIndex& index,
+        const TimePoint& interval_start,
+        const TimePoint& interval_end,
+        std::optional<Task::Id> parent_task_id) noexcept {
+  // Linear pass over in-memory columns is faster than summing daily
+  // totals, so DB is asked only about task hierarchy.
+  std::unordered_map<Task::Id, Duration> task_durations;
+  index.AddOverlappingDurations(interval_start, interval_end, &task_durations);
+  const auto maybe_groups = LoadStatGroups(db, parent_task_id);
+  if (!maybe_groups) {
+    return maybe_groups.error();
+  }
+  // Ordered, like results of GROUP BY.
+  std::map<Task::Id, Duration> group_durations;
+  for (const auto& [task_id, group_id] : maybe_groups.value()) {
+    const auto it = task_durations.find(task_id);
+    if (it != task_durations.end()) {
+      group_durations[group_id] += it->second;
+    }
+  }
+  std::vector<StatEntry> result;
+  result.reserve(group_durations.size());
+  for (const auto& [group_id, duration] : group_durations) {
+    result.emplace_back(group_id, duration);
+  }
+  return result;
 }
 
 // static
@@ -272,19 +823,12 @@ outcome::std_result<std::vector<Activity::StatEntry>>
   }
   SelectRows& rows = maybe_rows.value();
   std::vector<StatEntry> result;
-  while (true) {
-    const auto next_outcome = rows.NextRow();
-    if (next_outcome == SelectRows::kOutcomeDone) {
-      break;
-    }
-    if (!next_outcome) {
-      return next_outcome.error();
-    }
-    const std::optional<int64_t> task_id = rows.Int64Column(0);
-    const std::optional<int64_t> duration = rows.Int64Column(1);
-    VERIFY(task_id);
-    VERIFY(duration);
-    result.emplace_back(*task_id, DurationFromInt(*duration));
+  for (SelectRows& row : rows) {
+    const auto [task_id, duration] = row.Get<int64_t, int64_t>();
+    result.emplace_back(task_id, DurationFromInt(duration));
+  }
+  if (!rows.status()) {
+    return rows.status().error();
   }
   return result;
 }
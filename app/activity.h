@@ -11,6 +11,8 @@
 #include <utility>
 #include <vector>
 
+#include "app/daily_task_totals.h"
+#include "app/database.h"
 #include "app/error_codes.h"
 #include "app/select_rows.h"
 #include "app/task.h"
@@ -18,7 +20,7 @@
 
 namespace m_time_tracker {
 
-class Database;
+class ActivityIntervalIndex;
 
 class Activity {
  public:
@@ -36,6 +38,46 @@ class Activity {
     Duration duration;
   };
 
+  enum class BucketKind {
+    kDay,
+    // Weeks start on Monday.
+    kWeek,
+    kMonth,
+  };
+
+  // Statistics split into consecutive time buckets, that start at local
+  // day, week or month boundaries. The first bucket starts at the start
+  // of the requested interval and the last one ends at its end, so they
+  // may be shorter than others.
+  struct BucketedStats {
+    // Bucket i covers [bucket_starts[i], bucket_starts[i + 1]).
+    std::vector<TimePoint> bucket_starts;
+    // Tasks, that have non-zero duration in any bucket, sorted by id.
+    std::vector<Task::Id> task_ids;
+    // Row-major [bucket][task] matrix, rows follow |bucket_starts|,
+    // columns follow |task_ids|.
+    std::vector<Duration> durations;
+
+    Duration duration(size_t bucket, size_t task_index) const noexcept {
+      VERIFY(bucket < bucket_starts.size());
+      VERIFY(task_index < task_ids.size());
+      return durations[bucket * task_ids.size() + task_index];
+    }
+  };
+
+  // Statistics of one drill-down level.
+  struct StatsLevel {
+    std::vector<StatEntry> stats;
+    // See LoadStatGroups.
+    std::unordered_map<Task::Id, Task::Id> groups;
+  };
+
+  struct TwoLevelStats {
+    StatsLevel level;
+    // Level of children of each task, listed in |level|.
+    std::unordered_map<Task::Id, StatsLevel> child_levels;
+  };
+
   static outcome::std_result<void> EnsureTableCreated(Database* db) noexcept;
 
   // Useful for tests.
@@ -49,35 +91,79 @@ class Activity {
   // Any of the optional arguments may be absent - in that case no filtering
   // on this criteria performed.
   // Not completed activities are not accounted.
+  // If |index| is provided, activities are taken from it instead of DB.
   static outcome::std_result<std::vector<Activity>> LoadFiltered(
       Database* db,
       const std::optional<Task::Id> task_id,
       const std::optional<TimePoint> earliest_start_time,
-      const std::optional<TimePoint> latest_start_time) noexcept;
+      const std::optional<TimePoint> latest_start_time,
+      const ActivityIntervalIndex* index = nullptr) noexcept;
   static outcome::std_result<Activity> LoadById(Database* db, Id id) noexcept;
 
   // Returns statistics for specified interval.
   // If some Activity overlaps interval boundary, only part of the
   // activity that in the boundary will be accounted.
   // Not completed activities are not accounted.
-  // Only children of specified parent task is accounted.
+  // Only children of specified parent task are listed; each child
+  // accounts time of its whole subtree.
+  // Whole local days are summed from DailyTaskTotals, so cost depends
+  // on number of days rather than number of activities in the interval.
+  // If |index| is provided, all activities are summed from it instead,
+  // in a single pass, that is faster than summing daily totals.
   static outcome::std_result<std::vector<StatEntry>>
       LoadStatsForInterval(
           Database* db,
           const TimePoint& interval_start,
           const TimePoint& interval_end,
-          Task::Id parent_task_id) noexcept;
-  // Like LoadStatsForInterval, but accounts only tasks without children.
+          Task::Id parent_task_id,
+          const ActivityIntervalIndex* index = nullptr) noexcept;
+  // Like LoadStatsForInterval, but lists top-level tasks, each accounting
+  // time of its whole tree.
   static outcome::std_result<std::vector<StatEntry>>
       LoadStatsForTopLevelTasksInInterval(
           Database* db,
           const TimePoint& interval_start,
-          const TimePoint& interval_end) noexcept;
+          const TimePoint& interval_end,
+          const ActivityIntervalIndex* index = nullptr) noexcept;
+  // Like LoadStatsForInterval or, if |parent_task_id| is not set, like
+  // LoadStatsForTopLevelTasksInInterval, but with separate totals for
+  // each bucket of |bucket_kind|. Activities, crossing bucket boundaries,
+  // are split between buckets. All buckets are filled by a single query
+  // or, with |index|, by a single pass over in-memory activities.
+  static outcome::std_result<BucketedStats> LoadBucketedStats(
+      Database* db,
+      const TimePoint& interval_start,
+      const TimePoint& interval_end,
+      BucketKind bucket_kind,
+      std::optional<Task::Id> parent_task_id,
+      const ActivityIntervalIndex* index = nullptr) noexcept;
+  // Like LoadStatsForInterval or, if |parent_task_id| is not set, like
+  // LoadStatsForTopLevelTasksInInterval, but statistics of children of
+  // each listed task are loaded too, so drill-down needs no more queries.
+  // Time of each task is summed once, by a single query or from |index|,
+  // and then accounted to groups of both levels.
+  static outcome::std_result<TwoLevelStats> LoadTwoLevelStats(
+      Database* db,
+      const TimePoint& interval_start,
+      const TimePoint& interval_end,
+      std::optional<Task::Id> parent_task_id,
+      const ActivityIntervalIndex* index = nullptr) noexcept;
+  // Maps ids of tasks, accounted in statistics, to ids of their groups:
+  // children of |parent_task_id|, if it is set, or top-level tasks
+  // otherwise. Each group accounts its whole subtree. Useful for keeping
+  // loaded statistics up to date without reloading them.
+  static outcome::std_result<std::unordered_map<Task::Id, Task::Id>>
+      LoadStatGroups(
+          Database* db, std::optional<Task::Id> parent_task_id) noexcept;
   static outcome::std_result<std::optional<TimePoint>>
       LoadEarliestActivityStart(Database* db) noexcept;
   static outcome::std_result<void> Delete(Database* db, Id id) noexcept;
 
   outcome::std_result<void> Save(Database* db) noexcept;
+  // Inserts new |activities| with few multi-row INSERT statements in one
+  // transaction. Ids are assigned only if all of them were saved.
+  static outcome::std_result<void> SaveBatch(
+      Database* db, std::vector<Activity>* activities) noexcept;
 
   Activity(const Task& task, const TimePoint& start_time) noexcept
      : start_time_(start_time) {
@@ -148,12 +234,27 @@ class Activity {
         start_time_(start_time),
         end_time_(end_time) {}
 
-  static outcome::std_result<std::vector<Activity>> LoadWithQuery(
-      Database* db, std::string_view query) noexcept;
+  static outcome::std_result<std::vector<Activity>>
+      ActivitiesFromSelectResults(
+          outcome::std_result<SelectRows> maybe_rows) noexcept;
   static Activity CreateFromSelectRow(SelectRows* row) noexcept;
   static outcome::std_result<std::vector<Activity::StatEntry>>
       StatsFromSelectResults(
           outcome::std_result<SelectRows> maybe_rows) noexcept;
+  // Loads stats for tasks, grouped either by parent task or, if
+  // |parent_task_id| is set, only for its children. Activities are taken
+  // from |index|; DB provides only task hierarchy.
+  static outcome::std_result<std::vector<StatEntry>> LoadStatsWithIndex(
+      Database* db,
+      const ActivityIntervalIndex& index,
+      const TimePoint& interval_start,
+      const TimePoint& interval_end,
+      std::optional<Task::Id> parent_task_id) noexcept;
+  // Records removal of saved activity |id| from daily totals.
+  static outcome::std_result<void> SubtractFromTotals(
+      Database* db,
+      Id id,
+      DailyTaskTotals::Changes* totals_changes) noexcept;
 
   static Duration DurationFromInt(int64_t duration) noexcept {
     return std::chrono::seconds(duration);
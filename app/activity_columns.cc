@@ -0,0 +1,252 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/activity_columns.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define TIME_KEEPER_HAS_AVX2_KERNEL 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define TIME_KEEPER_HAS_NEON_KERNEL 1
+#endif
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+// Arguments of all kernels. Kernels add clipped duration of each row
+// to |slot_durations[task_slots[i]]|; rows that do not overlap the
+// interval add zero.
+struct KernelArgs {
+  const int64_t* start_times;
+  const int64_t* end_times;
+  const uint32_t* task_slots;
+  size_t count;
+  int64_t interval_start;
+  int64_t interval_end;
+  int64_t* slot_durations;
+};
+
+void AddClippedDurationsScalar(const KernelArgs& args) noexcept {
+  for (size_t i = 0; i < args.count; ++i) {
+    const int64_t duration =
+        std::min(args.end_times[i], args.interval_end) -
+        std::max(args.start_times[i], args.interval_start);
+    if (duration > 0) {
+      args.slot_durations[args.task_slots[i]] += duration;
+    }
+  }
+}
+
+KernelArgs SkipRows(const KernelArgs& args, size_t rows) noexcept {
+  return KernelArgs{
+      args.start_times + rows,
+      args.end_times + rows,
+      args.task_slots + rows,
+      args.count - rows,
+      args.interval_start,
+      args.interval_end,
+      args.slot_durations};
+}
+
+// Vector kernels process rows in whole vectors and return number of
+// processed rows; the rest is left to the scalar kernel.
+#if defined(TIME_KEEPER_HAS_AVX2_KERNEL)
+
+// AVX2 has no 64-bit min/max, so they are made of compare and blend.
+__attribute__((target("avx2")))
+size_t AddClippedDurationsAvx2(const KernelArgs& args) noexcept {
+  constexpr size_t kLanes = 4;
+  const __m256i interval_start = _mm256_set1_epi64x(args.interval_start);
+  const __m256i interval_end = _mm256_set1_epi64x(args.interval_end);
+  const __m256i zero = _mm256_setzero_si256();
+  alignas(32) int64_t durations[kLanes];
+  size_t i = 0;
+  for (; i + kLanes <= args.count; i += kLanes) {
+    const __m256i start = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(args.start_times + i));
+    const __m256i end = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(args.end_times + i));
+    const __m256i clipped_start = _mm256_blendv_epi8(
+        start, interval_start, _mm256_cmpgt_epi64(interval_start, start));
+    const __m256i clipped_end = _mm256_blendv_epi8(
+        end, interval_end, _mm256_cmpgt_epi64(end, interval_end));
+    __m256i duration = _mm256_sub_epi64(clipped_end, clipped_start);
+    duration = _mm256_and_si256(
+        duration, _mm256_cmpgt_epi64(duration, zero));
+    _mm256_store_si256(reinterpret_cast<__m256i*>(durations), duration);
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      args.slot_durations[args.task_slots[i + lane]] += durations[lane];
+    }
+  }
+  return i;
+}
+
+bool CpuSupportsAvx2() noexcept {
+  static const bool result = __builtin_cpu_supports("avx2");
+  return result;
+}
+
+#elif defined(TIME_KEEPER_HAS_NEON_KERNEL)
+
+size_t AddClippedDurationsNeon(const KernelArgs& args) noexcept {
+  constexpr size_t kLanes = 2;
+  const int64x2_t interval_start = vdupq_n_s64(args.interval_start);
+  const int64x2_t interval_end = vdupq_n_s64(args.interval_end);
+  const int64x2_t zero = vdupq_n_s64(0);
+  int64_t durations[kLanes];
+  size_t i = 0;
+  for (; i + kLanes <= args.count; i += kLanes) {
+    const int64x2_t start = vld1q_s64(args.start_times + i);
+    const int64x2_t end = vld1q_s64(args.end_times + i);
+    const int64x2_t clipped_start = vbslq_s64(
+        vcgtq_s64(interval_start, start), interval_start, start);
+    const int64x2_t clipped_end = vbslq_s64(
+        vcgtq_s64(end, interval_end), interval_end, end);
+    const int64x2_t duration = vsubq_s64(clipped_end, clipped_start);
+    vst1q_s64(
+        durations,
+        vbslq_s64(vcgtq_s64(duration, zero), duration, zero));
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      args.slot_durations[args.task_slots[i + lane]] += durations[lane];
+    }
+  }
+  return i;
+}
+
+#endif
+
+void AddClippedDurationsKernel(const KernelArgs& args) noexcept {
+  size_t processed_rows = 0;
+#if defined(TIME_KEEPER_HAS_AVX2_KERNEL)
+  if (CpuSupportsAvx2()) {
+    processed_rows = AddClippedDurationsAvx2(args);
+  }
+#elif defined(TIME_KEEPER_HAS_NEON_KERNEL)
+  processed_rows = AddClippedDurationsNeon(args);
+#endif
+  AddClippedDurationsScalar(SkipRows(args, processed_rows));
+}
+
+template<typename T>
+void EraseAt(std::vector<T>* column, size_t index) noexcept {
+  column->erase(column->begin() + static_cast<ptrdiff_t>(index));
+}
+
+template<typename T>
+void InsertAt(std::vector<T>* column, size_t index, T value) noexcept {
+  column->insert(column->begin() + static_cast<ptrdiff_t>(index), value);
+}
+
+}  // namespace
+
+// static
+outcome::std_result<ActivityColumns> ActivityColumns::Load(
+    Database* db) noexcept {
+  ActivityColumns result;
+  auto maybe_rows = db->Select(
+      "SELECT id, task_id, start_time, end_time FROM Activities "
+      " WHERE end_time IS NOT NULL ORDER BY start_time");
+  if (!maybe_rows) {
+    return maybe_rows.error();
+  }
+  SelectRows& rows = maybe_rows.value();
+  for (SelectRows& row : rows) {
+    const auto [id, task_id, start_time, end_time] =
+        row.Get<int64_t, int64_t, int64_t, int64_t>();
+    result.Append(Row{id, task_id, start_time, end_time});
+  }
+  if (!rows.status()) {
+    return rows.status().error();
+  }
+  return result;
+}
+
+ActivityColumns::Row ActivityColumns::row(size_t index) const noexcept {
+  VERIFY(index < size());
+  return Row{
+      ids_[index], task_ids_[index], start_times_[index], end_times_[index]};
+}
+
+void ActivityColumns::Insert(size_t index, const Row& row) noexcept {
+  VERIFY(index <= size());
+  const uint32_t task_slot = GetTaskSlot(row.task_id);
+  InsertAt(&ids_, index, row.id);
+  InsertAt(&task_ids_, index, row.task_id);
+  InsertAt(&start_times_, index, row.start_time);
+  InsertAt(&end_times_, index, row.end_time);
+  InsertAt(&task_slots_, index, task_slot);
+}
+
+void ActivityColumns::Append(const Row& row) noexcept {
+  const uint32_t task_slot = GetTaskSlot(row.task_id);
+  ids_.push_back(row.id);
+  task_ids_.push_back(row.task_id);
+  start_times_.push_back(row.start_time);
+  end_times_.push_back(row.end_time);
+  task_slots_.push_back(task_slot);
+}
+
+void ActivityColumns::Erase(size_t index) noexcept {
+  VERIFY(index < size());
+  EraseAt(&ids_, index);
+  EraseAt(&task_ids_, index);
+  EraseAt(&start_times_, index);
+  EraseAt(&end_times_, index);
+  EraseAt(&task_slots_, index);
+}
+
+void ActivityColumns::Truncate(size_t new_size) noexcept {
+  VERIFY(new_size <= size());
+  ids_.resize(new_size);
+  task_ids_.resize(new_size);
+  start_times_.resize(new_size);
+  end_times_.resize(new_size);
+  task_slots_.resize(new_size);
+}
+
+void ActivityColumns::AddClippedDurations(
+    size_t first_row,
+    size_t last_row,
+    int64_t interval_start,
+    int64_t interval_end,
+    std::unordered_map<Task::Id, Activity::Duration>* task_durations)
+    const noexcept {
+  VERIFY(task_durations);
+  VERIFY(first_row <= last_row && last_row <= size());
+  if (first_row == last_row || interval_start >= interval_end) {
+    return;
+  }
+  std::vector<int64_t> slot_durations(slot_task_ids_.size(), 0);
+  AddClippedDurationsKernel(KernelArgs{
+      start_times_.data() + first_row,
+      end_times_.data() + first_row,
+      task_slots_.data() + first_row,
+      last_row - first_row,
+      interval_start,
+      interval_end,
+      slot_durations.data()});
+  for (size_t slot = 0; slot < slot_durations.size(); ++slot) {
+    if (slot_durations[slot] > 0) {
+      (*task_durations)[slot_task_ids_[slot]] +=
+          Activity::Duration(slot_durations[slot]);
+    }
+  }
+}
+
+uint32_t ActivityColumns::GetTaskSlot(Task::Id task_id) noexcept {
+  const auto [it, inserted] = slots_by_task_id_.try_emplace(
+      task_id, static_cast<uint32_t>(slot_task_ids_.size()));
+  if (inserted) {
+    slot_task_ids_.push_back(task_id);
+  }
+  return it->second;
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,88 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "app/activity.h"
+#include "app/database.h"
+#include "app/error_codes.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+// Completed activities, stored as contiguous columns sorted by start time,
+// so durations of millions of activities are summed in one linear pass
+// with SIMD instructions.
+class ActivityColumns {
+ public:
+  struct Row {
+    Activity::Id id;
+    Task::Id task_id;
+    int64_t start_time;
+    int64_t end_time;
+  };
+
+  static outcome::std_result<ActivityColumns> Load(Database* db) noexcept;
+
+  ActivityColumns() = default;
+
+  size_t size() const noexcept {
+    return start_times_.size();
+  }
+
+  const std::vector<int64_t>& ids() const noexcept {
+    return ids_;
+  }
+
+  const std::vector<int64_t>& task_ids() const noexcept {
+    return task_ids_;
+  }
+
+  const std::vector<int64_t>& start_times() const noexcept {
+    return start_times_;
+  }
+
+  const std::vector<int64_t>& end_times() const noexcept {
+    return end_times_;
+  }
+
+  Row row(size_t index) const noexcept;
+
+  // Callers are responsible for keeping rows sorted by start time.
+  void Insert(size_t index, const Row& row) noexcept;
+  void Append(const Row& row) noexcept;
+  void Erase(size_t index) noexcept;
+  // Erases all rows starting from |new_size|.
+  void Truncate(size_t new_size) noexcept;
+
+  // For each row in [first_row, last_row), adds
+  //   min(end_time, interval_end) - max(start_time, interval_start)
+  // to the duration of its task, if the row overlaps the interval.
+  void AddClippedDurations(
+      size_t first_row,
+      size_t last_row,
+      int64_t interval_start,
+      int64_t interval_end,
+      std::unordered_map<Task::Id, Activity::Duration>* task_durations)
+      const noexcept;
+
+ private:
+  uint32_t GetTaskSlot(Task::Id task_id) noexcept;
+
+  std::vector<int64_t> ids_;
+  std::vector<int64_t> task_ids_;
+  std::vector<int64_t> start_times_;
+  std::vector<int64_t> end_times_;
+  // Dense numbers of tasks, so kernels accumulate durations in an array
+  // instead of a hash map. Slots are never freed; there are few tasks.
+  std::vector<uint32_t> task_slots_;
+  std::vector<Task::Id> slot_task_ids_;
+  std::unordered_map<Task::Id, uint32_t> slots_by_task_id_;
+};
+
+}  // namespace m_time_tracker
@@ -0,0 +1,228 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/activity_interval_index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+bool StartsBefore(
+    const ActivityIntervalIndex::Entry& first,
+    const ActivityIntervalIndex::Entry& second) noexcept {
+  return first.start_time < second.start_time;
+}
+
+}  // namespace
+
+// static
+outcome::std_result<std::unique_ptr<ActivityIntervalIndex>>
+    ActivityIntervalIndex::Load(Database* db) noexcept {
+  auto maybe_columns = ActivityColumns::Load(db);
+  if (!maybe_columns) {
+    return maybe_columns.error();
+  }
+  return std::unique_ptr<ActivityIntervalIndex>(
+      new ActivityIntervalIndex(std::move(maybe_columns.value())));
+}
+
+ActivityIntervalIndex::ActivityIntervalIndex(
+    ActivityColumns columns) noexcept
+    : columns_(std::move(columns)) {
+  VERIFY(std::is_sorted(
+      columns_.start_times().begin(), columns_.start_times().end()));
+  UpdateMaxEndTimesLocked(0);
+}
+
+void ActivityIntervalIndex::Add(const Activity& activity) noexcept {
+  if (!activity.end_time()) {
+    return;
+  }
+  std::unique_lock lock(mutex_);
+  InsertLocked(EntryFromActivity(activity));
+}
+
+void ActivityIntervalIndex::AddBatch(
+    const std::vector<Activity>& activities) noexcept {
+  std::vector<Entry> new_entries;
+  for (const Activity& activity : activities) {
+    if (activity.end_time()) {
+      new_entries.push_back(EntryFromActivity(activity));
+    }
+  }
+  if (new_entries.empty()) {
+    return;
+  }
+  std::stable_sort(new_entries.begin(), new_entries.end(), &StartsBefore);
+  std::unique_lock lock(mutex_);
+  const std::vector<int64_t>& start_times = columns_.start_times();
+  // Typically all new activities are later than existing ones, so
+  // nothing is moved.
+  const size_t merge_start = static_cast<size_t>(std::upper_bound(
+      start_times.begin(), start_times.end(),
+      new_entries.front().start_time) - start_times.begin());
+  std::vector<Entry> moved_entries;
+  for (size_t i = merge_start; i < columns_.size(); ++i) {
+    moved_entries.push_back(columns_.row(i));
+  }
+  columns_.Truncate(merge_start);
+  std::vector<Entry> merged_entries;
+  merged_entries.reserve(moved_entries.size() + new_entries.size());
+  std::merge(
+      moved_entries.begin(), moved_entries.end(),
+      new_entries.begin(), new_entries.end(),
+      std::back_inserter(merged_entries),
+      &StartsBefore);
+  for (const Entry& entry : merged_entries) {
+    columns_.Append(entry);
+  }
+  UpdateMaxEndTimesLocked(merge_start);
+}
+
+void ActivityIntervalIndex::Update(const Activity& activity) noexcept {
+  VERIFY(activity.id());
+  std::unique_lock lock(mutex_);
+  RemoveLocked(*activity.id(), std::nullopt);
+  if (activity.end_time()) {
+    InsertLocked(EntryFromActivity(activity));
+  }
+}
+
+void ActivityIntervalIndex::Remove(const Activity& activity) noexcept {
+  VERIFY(activity.id());
+  std::unique_lock lock(mutex_);
+  RemoveLocked(
+      *activity.id(), Activity::IntFromTimePoint(activity.start_time()));
+}
+
+void ActivityIntervalIndex::AddOverlappingDurations(
+    const Activity::TimePoint& interval_start,
+    const Activity::TimePoint& interval_end,
+    std::unordered_map<Task::Id, Activity::Duration>* task_durations)
+    const noexcept {
+  VERIFY(task_durations);
+  if (interval_start >= interval_end) {
+    return;
+  }
+  const int64_t start = Activity::IntFromTimePoint(interval_start);
+  const int64_t end = Activity::IntFromTimePoint(interval_end);
+  std::shared_lock lock(mutex_);
+  // All entries before |first| end before the interval.
+  const size_t first = static_cast<size_t>(std::upper_bound(
+      max_end_times_.begin(), max_end_times_.end(), start) -
+          max_end_times_.begin());
+  // All entries starting from |last| start after the interval.
+  const std::vector<int64_t>& start_times = columns_.start_times();
+  const size_t last = static_cast<size_t>(std::lower_bound(
+      start_times.begin(), start_times.end(), end) - start_times.begin());
+  if (first < last) {
+    columns_.AddClippedDurations(first, last, start, end, task_durations);
+  }
+}
+
+std::vector<ActivityIntervalIndex::Entry> ActivityIntervalIndex::FindFiltered(
+    const std::optional<Task::Id> task_id,
+    const std::optional<Activity::TimePoint> earliest_start_time,
+    const std::optional<Activity::TimePoint> latest_start_time)
+    const noexcept {
+  std::vector<Entry> result;
+  std::shared_lock lock(mutex_);
+  const std::vector<int64_t>& start_times = columns_.start_times();
+  auto it = start_times.begin();
+  if (earliest_start_time) {
+    it = std::lower_bound(
+        start_times.begin(), start_times.end(),
+        Activity::IntFromTimePoint(*earliest_start_time));
+  }
+  auto end = start_times.end();
+  if (latest_start_time) {
+    end = std::upper_bound(
+        it, start_times.end(),
+        Activity::IntFromTimePoint(*latest_start_time));
+  }
+  const std::vector<int64_t>& task_ids = columns_.task_ids();
+  for (auto i = static_cast<size_t>(it - start_times.begin());
+       i < static_cast<size_t>(end - start_times.begin());
+       ++i) {
+    if (!task_id || task_ids[i] == *task_id) {
+      result.push_back(columns_.row(i));
+    }
+  }
+  return result;
+}
+
+size_t ActivityIntervalIndex::size() const noexcept {
+  std::shared_lock lock(mutex_);
+  return columns_.size();
+}
+
+// static
+ActivityIntervalIndex::Entry ActivityIntervalIndex::EntryFromActivity(
+    const Activity& activity) noexcept {
+  VERIFY(activity.id());
+  VERIFY(activity.end_time());
+  return Entry{
+      *activity.id(),
+      activity.task_id(),
+      Activity::IntFromTimePoint(activity.start_time()),
+      Activity::IntFromTimePoint(*activity.end_time())};
+}
+
+void ActivityIntervalIndex::InsertLocked(const Entry& entry) noexcept {
+  const std::vector<int64_t>& start_times = columns_.start_times();
+  const size_t index = static_cast<size_t>(std::upper_bound(
+      start_times.begin(), start_times.end(), entry.start_time) -
+          start_times.begin());
+  columns_.Insert(index, entry);
+  UpdateMaxEndTimesLocked(index);
+}
+
+void ActivityIntervalIndex::RemoveLocked(
+    Activity::Id id, std::optional<int64_t> start_time_hint) noexcept {
+  const std::vector<int64_t>& start_times = columns_.start_times();
+  const std::vector<int64_t>& ids = columns_.ids();
+  auto range_begin = ids.begin();
+  auto range_end = ids.end();
+  if (start_time_hint) {
+    const auto [first, last] = std::equal_range(
+        start_times.begin(), start_times.end(), *start_time_hint);
+    range_begin = ids.begin() + (first - start_times.begin());
+    range_end = ids.begin() + (last - start_times.begin());
+  }
+  auto it = std::find(range_begin, range_end, id);
+  if (it == range_end && start_time_hint) {
+    // Hint is stale, fall back to the full scan.
+    it = std::find(ids.begin(), ids.end(), id);
+    range_end = ids.end();
+  }
+  if (it == range_end) {
+    // Activity was not completed, so it was not indexed.
+    return;
+  }
+  const size_t index = static_cast<size_t>(it - ids.begin());
+  columns_.Erase(index);
+  UpdateMaxEndTimesLocked(index);
+}
+
+void ActivityIntervalIndex::UpdateMaxEndTimesLocked(
+    size_t first_index) noexcept {
+  const std::vector<int64_t>& end_times = columns_.end_times();
+  max_end_times_.resize(end_times.size());
+  int64_t max_end_time = (first_index == 0) ?
+      std::numeric_limits<int64_t>::min() : max_end_times_[first_index - 1];
+  for (size_t i = first_index; i < end_times.size(); ++i) {
+    max_end_time = std::max(max_end_time, end_times[i]);
+    max_end_times_[i] = max_end_time;
+  }
+}
+
+}  // namespace m_time_tracker
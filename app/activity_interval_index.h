@@ -0,0 +1,84 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "app/activity.h"
+#include "app/activity_columns.h"
+#include "app/database.h"
+#include "app/error_codes.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+// In-memory copy of completed activities, that finds activities
+// overlapping an interval without touching DB.
+// Activities are kept in ActivityColumns together with running maximum
+// of end times. Binary search skips all activities before the first one,
+// that may overlap the interval, and all activities starting after it;
+// activities in between are scanned with SIMD kernel. Usually they are
+// few more than overlapping ones, but a single long early activity makes
+// every later query scan from it, so worst case is O(n).
+// Not completed activities are ignored, like in statistics.
+// All methods are thread-safe; queries may run in parallel.
+class ActivityIntervalIndex {
+ public:
+  using Entry = ActivityColumns::Row;
+
+  static outcome::std_result<std::unique_ptr<ActivityIntervalIndex>> Load(
+      Database* db) noexcept;
+
+  ActivityIntervalIndex(const ActivityIntervalIndex&) = delete;
+  ActivityIntervalIndex& operator = (const ActivityIntervalIndex&) = delete;
+
+  // New activities are usually the latest ones, so adding them is
+  // amortized O(1).
+  void Add(const Activity& activity) noexcept;
+  void AddBatch(const std::vector<Activity>& activities) noexcept;
+  // Old version of the activity is found by id, so this is O(n).
+  void Update(const Activity& activity) noexcept;
+  void Remove(const Activity& activity) noexcept;
+
+  // Adds durations of activities, clipped to [interval_start, interval_end),
+  // to |task_durations|.
+  void AddOverlappingDurations(
+      const Activity::TimePoint& interval_start,
+      const Activity::TimePoint& interval_end,
+      std::unordered_map<Task::Id, Activity::Duration>* task_durations)
+      const noexcept;
+  // Same filtering as in |Activity::LoadFiltered|.
+  std::vector<Entry> FindFiltered(
+      const std::optional<Task::Id> task_id,
+      const std::optional<Activity::TimePoint> earliest_start_time,
+      const std::optional<Activity::TimePoint> latest_start_time)
+      const noexcept;
+
+  size_t size() const noexcept;
+
+ private:
+  explicit ActivityIntervalIndex(ActivityColumns columns) noexcept;
+
+  static Entry EntryFromActivity(const Activity& activity) noexcept;
+  void InsertLocked(const Entry& entry) noexcept;
+  // |start_time_hint| speeds up search, if old start time is known.
+  void RemoveLocked(
+      Activity::Id id, std::optional<int64_t> start_time_hint) noexcept;
+  // Recomputes |max_end_times_| starting from |first_index|.
+  void UpdateMaxEndTimesLocked(size_t first_index) noexcept;
+
+  mutable std::shared_mutex mutex_;
+  // Sorted by start time.
+  ActivityColumns columns_;
+  // Element i is the maximum of end times of entries 0..i, so it never
+  // decreases.
+  std::vector<int64_t> max_end_times_;
+};
+
+}  // namespace m_time_tracker
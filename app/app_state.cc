@@ -4,97 +4,211 @@
 
 #include "app/app_state.h"
 
+#include "app/daily_task_totals.h"
 #include "app/running_task.h"
+#include "app/schema_migrations.h"
 
 namespace m_time_tracker {
 
+namespace {
+
+// Enough for statistics and export running in parallel.
+constexpr size_t kReaderConnectionsCount = 2;
+
+}  // namespace
+
 // static
 outcome::std_result<AppState> AppState::Open(
-    const std::filesystem::path& db_path) noexcept {
-  outcome::std_result<Database> maybe_db = Database::Open(db_path);
-  if (!maybe_db) {
-    return maybe_db.error();
-  }
-  const auto task_init_result = Task::EnsureTableCreated(&maybe_db.value());
-  if (!task_init_result) {
-    return task_init_result.error();
-  }
-  const auto activity_init_result =
-      Activity::EnsureTableCreated(&maybe_db.value());
-  if (!activity_init_result) {
-    return activity_init_result.error();
-  }
-  const auto running_task_init_result =
-        RunningTask::EnsureTableCreated(&maybe_db.value());
-  if (!running_task_init_result) {
-    return running_task_init_result.error();
-  }
-  const auto maybe_running_result = RunningTask::Load(&maybe_db.value());
+    const std::filesystem::path& db_path,
+    const Database::Options& db_options,
+    bool use_activity_index) noexcept {
+  auto maybe_pool = DatabasePool::Open(
+      db_path, db_options, kReaderConnectionsCount);
+  if (!maybe_pool) {
+    return maybe_pool.error();
+  }
+  Database& db = maybe_pool.value()->writer();
+  const auto upgrade_result = UpgradeSchema(&db);
+  if (!upgrade_result) {
+    return upgrade_result.error();
+  }
+  const auto totals_result = DailyTaskTotals::RebuildIfTimezoneChanged(&db);
+  if (!totals_result) {
+    return totals_result.error();
+  }
+  std::unique_ptr<ActivityIntervalIndex> activity_index;
+  if (use_activity_index) {
+    auto maybe_index = ActivityIntervalIndex::Load(&db);
+    if (!maybe_index) {
+      return maybe_index.error();
+    }
+    activity_index = std::move(maybe_index.value());
+  }
+  auto maybe_tasks = TaskRepository::Load(&db);
+  if (!maybe_tasks) {
+    return maybe_tasks.error();
+  }
+  const auto maybe_running_result = RunningTask::Load(&db);
   if (!maybe_running_result) {
     return maybe_running_result.error();
   }
   const std::optional<RunningTask>& maybe_running =
       maybe_running_result.value();
   if (!maybe_running) {
-    return AppState(std::move(maybe_db.value()), std::nullopt, std::nullopt);
+    return AppState(
+        std::move(maybe_pool.value()),
+        std::move(maybe_tasks.value()),
+        std::move(activity_index),
+        nullptr,
+        std::nullopt);
   } else {
-    const auto maybe_task = Task::LoadById(
-        &maybe_db.value(),
+    TaskRef running_task = maybe_tasks.value().FindById(
         maybe_running->task_id());
-    if (!maybe_task) {
-      return maybe_task.error();
+    if (!running_task) {
+      return ErrorCodes::kEmptyResults;
     }
     return AppState(
-        std::move(maybe_db.value()),
-        maybe_task.value(),
+        std::move(maybe_pool.value()),
+        std::move(maybe_tasks.value()),
+        std::move(activity_index),
+        std::move(running_task),
         maybe_running->start_time());
   }
 }
 
+AppState::AppState(
+    std::unique_ptr<DatabasePool> initalized_db_pool,
+    TaskRepository tasks,
+    std::unique_ptr<ActivityIntervalIndex> activity_index,
+    TaskRef running_task,
+    std::optional<Activity::TimePoint> running_task_start_time) noexcept
+    : db_pool_(std::move(initalized_db_pool)),
+      tasks_(std::move(tasks)),
+      activity_index_(std::move(activity_index)),
+      running_task_(std::move(running_task)),
+      running_task_start_time_(std::move(running_task_start_time)) {
+  if (running_task_) {
+    VERIFY(running_task_start_time_);
+  } else {
+    VERIFY(!running_task_start_time_);
+  }
+  if (ActivityIntervalIndex* index = activity_index_.get()) {
+    // Slots capture index rather than |this|, since AppState is movable.
+    sig_after_activity_added_.connect([index](const Activity& activity) {
+      index->Add(activity);
+    });
+    sig_after_activities_added_.connect(
+        [index](const std::vector<Activity>& activities) {
+          index->AddBatch(activities);
+        });
+    sig_existing_activity_changed_.connect(
+        [index](const Activity& activity) {
+          index->Update(activity);
+        });
+    sig_after_activity_deleted_.connect([index](const Activity& activity) {
+      index->Remove(activity);
+    });
+  }
+}
+
 outcome::std_result<void> AppState::SaveTask(Task* task) noexcept {
   VERIFY(task);
   const bool was_saved = (task->id() != std::nullopt);
-  outcome::std_result<void> save_result = task->Save(&db_);
+  outcome::std_result<void> save_result = task->Save(&db());
   if (save_result) {
+    // Copy the reference, since handlers may save other tasks.
+    const TaskRef saved_task = tasks_.Put(*task);
     if (running_task_ && running_task_->id() == task->id()) {
-      running_task_ = *task;
-      VERIFY(running_task_->id());
+      running_task_ = saved_task;
     }
     if (was_saved) {
-      sig_existing_task_changed_(*task);
+      sig_existing_task_changed_(saved_task);
     } else {
-      sig_after_task_added_(*task);
+      sig_after_task_added_(saved_task);
     }
   }
   return save_result;
 }
 
+outcome::std_result<void> AppState::AddActivities(
+    std::vector<Activity>* activities) noexcept {
+  VERIFY(activities);
+  for (const Activity& a : *activities) {
+    VERIFY(a.end_time());
+  }
+  const auto save_result = Activity::SaveBatch(&db(), activities);
+  if (!save_result) {
+    return save_result.error();
+  }
+  if (!activities->empty()) {
+    sig_after_activities_added_(*activities);
+  }
+  return outcome::success();
+}
+
 outcome::std_result<void> AppState::SaveChangedActivity(
     Activity* activity) noexcept {
   VERIFY(activity);
   VERIFY(activity->id());
-  outcome::std_result<void> save_result = activity->Save(&db_);
+  // Subscribers, that keep aggregates, need old interval to subtract it.
+  auto maybe_old_activity = Activity::LoadById(&db(), *activity->id());
+  if (!maybe_old_activity) {
+    return maybe_old_activity.error();
+  }
+  outcome::std_result<void> save_result = activity->Save(&db());
   if (save_result) {
     sig_existing_activity_changed_(*activity);
+    sig_existing_activity_replaced_(maybe_old_activity.value(), *activity);
   }
   return save_result;
 }
 
-outcome::std_result<void> AppState::StartRunningTask(Task new_task) noexcept {
-  VERIFY(new_task.id());
+outcome::std_result<void> AppState::StartRunningTask(
+    TaskRef new_task) noexcept {
+  VERIFY(new_task);
+  VERIFY(new_task->id());
+  const Activity::TimePoint start_time = Activity::GetCurrentTimePoint();
+  RunningTask rt(*new_task->id(), start_time);
+  const auto db_result = rt.Save(&db());
+  if (!db_result) {
+    return db_result;
+  }
   running_task_ = std::move(new_task);
-  running_task_start_time_ = Activity::GetCurrentTimePoint();
+  running_task_start_time_ = start_time;
   sig_running_task_changed_(running_task_);
-  RunningTask rt(*running_task_->id(), *running_task_start_time_);
-  return rt.Save(&db_);
+  return outcome::success();
 }
 
-outcome::std_result<void> AppState::DropRunningTask() noexcept {
-  const auto db_result = RunningTask::Delete(&db_);
-  if (!db_result) {
-    return db_result;
+outcome::std_result<void> AppState::StopRunningTask(
+    bool record_activity) noexcept {
+  VERIFY(running_task_);
+  VERIFY(running_task_start_time_);
+  auto maybe_transaction = db().BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
   }
-  running_task_ = std::nullopt;
+  std::optional<Activity> new_activity;
+  if (record_activity) {
+    new_activity.emplace(*running_task_, *running_task_start_time_);
+    new_activity->SetInterval(
+        *running_task_start_time_, Activity::GetCurrentTimePoint());
+    const auto save_result = new_activity->Save(&db());
+    if (!save_result) {
+      return save_result;
+    }
+  }
+  const auto delete_result = RunningTask::Delete(&db());
+  if (!delete_result) {
+    return delete_result;
+  }
+  const auto commit_result = maybe_transaction.value().Commit();
+  if (!commit_result) {
+    return commit_result;
+  }
+  if (new_activity) {
+    sig_after_activity_added_(*new_activity);
+  }
+  running_task_ = nullptr;
   running_task_start_time_ = std::nullopt;
   sig_running_task_changed_(running_task_);
   return outcome::success();
@@ -103,33 +217,46 @@ outcome::std_result<void> AppState::DropRunningTask() noexcept {
 outcome::std_result<void> AppState::RecordRunningTaskActivity() noexcept {
   VERIFY(running_task_);
   VERIFY(running_task_start_time_);
+  auto maybe_transaction = db().BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
   Activity new_activity(*running_task_, *running_task_start_time_);
   const Activity::TimePoint now = Activity::GetCurrentTimePoint();
   new_activity.SetInterval(*running_task_start_time_, now);
-  const auto db_result = new_activity.Save(&db_);
-  if (!db_result) {
-    return db_result;
+  const auto save_result = new_activity.Save(&db());
+  if (!save_result) {
+    return save_result;
+  }
+  // Persist new start time, so recorded interval is not recorded again
+  // after application restart.
+  RunningTask rt(*running_task_->id(), now);
+  const auto running_save_result = rt.Save(&db());
+  if (!running_save_result) {
+    return running_save_result;
+  }
+  const auto commit_result = maybe_transaction.value().Commit();
+  if (!commit_result) {
+    return commit_result;
   }
   running_task_start_time_ = now;
   sig_after_activity_added_(new_activity);
   return outcome::success();
 }
 
-outcome::std_result<void> AppState::ChangeRunningTask(Task new_task) noexcept {
+outcome::std_result<void> AppState::ChangeRunningTask(
+    TaskRef new_task) noexcept {
   if (!running_task_) {
-    const auto start_result = StartRunningTask(std::move(new_task));
-    if (!start_result) {
-      return start_result;
-    }
-  } else {
-    VERIFY(new_task.id());
-    running_task_ = std::move(new_task);
-    RunningTask rt(*new_task.id(), *running_task_start_time_);
-    const auto db_result = rt.Save(&db_);
-    if (!db_result) {
-      return db_result;
-    }
+    return StartRunningTask(std::move(new_task));
+  }
+  VERIFY(new_task);
+  VERIFY(new_task->id());
+  RunningTask rt(*new_task->id(), *running_task_start_time_);
+  const auto db_result = rt.Save(&db());
+  if (!db_result) {
+    return db_result;
   }
+  running_task_ = std::move(new_task);
   sig_running_task_changed_(running_task_);
   return outcome::success();
 }
@@ -147,7 +274,11 @@ outcome::std_result<void> AppState::DeleteActivity(
     const Activity& activity) noexcept {
   VERIFY(activity.id());
   sig_before_activity_deleted_(activity);
-  return Activity::Delete(&db_, *activity.id());
+  const auto delete_result = Activity::Delete(&db(), *activity.id());
+  if (delete_result) {
+    sig_after_activity_deleted_(activity);
+  }
+  return delete_result;
 }
 
 }  // namespace m_time_tracker
@@ -5,30 +5,51 @@
 #pragma once
 
 #include <sigc++/sigc++.h>
+
+#include <memory>
 #include <utility>
+#include <vector>
 
 #include "app/database.h"
+#include "app/database_pool.h"
 #include "app/activity.h"
+#include "app/activity_interval_index.h"
 #include "app/task.h"
+#include "app/task_repository.h"
 
 namespace m_time_tracker {
 
 class AppState {
  public:
+  // If |use_activity_index| is true, all completed activities are kept in
+  // memory to speed up statistics.
   static outcome::std_result<AppState> Open(
-      const std::filesystem::path& db_path) noexcept;
+      const std::filesystem::path& db_path,
+      const Database::Options& db_options,
+      bool use_activity_index) noexcept;
 
   outcome::std_result<void> SaveTask(Task* task) noexcept;
   // Activity must be already present in DB - new activities must be added
   // through |RecordRunningTaskActivity|.
   outcome::std_result<void> SaveChangedActivity(Activity* activity) noexcept;
+  // Saves completed activities, e.g. imported ones, in one transaction.
+  // Subscribers are notified once about all of them.
+  outcome::std_result<void> AddActivities(
+      std::vector<Activity>* activities) noexcept;
 
-  using SignalWithTask = sigc::signal<void(const Task&)>;
+  using SignalWithTask = sigc::signal<void(const TaskRef&)>;
   using SlotWithTask = SignalWithTask::slot_type;
-  using SignalWithOptTask = sigc::signal<void(const std::optional<Task>&)>;
+  // Passes nullptr if no task is running.
+  using SignalWithOptTask = sigc::signal<void(const TaskRef&)>;
   using SlotWithOptTask = SignalWithOptTask::slot_type;
   using SignalWithActivity = sigc::signal<void(const Activity&)>;
   using SlotWithActivity = SignalWithActivity::slot_type;
+  using SignalWithActivities =
+      sigc::signal<void(const std::vector<Activity>&)>;
+  using SlotWithActivities = SignalWithActivities::slot_type;
+  using SignalWithActivityChange = sigc::signal<
+      void(const Activity& old_activity, const Activity& new_activity)>;
+  using SlotWithActivityChange = SignalWithActivityChange::slot_type;
 
   sigc::connection ConnectExistingTaskChanged(SlotWithTask&& h) noexcept {
     return sig_existing_task_changed_.connect(std::forward<SlotWithTask>(h));
@@ -52,32 +73,74 @@ class AppState {
         std::forward<SlotWithActivity>(h));
   }
 
+  // Like ConnectExistingActivityChanged, but also passes the activity
+  // as it was before the change.
+  sigc::connection ConnectExistingActivityReplaced(
+      SlotWithActivityChange&& h) noexcept {
+    return sig_existing_activity_replaced_.connect(
+        std::forward<SlotWithActivityChange>(h));
+  }
+
   sigc::connection ConnectBeforeActivityDeleted(SlotWithActivity&& h) noexcept {
     return sig_before_activity_deleted_.connect(
         std::forward<SlotWithActivity>(h));
   }
 
+  // Invoked only if activity was deleted from DB, so subscribers, that
+  // keep aggregates, stay consistent with it.
+  sigc::connection ConnectAfterActivityDeleted(SlotWithActivity&& h) noexcept {
+    return sig_after_activity_deleted_.connect(
+        std::forward<SlotWithActivity>(h));
+  }
+
   sigc::connection ConnectAfterActivityAdded(SlotWithActivity&& h) noexcept {
     return sig_after_activity_added_.connect(
         std::forward<SlotWithActivity>(h));
   }
 
+  sigc::connection ConnectAfterActivitiesAdded(
+      SlotWithActivities&& h) noexcept {
+    return sig_after_activities_added_.connect(
+        std::forward<SlotWithActivities>(h));
+  }
+
 
+  // Connection, used by AppState for writes. Must be used only from
+  // UI thread.
   Database& db_for_read_only() noexcept {
-    return db_;
+    return db();
+  }
+
+  // Read-only connections for worker threads.
+  DatabasePool& db_pool() noexcept {
+    return *db_pool_;
+  }
+
+  // All tasks, kept up to date by |SaveTask|. Must be used only from
+  // UI thread.
+  const TaskRepository& tasks() const noexcept {
+    return tasks_;
+  }
+
+  // Kept up to date with activity changes. May be used from any thread.
+  // Returns nullptr if index is disabled.
+  const ActivityIntervalIndex* activity_index() const noexcept {
+    return activity_index_.get();
   }
 
   AppState(AppState&&) = default;
 
-  // Returns nullopt if there is no running Task.
-  std::optional<Task> running_task() const noexcept {
+  // Returns nullptr if there is no running Task.
+  const TaskRef& running_task() const noexcept {
     return running_task_;
   }
 
-  // Must always be valid Task id. Previous task is silently dropped,
+  // Must always be saved Task. Previous task is silently dropped,
   // if any.
-  outcome::std_result<void> StartRunningTask(Task new_task_id) noexcept;
-  outcome::std_result<void> DropRunningTask() noexcept;
+  outcome::std_result<void> StartRunningTask(TaskRef new_task) noexcept;
+  // If |record_activity| is true, makes Activity record about running
+  // task in the same transaction.
+  outcome::std_result<void> StopRunningTask(bool record_activity) noexcept;
 
   // Makes Activity record about current task and continues running
   // the same task.
@@ -86,7 +149,7 @@ class AppState {
   // Changes Task without resetting run time.
   // Does not make complete Activity record in the DB -
   // use |RecordRunningTaskActivity| for that.
-  outcome::std_result<void> ChangeRunningTask(Task new_task) noexcept;
+  outcome::std_result<void> ChangeRunningTask(TaskRef new_task) noexcept;
 
   // Returns nullopt if there is no running Task.
   std::optional<Activity::Duration> RunningTaskRunTime() const noexcept;
@@ -94,17 +157,14 @@ class AppState {
 
  private:
   // Expects DB with all tables alaready created.
-  AppState(Database initalized_db,
-           std::optional<Task> running_task,
-           std::optional<Activity::TimePoint> running_task_start_time) noexcept
-      : db_(std::move(initalized_db)),
-        running_task_(std::move(running_task)),
-        running_task_start_time_(std::move(running_task_start_time)) {
-    if (running_task_) {
-      VERIFY(running_task_start_time_);
-    } else {
-      VERIFY(!running_task_start_time_);
-    }
+  AppState(std::unique_ptr<DatabasePool> initalized_db_pool,
+           TaskRepository tasks,
+           std::unique_ptr<ActivityIntervalIndex> activity_index,
+           TaskRef running_task,
+           std::optional<Activity::TimePoint> running_task_start_time) noexcept;
+
+  Database& db() noexcept {
+    return db_pool_->writer();
   }
 
   SignalWithTask sig_existing_task_changed_;
@@ -112,12 +172,18 @@ class AppState {
   SignalWithTask sig_after_task_added_;
   SignalWithOptTask sig_running_task_changed_;
   SignalWithActivity sig_existing_activity_changed_;
+  SignalWithActivityChange sig_existing_activity_replaced_;
   SignalWithActivity sig_before_activity_deleted_;
+  SignalWithActivity sig_after_activity_deleted_;
   SignalWithActivity sig_after_activity_added_;
-  Database db_;
-
-  // Must alwasy be saved task.
-  std::optional<Task> running_task_;
+  SignalWithActivities sig_after_activities_added_;
+  std::unique_ptr<DatabasePool> db_pool_;
+  TaskRepository tasks_;
+  // Heap-allocated, so it stays at the same address when AppState is moved.
+  std::unique_ptr<ActivityIntervalIndex> activity_index_;
+
+  // Must alwasy be saved task or nullptr.
+  TaskRef running_task_;
   std::optional<Activity::TimePoint> running_task_start_time_;
 };
 
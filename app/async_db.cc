@@ -0,0 +1,77 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/async_db.h"
+
+namespace m_time_tracker {
+
+AsyncDb::AsyncDb(DatabasePool* pool) noexcept
+    : reader_(pool->AcquireReader()) {
+  dispatcher_.connect(sigc::mem_fun(*this, &AsyncDb::OnJobsFinished));
+  worker_ = std::thread(&AsyncDb::WorkerThread, this);
+}
+
+AsyncDb::~AsyncDb() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_posted_.notify_one();
+  worker_.join();
+}
+
+AsyncDb::Ticket AsyncDb::Enqueue(Job job) noexcept {
+  job.cancelled = std::make_shared<std::atomic<bool>>(false);
+  Ticket result(job.cancelled);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_jobs_.push_back(std::move(job));
+  }
+  job_posted_.notify_one();
+  return result;
+}
+
+void AsyncDb::WorkerThread() noexcept {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_posted_.wait(lock, [this]() {
+        return stopping_ || !pending_jobs_.empty();
+      });
+      if (stopping_) {
+        return;
+      }
+      job = std::move(pending_jobs_.front());
+      pending_jobs_.pop_front();
+    }
+    if (job.cancelled->load()) {
+      continue;
+    }
+    job.run(reader_.get());
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_jobs_.push_back(std::move(job));
+    }
+    dispatcher_.emit();
+  }
+}
+
+void AsyncDb::OnJobsFinished() noexcept {
+  std::deque<Job> finished_jobs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_jobs.swap(finished_jobs_);
+  }
+  for (Job& job : finished_jobs) {
+    // Tickets are cancelled only on this thread, so the check can not race
+    // with the cancellation.
+    if (!job.cancelled->load()) {
+      job.cancelled->store(true);
+      job.deliver();
+    }
+  }
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,122 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <glibmm/dispatcher.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "app/database_pool.h"
+
+namespace m_time_tracker {
+
+// Runs queries on a worker thread, that owns one reader connection of
+// DatabasePool, and delivers their results on the thread that created
+// this object (GTK main loop). Queries are run one by one in the order
+// they were posted.
+class AsyncDb {
+ public:
+  // Handle of the posted query. Destroying or reassigning it cancels the
+  // query - it is skipped if it did not start yet, otherwise its result
+  // is dropped instead of being delivered.
+  // Must be used only on the main thread.
+  class Ticket {
+   public:
+    Ticket() noexcept = default;
+    Ticket(Ticket&& second) noexcept = default;
+    Ticket& operator = (Ticket&& second) noexcept {
+      Cancel();
+      cancelled_ = std::move(second.cancelled_);
+      return *this;
+    }
+    ~Ticket() {
+      Cancel();
+    }
+
+    Ticket(const Ticket&) = delete;
+    Ticket& operator = (const Ticket&) = delete;
+
+    void Cancel() noexcept {
+      if (cancelled_) {
+        cancelled_->store(true);
+        cancelled_.reset();
+      }
+    }
+
+    // True if query is neither cancelled nor delivered yet.
+    bool is_pending() const noexcept {
+      return cancelled_ && !cancelled_->load();
+    }
+
+   private:
+    friend class AsyncDb;
+
+    explicit Ticket(std::shared_ptr<std::atomic<bool>> cancelled) noexcept
+        : cancelled_(std::move(cancelled)) {}
+
+    std::shared_ptr<std::atomic<bool>> cancelled_;
+  };
+
+  // Checks out one reader of |pool| for the whole lifetime of the object.
+  explicit AsyncDb(DatabasePool* pool) noexcept;
+  // Waits for the running query, if any. Other queries are dropped.
+  ~AsyncDb();
+
+  AsyncDb(const AsyncDb&) = delete;
+  AsyncDb& operator = (const AsyncDb&) = delete;
+
+  // |query| is called on the worker thread as
+  //   outcome::std_result<T> query(Database* db)
+  // and must not touch any state, shared with the main thread.
+  // |on_done| receives its result on the main thread.
+  template<typename Query, typename OnDone>
+  [[nodiscard]] Ticket Post(Query query, OnDone on_done) noexcept {
+    using Result = std::invoke_result_t<Query&, Database*>;
+    // Written by the worker thread, read on the main thread after
+    // the job is handed over under |mutex_|.
+    auto result = std::make_shared<std::optional<Result>>();
+    Job job;
+    job.run = [query = std::move(query), result](Database* db) mutable {
+      result->emplace(query(db));
+    };
+    job.deliver = [on_done = std::move(on_done), result]() mutable {
+      on_done(std::move(**result));
+    };
+    return Enqueue(std::move(job));
+  }
+
+ private:
+  struct Job {
+    std::shared_ptr<std::atomic<bool>> cancelled;
+    std::function<void(Database*)> run;
+    std::function<void()> deliver;
+  };
+
+  Ticket Enqueue(Job job) noexcept;
+  void WorkerThread() noexcept;
+  void OnJobsFinished() noexcept;
+
+  DatabasePool::Reader reader_;
+  Glib::Dispatcher dispatcher_;
+  std::mutex mutex_;
+  std::condition_variable job_posted_;
+  // Guarded by |mutex_|.
+  std::deque<Job> pending_jobs_;
+  std::deque<Job> finished_jobs_;
+  bool stopping_ = false;
+  // Started last, since it uses all members above.
+  std::thread worker_;
+};
+
+}  // namespace m_time_tracker
@@ -0,0 +1,307 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+// Run with
+//   benchmarks --benchmark_out=results.json --benchmark_out_format=json
+// to get results, that may be compared between commits with
+// compare.py script from Google benchmark tools.
+// Use --benchmark_filter to skip slow 10M activities cases.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "app/activity.h"
+#include "app/activity_columns.h"
+#include "app/activity_interval_index.h"
+#include "app/database.h"
+#include "app/history_generator.h"
+#include "app/schema_migrations.h"
+#include "app/task.h"
+#include "app/utils.h"
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+// Average activity duration plus gap between activities.
+constexpr Activity::Duration kActivitySlot = std::chrono::minutes(35);
+constexpr Activity::Duration kActivityDuration = std::chrono::minutes(30);
+constexpr Activity::Duration kActivityGap = std::chrono::minutes(5);
+constexpr Activity::Duration kQueryInterval = std::chrono::hours(24 * 30);
+// Fixed, so that different runs work on the same data.
+const Activity::TimePoint kHistoryStart = Activity::TimePointFromInt(
+    1577836800);  // 2020-01-01 00:00:00 UTC
+
+struct BenchmarkDb {
+  Database db;
+  // Not archived top-level task with children.
+  Task parent_task;
+  // Not archived child of |parent_task|.
+  Task child_task;
+  Activity::TimePoint history_end;
+  // Loaded on first use.
+  std::unique_ptr<ActivityIntervalIndex> activity_index;
+};
+
+template<typename T>
+T VerifiedValue(outcome::std_result<T> result) noexcept {
+  if (!result) {
+    std::cerr << "Error " << result.error().message() << std::endl;
+  }
+  VERIFY(result);
+  return std::move(result.value());
+}
+
+void VerifySuccess(const outcome::std_result<void>& result) noexcept {
+  if (!result) {
+    std::cerr << "Error " << result.error().message() << std::endl;
+  }
+  VERIFY(result);
+}
+
+std::unique_ptr<BenchmarkDb> CreateBenchmarkDb(
+    int64_t activity_count, bool on_disk) noexcept {
+  std::string path = ":memory:";
+  if (on_disk) {
+    const std::filesystem::path file_path =
+        std::filesystem::temp_directory_path() /
+        ("time_keeper_benchmark_" + std::to_string(activity_count) + ".db");
+    std::filesystem::remove(file_path);
+    std::filesystem::remove(file_path.native() + "-wal");
+    std::filesystem::remove(file_path.native() + "-shm");
+    path = file_path.native();
+  }
+  Database db = VerifiedValue(
+      Database::Open(path, Database::Options::Desktop()));
+  VerifySuccess(UpgradeSchema(&db));
+  HistoryGeneratorParams params;
+  params.tasks_per_level = {10, 50};
+  params.activity_count = activity_count;
+  params.history_start = kHistoryStart;
+  params.history_span = kActivitySlot * activity_count;
+  GeneratedHistory history = VerifiedValue(GenerateHistory(&db, params));
+  const std::vector<Task>& child_tasks = history.tasks_by_level[1];
+  const auto child_it = std::find_if(
+      child_tasks.begin(), child_tasks.end(),
+      [](const Task& task) {
+        return !task.is_archived();
+      });
+  VERIFY(child_it != child_tasks.end());
+  const std::vector<Task>& top_level_tasks = history.tasks_by_level[0];
+  const auto parent_it = std::find_if(
+      top_level_tasks.begin(), top_level_tasks.end(),
+      [&child_it](const Task& task) {
+        return task.id() == child_it->parent_task_id();
+      });
+  VERIFY(parent_it != top_level_tasks.end());
+  return std::make_unique<BenchmarkDb>(BenchmarkDb{
+      std::move(db),
+      *parent_it,
+      *child_it,
+      history.history_end,
+      nullptr});
+}
+
+// Creating database with 10M activities takes a while, so they are shared
+// by all benchmarks.
+BenchmarkDb* GetBenchmarkDb(const benchmark::State& state) noexcept {
+  static std::map<std::pair<int64_t, bool>, std::unique_ptr<BenchmarkDb>>
+      databases;
+  const int64_t activity_count = state.range(0);
+  const bool on_disk = (state.range(1) != 0);
+  auto& db = databases[{activity_count, on_disk}];
+  if (!db) {
+    db = CreateBenchmarkDb(activity_count, on_disk);
+  }
+  return db.get();
+}
+
+void DbBenchmarkArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgsProduct({{1000, 100000, 10000000}, {0, 1}});
+  benchmark->ArgNames({"activities", "on_disk"});
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+// Third argument chooses between SQL and in-memory activity index.
+void IndexedDbBenchmarkArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgsProduct({{1000, 100000, 10000000}, {0, 1}, {0, 1}});
+  benchmark->ArgNames({"activities", "on_disk", "index"});
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+const ActivityIntervalIndex* GetActivityIndex(
+    const benchmark::State& state, BenchmarkDb* bench_db) noexcept {
+  if (state.range(2) == 0) {
+    return nullptr;
+  }
+  if (!bench_db->activity_index) {
+    bench_db->activity_index = VerifiedValue(
+        ActivityIntervalIndex::Load(&bench_db->db));
+  }
+  return bench_db->activity_index.get();
+}
+
+void BM_ActivityLoadFiltered(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const ActivityIntervalIndex* index = GetActivityIndex(state, bench_db);
+  const Task& task = bench_db->child_task;
+  for (auto _ : state) {
+    auto activities = VerifiedValue(Activity::LoadFiltered(
+        &bench_db->db,
+        task.id(),
+        bench_db->history_end - kQueryInterval,
+        bench_db->history_end,
+        index));
+    benchmark::DoNotOptimize(activities);
+  }
+}
+BENCHMARK(BM_ActivityLoadFiltered)->Apply(IndexedDbBenchmarkArgs);
+
+void BM_ActivityLoadStatsForInterval(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const ActivityIntervalIndex* index = GetActivityIndex(state, bench_db);
+  const Task& parent = bench_db->parent_task;
+  for (auto _ : state) {
+    auto stats = VerifiedValue(Activity::LoadStatsForInterval(
+        &bench_db->db,
+        bench_db->history_end - kQueryInterval,
+        bench_db->history_end,
+        *parent.id(),
+        index));
+    benchmark::DoNotOptimize(stats);
+  }
+}
+BENCHMARK(BM_ActivityLoadStatsForInterval)->Apply(IndexedDbBenchmarkArgs);
+
+// Whole history, like "All" range in statistics view.
+void BM_ActivityLoadStatsForTopLevelTasksInInterval(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const ActivityIntervalIndex* index = GetActivityIndex(state, bench_db);
+  for (auto _ : state) {
+    auto stats = VerifiedValue(Activity::LoadStatsForTopLevelTasksInInterval(
+        &bench_db->db,
+        kHistoryStart,
+        bench_db->history_end,
+        index));
+    benchmark::DoNotOptimize(stats);
+  }
+}
+BENCHMARK(BM_ActivityLoadStatsForTopLevelTasksInInterval)->Apply(
+    IndexedDbBenchmarkArgs);
+
+void BM_ActivityLoadTwoLevelStats(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const ActivityIntervalIndex* index = GetActivityIndex(state, bench_db);
+  for (auto _ : state) {
+    auto stats = VerifiedValue(Activity::LoadTwoLevelStats(
+        &bench_db->db,
+        kHistoryStart,
+        bench_db->history_end,
+        std::nullopt,
+        index));
+    benchmark::DoNotOptimize(stats);
+  }
+}
+BENCHMARK(BM_ActivityLoadTwoLevelStats)->Apply(IndexedDbBenchmarkArgs);
+
+// Daily chart for the last year.
+void BM_ActivityLoadBucketedStats(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const ActivityIntervalIndex* index = GetActivityIndex(state, bench_db);
+  for (auto _ : state) {
+    auto stats = VerifiedValue(Activity::LoadBucketedStats(
+        &bench_db->db,
+        bench_db->history_end - std::chrono::hours(24 * 365),
+        bench_db->history_end,
+        Activity::BucketKind::kDay,
+        std::nullopt,
+        index));
+    benchmark::DoNotOptimize(stats);
+  }
+}
+BENCHMARK(BM_ActivityLoadBucketedStats)->Apply(IndexedDbBenchmarkArgs);
+
+// Linear pass over all activities, without help of daily totals.
+void BM_ActivityColumnsAddClippedDurations(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const ActivityColumns columns = VerifiedValue(
+      ActivityColumns::Load(&bench_db->db));
+  for (auto _ : state) {
+    std::unordered_map<Task::Id, Activity::Duration> task_durations;
+    columns.AddClippedDurations(
+        0,
+        columns.size(),
+        Activity::IntFromTimePoint(kHistoryStart),
+        Activity::IntFromTimePoint(bench_db->history_end),
+        &task_durations);
+    benchmark::DoNotOptimize(task_durations);
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<int64_t>(columns.size()));
+}
+BENCHMARK(BM_ActivityColumnsAddClippedDurations)->Apply(DbBenchmarkArgs);
+
+void BM_TaskLoadAll(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  for (auto _ : state) {
+    auto tasks = VerifiedValue(Task::LoadAll(&bench_db->db));
+    benchmark::DoNotOptimize(tasks);
+  }
+}
+BENCHMARK(BM_TaskLoadAll)->Apply(DbBenchmarkArgs);
+
+// Registered after read-only benchmarks, since it grows the databases.
+void BM_ActivitySave(benchmark::State& state) {
+  BenchmarkDb* bench_db = GetBenchmarkDb(state);
+  const Task& task = bench_db->child_task;
+  for (auto _ : state) {
+    Activity activity(task, bench_db->history_end);
+    activity.SetInterval(
+        bench_db->history_end,
+        bench_db->history_end + kActivityDuration);
+    VerifySuccess(activity.Save(&bench_db->db));
+    bench_db->history_end += kActivityDuration + kActivityGap;
+  }
+}
+BENCHMARK(BM_ActivitySave)->Apply(DbBenchmarkArgs);
+
+void BM_FormatRuntime(benchmark::State& state) {
+  const Activity::Duration runtime = std::chrono::seconds(4201);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        FormatRuntime(runtime, FormatMode::kLongWithoutSeconds));
+  }
+}
+BENCHMARK(BM_FormatRuntime);
+
+void BM_FormatTimePoint(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(FormatTimePoint(kHistoryStart));
+  }
+}
+BENCHMARK(BM_FormatTimePoint);
+
+void BM_TimePointToLocal(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(TimePointToLocal(kHistoryStart));
+  }
+}
+BENCHMARK(BM_TimePointToLocal);
+
+}  // namespace
+
+}  // namespace m_time_tracker
+
+BENCHMARK_MAIN();
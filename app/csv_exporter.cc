@@ -10,6 +10,7 @@
 #include <vector>
 
 #include <boost/algorithm/string/replace.hpp>
+#include "app/task_repository.h"
 #include "app/utils.h"
 
 namespace m_time_tracker {
@@ -35,13 +36,18 @@ std::string FormatTime(const Activity::TimePoint& time_point) noexcept {
 
 CSVExporter::CSVExporter(
      Database* db_for_read_only,
+     const TaskRepository* tasks,
+     const ActivityIntervalIndex* activity_index,
      const Activity::TimePoint& from_time,
      const Activity::TimePoint& to_time,
      const std::string& export_file_path) noexcept
   : db_for_read_only_(db_for_read_only),
+    tasks_(tasks),
+    activity_index_(activity_index),
     from_time_(from_time),
     to_time_(to_time),
     export_file_path_(export_file_path) {
+  VERIFY(tasks_);
 }
 
 outcome::std_result<void> CSVExporter::Run() noexcept {
@@ -50,7 +56,8 @@ outcome::std_result<void> CSVExporter::Run() noexcept {
           db_for_read_only_,
           std::nullopt,
           from_time_,
-          to_time_);
+          to_time_,
+          activity_index_);
   if (!maybe_activities) {
     return maybe_activities.error();
   }
@@ -123,19 +130,18 @@ outcome::std_result<CSVExporter::TaskNames> CSVExporter::GetEscapedTaskName(
   if (it_cached != cached_escaped_task_names_.end()) {
     return it_cached->second;
   }
-  const auto maybe_task = Task::LoadById(db_for_read_only_, task_id);
-  if (!maybe_task) {
-    return maybe_task.error();
+  const TaskRef task = tasks_->FindById(task_id);
+  if (!task) {
+    return ErrorCodes::kEmptyResults;
   }
   TaskNames result;
-  result.task_name = EscapeString(maybe_task.value().name());
-  if (maybe_task.value().parent_task_id()) {
-    const auto maybe_parent = Task::LoadById(
-        db_for_read_only_, *maybe_task.value().parent_task_id());
-    if (!maybe_parent) {
-      return maybe_parent.error();
+  result.task_name = EscapeString(task->name());
+  if (task->parent_task_id()) {
+    const TaskRef parent = tasks_->FindById(*task->parent_task_id());
+    if (!parent) {
+      return ErrorCodes::kEmptyResults;
     }
-    result.parent_task_name = EscapeString(maybe_parent.value().name());
+    result.parent_task_name = EscapeString(parent->name());
   }
   VERIFY(cached_escaped_task_names_.emplace(task_id, result).second);
   return result;
@@ -12,12 +12,17 @@
 
 namespace m_time_tracker {
 
+class ActivityIntervalIndex;
 class Database;
+class TaskRepository;
 
 class CSVExporter {
  public:
+  // |activity_index| may be nullptr, activities are loaded from DB then.
   CSVExporter(
      Database* db_for_read_only,
+     const TaskRepository* tasks,
+     const ActivityIntervalIndex* activity_index,
      const Activity::TimePoint& from_time,
      const Activity::TimePoint& to_time,
      const std::string& export_file_path) noexcept;
@@ -26,6 +31,8 @@ class CSVExporter {
 
  private:
   Database* const db_for_read_only_;
+  const TaskRepository* const tasks_;
+  const ActivityIntervalIndex* const activity_index_;
   const Activity::TimePoint from_time_;
   const Activity::TimePoint to_time_;
   const std::string export_file_path_;
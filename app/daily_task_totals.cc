@@ -0,0 +1,256 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/daily_task_totals.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+int64_t IntFromTimePoint(DailyTaskTotals::TimePoint time_point) noexcept {
+  return time_point.time_since_epoch().count();
+}
+
+DailyTaskTotals::TimePoint TimePointFromInt(int64_t value) noexcept {
+  return DailyTaskTotals::TimePoint(std::chrono::seconds(value));
+}
+
+// Local midnight of the day, |local_time| belongs to.
+DailyTaskTotals::TimePoint MidnightOf(std::tm local_time) noexcept {
+  local_time.tm_hour = 0;
+  local_time.tm_min = 0;
+  local_time.tm_sec = 0;
+  // Midnight may have different DST state than |local_time|.
+  local_time.tm_isdst = -1;
+  const std::time_t result = std::mktime(&local_time);
+  VERIFY(result != -1);
+  return TimePointFromInt(static_cast<int64_t>(result));
+}
+
+std::tm ToLocal(DailyTaskTotals::TimePoint time_point) noexcept {
+  const std::time_t time_val = static_cast<std::time_t>(
+      IntFromTimePoint(time_point));
+  std::tm result{};
+  // Reentrant version, since totals are also used from DB threads.
+  VERIFY(localtime_r(&time_val, &result));
+  return result;
+}
+
+// Local day starts for few fixed dates in different seasons. They differ,
+// if timezone changes in a way, that affects day boundaries.
+std::string TimezoneSignature() noexcept {
+  static constexpr int64_t kReferenceTimes[] = {
+      1579089600,  // 2020-01-15 12:00:00 UTC
+      1594814400,  // 2020-07-15 12:00:00 UTC
+  };
+  std::string result;
+  for (int64_t reference_time : kReferenceTimes) {
+    if (!result.empty()) {
+      result += ",";
+    }
+    result += std::to_string(IntFromTimePoint(
+        DailyTaskTotals::LocalDayStart(TimePointFromInt(reference_time))));
+  }
+  return result;
+}
+
+outcome::std_result<void> SaveTimezoneSignature(Database* db) noexcept {
+  const auto delete_result = db->Execute(
+      "DELETE FROM DailyTaskTotalsTimezone");
+  if (!delete_result) {
+    return delete_result.error();
+  }
+  const std::string signature = TimezoneSignature();
+  const auto insert_result = db->Execute(
+      "INSERT INTO DailyTaskTotalsTimezone(signature) VALUES(?1)",
+      signature);
+  if (!insert_result) {
+    return insert_result.error();
+  }
+  return outcome::success();
+}
+
+}  // namespace
+
+void DailyTaskTotals::Changes::AddSeconds(
+    Task::Id task_id,
+    TimePoint start,
+    TimePoint end,
+    int64_t sign) noexcept {
+  VERIFY(start < end);
+  TimePoint day_start = start;
+  while (day_start < end) {
+    if (day_start < cached_day_start_ || day_start >= cached_day_end_) {
+      cached_day_start_ = LocalDayStart(day_start);
+      cached_day_end_ = NextLocalDayStart(cached_day_start_);
+      VERIFY(cached_day_end_ > day_start);
+    }
+    const TimePoint piece_end = std::min(end, cached_day_end_);
+    const TimePoint piece_start = std::max(start, cached_day_start_);
+    seconds_[{IntFromTimePoint(cached_day_start_), task_id}] +=
+        sign * (piece_end - piece_start).count();
+    day_start = cached_day_end_;
+  }
+}
+
+outcome::std_result<void> DailyTaskTotals::Changes::Apply(
+    Database* db) noexcept {
+  std::vector<std::pair<int64_t, Task::Id>> decreased;
+  std::vector<std::optional<int64_t>> values;
+  std::string query;
+  auto it = seconds_.begin();
+  while (it != seconds_.end()) {
+    query = "INSERT INTO DailyTaskTotals(day, task_id, seconds) VALUES ";
+    values.clear();
+    for (size_t rows = 0;
+         rows < Database::kMaxRowsPerStatement && it != seconds_.end();
+         ++it) {
+      if (it->second == 0) {
+        continue;
+      }
+      if (it->second < 0) {
+        decreased.push_back(it->first);
+      }
+      query += (rows == 0) ? "(?, ?, ?)" : ", (?, ?, ?)";
+      values.push_back(it->first.first);
+      values.push_back(it->first.second);
+      values.push_back(it->second);
+      ++rows;
+    }
+    if (values.empty()) {
+      break;
+    }
+    query += " ON CONFLICT(day, task_id) DO UPDATE SET "
+        "seconds = seconds + excluded.seconds";
+    const auto upsert_result = db->ExecuteWithValues(query, values);
+    if (!upsert_result) {
+      return upsert_result.error();
+    }
+  }
+  for (const auto& [day, task_id] : decreased) {
+    const auto delete_result = db->Execute(
+        "DELETE FROM DailyTaskTotals "
+        " WHERE day = ?1 AND task_id = ?2 AND seconds <= 0",
+        day,
+        task_id);
+    if (!delete_result) {
+      return delete_result.error();
+    }
+  }
+  seconds_.clear();
+  return outcome::success();
+}
+
+// static
+outcome::std_result<void> DailyTaskTotals::EnsureTableCreated(
+    Database* db) noexcept {
+  static constexpr std::string_view kQueries[] = {
+      "CREATE TABLE IF NOT EXISTS DailyTaskTotals( "
+      "  day INTEGER NOT NULL, "
+      "  task_id INTEGER NOT NULL, "
+      "  seconds INTEGER NOT NULL, "
+      "  PRIMARY KEY(day, task_id)) WITHOUT ROWID",
+      "CREATE TABLE IF NOT EXISTS DailyTaskTotalsTimezone( "
+      "  signature TEXT NOT NULL)",
+  };
+  for (std::string_view query : kQueries) {
+    const auto maybe_result = db->Execute(query);
+    if (!maybe_result) {
+      return maybe_result.error();
+    }
+  }
+  return outcome::success();
+}
+
+// static
+outcome::std_result<void> DailyTaskTotals::Rebuild(Database* db) noexcept {
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  const auto delete_result = db->Execute("DELETE FROM DailyTaskTotals");
+  if (!delete_result) {
+    return delete_result.error();
+  }
+  Changes changes;
+  {
+    auto maybe_rows = db->Select(
+        "SELECT task_id, start_time, end_time FROM Activities "
+        " WHERE end_time IS NOT NULL ORDER BY start_time");
+    if (!maybe_rows) {
+      return maybe_rows.error();
+    }
+    SelectRows& rows = maybe_rows.value();
+    for (SelectRows& row : rows) {
+      const auto [task_id, start_time, end_time] =
+          row.Get<int64_t, int64_t, int64_t>();
+      changes.Add(
+          task_id, TimePointFromInt(start_time), TimePointFromInt(end_time));
+    }
+    if (!rows.status()) {
+      return rows.status().error();
+    }
+  }
+  const auto apply_result = changes.Apply(db);
+  if (!apply_result) {
+    return apply_result.error();
+  }
+  const auto signature_result = SaveTimezoneSignature(db);
+  if (!signature_result) {
+    return signature_result.error();
+  }
+  return maybe_transaction.value().Commit();
+}
+
+// static
+outcome::std_result<void> DailyTaskTotals::RebuildIfTimezoneChanged(
+    Database* db) noexcept {
+  std::optional<std::string> saved_signature;
+  {
+    auto maybe_rows = db->Select(
+        "SELECT signature FROM DailyTaskTotalsTimezone");
+    if (!maybe_rows) {
+      return maybe_rows.error();
+    }
+    SelectRows& rows = maybe_rows.value();
+    for (SelectRows& row : rows) {
+      saved_signature = std::get<0>(row.Get<std::string>());
+    }
+    if (!rows.status()) {
+      return rows.status().error();
+    }
+  }
+  if (saved_signature == TimezoneSignature()) {
+    return outcome::success();
+  }
+  return Rebuild(db);
+}
+
+// static
+DailyTaskTotals::TimePoint DailyTaskTotals::LocalDayStart(
+    TimePoint time_point) noexcept {
+  return MidnightOf(ToLocal(time_point));
+}
+
+// static
+DailyTaskTotals::TimePoint DailyTaskTotals::NextLocalDayStart(
+    TimePoint day_start) noexcept {
+  std::tm local_time = ToLocal(day_start);
+  // mktime() normalizes day number overflow.
+  ++local_time.tm_mday;
+  return MidnightOf(local_time);
+}
+
+}  // namespace m_time_tracker
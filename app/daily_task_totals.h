@@ -0,0 +1,72 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <utility>
+
+#include "app/database.h"
+#include "app/error_codes.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+// Rollup of completed activities: total seconds, spent on each task during
+// each local day. Activities, crossing local midnight, are split between
+// days. It is kept in sync by Activity on every change, so statistics for
+// long ranges sum days instead of scanning all activities.
+class DailyTaskTotals {
+ public:
+  // Same as Activity::TimePoint.
+  using TimePoint = std::chrono::time_point<
+      std::chrono::system_clock, std::chrono::seconds>;
+
+  // Accumulates changes of totals, so changes caused by many activities
+  // are written with few statements.
+  class Changes {
+   public:
+    void Add(Task::Id task_id, TimePoint start, TimePoint end) noexcept {
+      AddSeconds(task_id, start, end, 1);
+    }
+
+    void Subtract(Task::Id task_id, TimePoint start, TimePoint end) noexcept {
+      AddSeconds(task_id, start, end, -1);
+    }
+
+    // Should be called inside the transaction, that changes activities.
+    outcome::std_result<void> Apply(Database* db) noexcept;
+
+   private:
+    void AddSeconds(
+        Task::Id task_id,
+        TimePoint start,
+        TimePoint end,
+        int64_t sign) noexcept;
+
+    // Keyed by (day, task_id); day is represented by its start time.
+    std::map<std::pair<int64_t, Task::Id>, int64_t> seconds_;
+    // Last looked up day. Activities usually come in chronological order,
+    // so this avoids most of slow local time conversions.
+    TimePoint cached_day_start_;
+    TimePoint cached_day_end_;
+  };
+
+  static outcome::std_result<void> EnsureTableCreated(Database* db) noexcept;
+  // Recomputes all totals from Activities table.
+  static outcome::std_result<void> Rebuild(Database* db) noexcept;
+  // Day boundaries depend on the local timezone, so totals must be
+  // recomputed if it was changed since totals were last updated.
+  static outcome::std_result<void> RebuildIfTimezoneChanged(
+      Database* db) noexcept;
+
+  // Start of the local day, |time_point| belongs to.
+  static TimePoint LocalDayStart(TimePoint time_point) noexcept;
+  // Start of the local day, following one, that starts at |day_start|.
+  // Days are not always 24 hours long due to DST.
+  static TimePoint NextLocalDayStart(TimePoint day_start) noexcept;
+};
+
+}  // namespace m_time_tracker
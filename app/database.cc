@@ -11,98 +11,440 @@
 
 namespace m_time_tracker {
 
+namespace {
+// Enough to keep all queries issued by the application.
+constexpr size_t kStatementCacheCapacity = 64;
+}  // namespace
+
+// static
+Database::Options Database::Options::Desktop() noexcept {
+  Options result;
+  result.journal_mode = JournalMode::kWal;
+  // In WAL mode this still never corrupts DB, only last commits may be lost
+  // on power failure.
+  result.synchronous = Synchronous::kNormal;
+  result.mmap_size_bytes = 256 * 1024 * 1024;
+  result.cache_size_kib = 64 * 1024;
+  result.temp_store = TempStore::kMemory;
+  result.busy_timeout = std::chrono::seconds(5);
+  return result;
+}
+
+// static
+Database::Options Database::Options::LowMemoryPhone() noexcept {
+  Options result;
+  result.journal_mode = JournalMode::kWal;
+  result.synchronous = Synchronous::kNormal;
+  result.mmap_size_bytes = 16 * 1024 * 1024;
+  result.cache_size_kib = 4 * 1024;
+  result.temp_store = TempStore::kFile;
+  result.busy_timeout = std::chrono::seconds(5);
+  return result;
+}
+
+std::string Database::Options::ToString() const noexcept {
+  std::string result = "journal_mode=";
+  switch (journal_mode) {
+    case JournalMode::kDelete:
+      result += "delete";
+      break;
+    case JournalMode::kWal:
+      result += "wal";
+      break;
+    case JournalMode::kMemory:
+      result += "memory";
+      break;
+  }
+  result += " synchronous=";
+  switch (synchronous) {
+    case Synchronous::kOff:
+      result += "off";
+      break;
+    case Synchronous::kNormal:
+      result += "normal";
+      break;
+    case Synchronous::kFull:
+      result += "full";
+      break;
+  }
+  result += " mmap_size=" + std::to_string(mmap_size_bytes);
+  result += " cache_size=" + std::to_string(cache_size_kib) + "KiB";
+  result += " temp_store=";
+  switch (temp_store) {
+    case TempStore::kDefault:
+      result += "default";
+      break;
+    case TempStore::kFile:
+      result += "file";
+      break;
+    case TempStore::kMemory:
+      result += "memory";
+      break;
+  }
+  result += " busy_timeout=" + std::to_string(busy_timeout.count()) + "ms";
+  if (read_only) {
+    result += " read_only";
+  }
+  if (profile_queries) {
+    result += " profile_queries slow_query_threshold=" +
+        std::to_string(slow_query_threshold.count()) + "ms";
+  }
+  return result;
+}
+
 // static
 outcome::std_result<Database> Database::Open(
     const std::filesystem::path& db_path) noexcept {
+  return Open(db_path, Options());
+}
+
+// static
+outcome::std_result<Database> Database::Open(
+    const std::filesystem::path& db_path,
+    const Options& options) noexcept {
   sqlite3* connection = nullptr;
-  const int result = sqlite3_open(db_path.native().c_str(), &connection);
+  // Connection is never used by several threads simultaneously, so
+  // SQLite per-connection mutex is not needed.
+  const int flags = SQLITE_OPEN_NOMUTEX | (options.read_only ?
+      SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+  const int result = sqlite3_open_v2(
+      db_path.native().c_str(), &connection, flags, nullptr);
   if (result != SQLITE_OK) {
+    // Handle is allocated even on failure, except out-of-memory case.
+    sqlite3_close(connection);
     return ErrorCodeFromSqlite(result);
   }
-  return Database(connection);
+  Database db(connection);
+  const auto apply_result = db.ApplyOptions(options);
+  if (!apply_result) {
+    return apply_result.error();
+  }
+  if (options.profile_queries) {
+    db.profiler_ = std::make_unique<QueryProfiler>(
+        connection, options.slow_query_threshold);
+  }
+  return db;
+}
+
+outcome::std_result<void> Database::ApplyOptions(
+    const Options& options) noexcept {
+  VERIFY(options.journal_mode != Options::JournalMode::kMemory);
+  const int result = sqlite3_busy_timeout(
+      connection_, static_cast<int>(options.busy_timeout.count()));
+  if (result != SQLITE_OK) {
+    return ErrorCodeFromSqlite(result);
+  }
+  if (!options.read_only) {
+    const auto journal_result = ExecutePragma(
+        options.journal_mode == Options::JournalMode::kWal ?
+            "PRAGMA journal_mode=WAL" : "PRAGMA journal_mode=DELETE");
+    if (!journal_result) {
+      return journal_result.error();
+    }
+  }
+  // Pragma arguments can not be bound as parameters.
+  const std::string queries[] = {
+      "PRAGMA synchronous=" +
+          std::to_string(static_cast<int>(options.synchronous)),
+      "PRAGMA mmap_size=" + std::to_string(options.mmap_size_bytes),
+      // Negative value means size in KiB rather than in pages.
+      "PRAGMA cache_size=-" + std::to_string(options.cache_size_kib),
+      "PRAGMA temp_store=" +
+          std::to_string(static_cast<int>(options.temp_store)),
+  };
+  for (const std::string& query : queries) {
+    const auto pragma_result = ExecutePragma(query);
+    if (!pragma_result) {
+      return pragma_result.error();
+    }
+  }
+  return outcome::success();
+}
+
+outcome::std_result<Database::Options>
+    Database::LoadAppliedOptions() noexcept {
+  Options result;
+  result.read_only = (sqlite3_db_readonly(connection_, "main") == 1);
+  if (profiler_) {
+    result.profile_queries = true;
+    result.slow_query_threshold = profiler_->slow_query_threshold();
+  }
+  {
+    auto maybe_rows = Select("PRAGMA journal_mode");
+    if (!maybe_rows) {
+      return maybe_rows.error();
+    }
+    const auto next_outcome = maybe_rows.value().NextRow();
+    if (!next_outcome) {
+      return next_outcome.error();
+    }
+    const std::optional<std::string> mode =
+        maybe_rows.value().StringColumn(0);
+    VERIFY(mode);
+    if (*mode == "wal") {
+      result.journal_mode = Options::JournalMode::kWal;
+    } else if (*mode == "memory") {
+      result.journal_mode = Options::JournalMode::kMemory;
+    } else {
+      result.journal_mode = Options::JournalMode::kDelete;
+    }
+  }
+  const auto maybe_synchronous = LoadIntPragma("PRAGMA synchronous");
+  if (!maybe_synchronous) {
+    return maybe_synchronous.error();
+  }
+  result.synchronous =
+      static_cast<Options::Synchronous>(maybe_synchronous.value());
+  // In-memory databases return no rows for this pragma.
+  const auto maybe_mmap_size = LoadIntPragma("PRAGMA mmap_size");
+  if (maybe_mmap_size) {
+    result.mmap_size_bytes = maybe_mmap_size.value();
+  } else if (maybe_mmap_size.error() != SelectRows::kOutcomeDone.error()) {
+    return maybe_mmap_size.error();
+  }
+  const auto maybe_cache_size = LoadIntPragma("PRAGMA cache_size");
+  if (!maybe_cache_size) {
+    return maybe_cache_size.error();
+  }
+  if (maybe_cache_size.value() < 0) {
+    result.cache_size_kib = -maybe_cache_size.value();
+  } else {
+    // Positive value is number of pages.
+    const auto maybe_page_size = LoadIntPragma("PRAGMA page_size");
+    if (!maybe_page_size) {
+      return maybe_page_size.error();
+    }
+    result.cache_size_kib =
+        maybe_cache_size.value() * maybe_page_size.value() / 1024;
+  }
+  const auto maybe_temp_store = LoadIntPragma("PRAGMA temp_store");
+  if (!maybe_temp_store) {
+    return maybe_temp_store.error();
+  }
+  result.temp_store =
+      static_cast<Options::TempStore>(maybe_temp_store.value());
+  const auto maybe_busy_timeout = LoadIntPragma("PRAGMA busy_timeout");
+  if (!maybe_busy_timeout) {
+    return maybe_busy_timeout.error();
+  }
+  result.busy_timeout = std::chrono::milliseconds(maybe_busy_timeout.value());
+  return result;
+}
+
+outcome::std_result<void> Database::ExecutePragma(
+    std::string_view query) noexcept {
+  auto maybe_rows = Select(query);
+  if (!maybe_rows) {
+    return maybe_rows.error();
+  }
+  while (true) {
+    const auto next_outcome = maybe_rows.value().NextRow();
+    if (next_outcome == SelectRows::kOutcomeDone) {
+      return outcome::success();
+    }
+    if (!next_outcome) {
+      return next_outcome.error();
+    }
+  }
+}
+
+outcome::std_result<int64_t> Database::LoadIntPragma(
+    std::string_view query) noexcept {
+  auto maybe_rows = Select(query);
+  if (!maybe_rows) {
+    return maybe_rows.error();
+  }
+  const auto next_outcome = maybe_rows.value().NextRow();
+  if (!next_outcome) {
+    return next_outcome.error();
+  }
+  const std::optional<int64_t> value = maybe_rows.value().Int64Column(0);
+  VERIFY(value);
+  return *value;
 }
 
 Database::Database(sqlite3* connection) noexcept
-    : connection_(connection) {
+    : connection_(connection),
+      statement_cache_(std::make_unique<StatementCache>(
+          connection, kStatementCacheCapacity)) {
   VERIFY(connection_);
 }
 
 Database::~Database() {
   if (connection_) {
+    LogSlowQueries();
+    // Cached statements must be finalized before connection is closed.
+    statement_cache_.reset();
+    profiler_.reset();
     const int result = sqlite3_close(connection_);
     VERIFY(result == SQLITE_OK);
   }
 }
 
-outcome::std_result<SelectRows> Database::Select(
+outcome::std_result<sqlite3_stmt*> Database::PrepareWithParams(
     std::string_view query,
     const std::unordered_map<std::string, Param>& params) noexcept {
   VERIFY(connection_);  // Check that we're not moved-from.
-  sqlite3_stmt* stmt = nullptr;
-  const int result = sqlite3_prepare_v2(
-      connection_,
-      query.data(),
-      static_cast<int>(query.size()),
-      &stmt,
-      nullptr);
-  if (result != SQLITE_OK) {
-    return ErrorCodeFromSqlite(result);
+  LogSlowQueries();
+  auto maybe_stmt = statement_cache_->Acquire(query);
+  if (!maybe_stmt) {
+    return maybe_stmt.error();
   }
+  sqlite3_stmt* stmt = maybe_stmt.value();
   for (const auto& [key, value] : params) {
     const int index = sqlite3_bind_parameter_index(stmt, key.c_str());
     if (index == 0) {
-      const int result = sqlite3_finalize(stmt);
-      VERIFY(result == SQLITE_OK);
+      statement_cache_->Release(stmt);
       return ErrorCodes::kUnknownDbParameterName;
     }
     const outcome::std_result<void> bind_result = value.Bind(stmt, index);
     if (!bind_result) {
-      const int result = sqlite3_finalize(stmt);
-      VERIFY(result == SQLITE_OK);
+      statement_cache_->Release(stmt);
       return bind_result.error();
     }
   }
+  return stmt;
+}
 
-  return SelectRows(stmt);
+outcome::std_result<SelectRows> Database::Select(
+    std::string_view query,
+    const std::unordered_map<std::string, Param>& params) noexcept {
+  auto maybe_stmt = PrepareWithParams(query, params);
+  if (!maybe_stmt) {
+    return maybe_stmt.error();
+  }
+  return SelectRows(maybe_stmt.value(), statement_cache_.get());
 }
 
 outcome::std_result<int64_t> Database::Execute(
     const std::string_view query,
     const std::unordered_map<std::string, Param>& params) noexcept {
+  auto maybe_stmt = PrepareWithParams(query, params);
+  if (!maybe_stmt) {
+    return maybe_stmt.error();
+  }
+  return StepAndRelease(maybe_stmt.value());
+}
+
+std::vector<QueryProfiler::Entry> Database::QueryStats() const noexcept {
+  if (!profiler_) {
+    return {};
+  }
+  return profiler_->Stats();
+}
+
+outcome::std_result<int64_t> Database::ExecuteWithValues(
+    std::string_view query,
+    const std::vector<std::optional<int64_t>>& values) noexcept {
   VERIFY(connection_);  // Check that we're not moved-from.
-  sqlite3_stmt* stmt = nullptr;
-  const int result = sqlite3_prepare_v2(
-      connection_,
-      query.data(),
-      static_cast<int>(query.size()),
-      &stmt,
-      nullptr);
-  if (result != SQLITE_OK) {
-    return ErrorCodeFromSqlite(result);
+  LogSlowQueries();
+  auto maybe_stmt = statement_cache_->Acquire(query);
+  if (!maybe_stmt) {
+    return maybe_stmt.error();
   }
-  for (const auto& [key, value] : params) {
-    const int index = sqlite3_bind_parameter_index(stmt, key.c_str());
-    if (index == 0) {
-      const int result = sqlite3_finalize(stmt);
-      VERIFY(result == SQLITE_OK);
-      return ErrorCodes::kUnknownDbParameterName;
-    }
-    const outcome::std_result<void> bind_result = value.Bind(stmt, index);
-    if (!bind_result) {
-      const int result = sqlite3_finalize(stmt);
-      VERIFY(result == SQLITE_OK);
-      return bind_result.error();
+  sqlite3_stmt* stmt = maybe_stmt.value();
+  for (size_t i = 0; i < values.size(); ++i) {
+    const int bind_result = internal::BindValue(
+        stmt, static_cast<int>(i + 1), values[i]);
+    if (bind_result != SQLITE_OK) {
+      statement_cache_->Release(stmt);
+      return ErrorCodeFromSqlite(bind_result);
     }
   }
+  return StepAndRelease(stmt);
+}
+
+outcome::std_result<int64_t> Database::StepAndRelease(
+    sqlite3_stmt* stmt) noexcept {
   const int step_result = sqlite3_step(stmt);
+  statement_cache_->Release(stmt);
   if (step_result != SQLITE_DONE) {
-    return ErrorCodeFromSqlite(result);
+    return ErrorCodeFromSqlite(step_result);
   }
-  const int find_result = sqlite3_finalize(stmt);
-  VERIFY(find_result == SQLITE_OK);
   return sqlite3_last_insert_rowid(connection_);
 }
 
+// static
+int Database::ResolveParamIndex(
+    sqlite3_stmt* stmt, const char* name, int* index_slot) noexcept {
+  if (index_slot && *index_slot != 0) {
+    // Same query text may be used with parameters in different order, so
+    // check that cached index still matches the name.
+    const char* cached_name = sqlite3_bind_parameter_name(stmt, *index_slot);
+    if (cached_name && std::strcmp(cached_name, name) == 0) {
+      return *index_slot;
+    }
+  }
+  const int index = sqlite3_bind_parameter_index(stmt, name);
+  if (index_slot) {
+    *index_slot = index;
+  }
+  return index;
+}
+
+// static
+outcome::std_result<void> Database::ResultFromSqlite(int result) noexcept {
+  if (result != SQLITE_OK) {
+    return ErrorCodeFromSqlite(result);
+  }
+  return outcome::success();
+}
+
+outcome::std_result<Database::Transaction>
+    Database::BeginTransaction() noexcept {
+  VERIFY(connection_);  // Check that we're not moved-from.
+  Transaction result(this, transaction_depth_);
+  const std::string query = (transaction_depth_ == 0) ?
+      std::string("BEGIN IMMEDIATE") :
+      "SAVEPOINT " + result.SavepointName();
+  const auto maybe_result = Execute(query);
+  if (!maybe_result) {
+    result.db_ = nullptr;
+    return maybe_result.error();
+  }
+  ++transaction_depth_;
+  return result;
+}
+
+Database::Transaction::~Transaction() {
+  if (!db_) {
+    return;
+  }
+  VERIFY(db_->transaction_depth_ == depth_ + 1);
+  --db_->transaction_depth_;
+  // SQLite may already have rolled back the whole transaction by itself
+  // after some errors, e.g. SQLITE_FULL.
+  if (sqlite3_get_autocommit(db_->connection_)) {
+    return;
+  }
+  if (depth_ == 0) {
+    const auto maybe_result = db_->Execute("ROLLBACK");
+    VERIFY(maybe_result);
+  } else {
+    const std::string name = SavepointName();
+    auto maybe_result = db_->Execute("ROLLBACK TO " + name);
+    VERIFY(maybe_result);
+    maybe_result = db_->Execute("RELEASE " + name);
+    VERIFY(maybe_result);
+  }
+}
+
+outcome::std_result<void> Database::Transaction::Commit() noexcept {
+  VERIFY(db_);  // Transaction must be committed only once.
+  VERIFY(db_->transaction_depth_ == depth_ + 1);
+  const std::string query = (depth_ == 0) ?
+      std::string("COMMIT") :
+      "RELEASE " + SavepointName();
+  const auto maybe_result = db_->Execute(query);
+  if (!maybe_result) {
+    // Destructor will roll back.
+    return maybe_result.error();
+  }
+  --db_->transaction_depth_;
+  db_ = nullptr;
+  return outcome::success();
+}
+
 outcome::std_result<void> Database::Param::Bind(
     sqlite3_stmt* stmt, int index) const noexcept {
   const int result = std::visit(
@@ -6,23 +6,109 @@
 
 #include <sqlite3.h>
 
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include "app/error_codes.h"
+#include "app/query_profiler.h"
 #include "app/select_rows.h"
+#include "app/statement_cache.h"
 #include "app/verify.h"
 
 namespace m_time_tracker {
 
 class SelectRows;
 
-// NOTE: At present this class it NOT thread safe.
-// To make it so you need to update Execute() function logic.
+// Query parameter, bound by name. Created with |Bind()|.
+template<typename T>
+struct NamedParam {
+  // Must be string literal or otherwise outlive the query.
+  const char* name;
+  T value;
+};
+
+namespace internal {
+
+template<typename T>
+struct ParamValueType {
+  using type = T;
+};
+
+template<>
+struct ParamValueType<std::string> {
+  using type = std::string_view;
+};
+
+template<>
+struct ParamValueType<std::optional<std::string>> {
+  using type = std::optional<std::string_view>;
+};
+
+inline int BindValue(sqlite3_stmt* stmt, int index, int v) noexcept {
+  return sqlite3_bind_int(stmt, index, v);
+}
+
+inline int BindValue(sqlite3_stmt* stmt, int index, bool v) noexcept {
+  return sqlite3_bind_int(stmt, index, v ? 1 : 0);
+}
+
+inline int BindValue(sqlite3_stmt* stmt, int index, int64_t v) noexcept {
+  return sqlite3_bind_int64(stmt, index, v);
+}
+
+// String must be kept alive till statement is reset, since it is bound
+// in SQLITE_STATIC mode, without copying.
+inline int BindValue(
+    sqlite3_stmt* stmt, int index, std::string_view v) noexcept {
+  return sqlite3_bind_text(
+      stmt,
+      index,
+      v.data(),
+      static_cast<int>(v.size()),
+      SQLITE_STATIC);
+}
+
+inline int BindValue(
+    sqlite3_stmt* stmt, int index, const std::string& v) noexcept {
+  return BindValue(stmt, index, std::string_view(v));
+}
+
+template<typename T>
+int BindValue(
+    sqlite3_stmt* stmt, int index, const std::optional<T>& v) noexcept {
+  if (v) {
+    return BindValue(stmt, index, *v);
+  }
+  return sqlite3_bind_null(stmt, index);
+}
+
+}  // namespace internal
+
+template<typename T>
+NamedParam<typename internal::ParamValueType<T>::type> Bind(
+    const char* name, const T& value) noexcept {
+  return {name, value};
+}
+
+// Strings are not copied, so binding temporary would leave dangling pointer.
+template<typename T>
+NamedParam<typename internal::ParamValueType<T>::type> Bind(
+    const char* name, T&& value,
+    std::enable_if_t<std::is_same_v<T, std::string>>* = nullptr) = delete;
+
+// Owns one connection together with its statement cache. Object may be
+// used from any thread, but only by one thread at a time. Use DatabasePool
+// to run queries from several threads in parallel.
 class Database {
  public:
   class Param {
@@ -68,13 +154,103 @@ class Database {
     struct NullTag {};
     std::variant<int, int64_t, std::string, NullTag> value_;
   };
+  // Groups several writes into one commit. The outermost guard uses
+  // BEGIN IMMEDIATE / COMMIT, nested ones map to savepoints. If guard is
+  // destroyed without successful |Commit()|, all changes made since its
+  // creation are rolled back.
+  // Nested guards must be destroyed before enclosing ones.
+  class Transaction {
+   public:
+    Transaction(Transaction&& second) noexcept
+        : db_(second.db_),
+          depth_(second.depth_) {
+      second.db_ = nullptr;
+    }
+    ~Transaction();
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator = (const Transaction&) = delete;
+
+    outcome::std_result<void> Commit() noexcept;
+
+   private:
+    friend class Database;
+
+    Transaction(Database* db, int depth) noexcept
+        : db_(db),
+          depth_(depth) {}
+
+    std::string SavepointName() const noexcept {
+      return "tk_savepoint_" + std::to_string(depth_);
+    }
+
+    // nullptr if transaction is already committed or rolled back.
+    Database* db_;
+    // Zero for the outermost transaction.
+    const int depth_;
+  };
+
+  // Connection tuning, applied with PRAGMA statements on |Open()|.
+  // Default-constructed object represents SQLite defaults.
+  struct Options {
+    enum class JournalMode {
+      kDelete,
+      kWal,
+      // Only reported for in-memory databases, can not be requested.
+      kMemory,
+    };
+    enum class Synchronous {
+      kOff = 0,
+      kNormal = 1,
+      kFull = 2,
+    };
+    enum class TempStore {
+      kDefault = 0,
+      kFile = 1,
+      kMemory = 2,
+    };
+
+    // Preset for desktop computers - plenty of memory, fast disk.
+    static Options Desktop() noexcept;
+    // Preset for phones - little memory, slow eMMC flash.
+    static Options LowMemoryPhone() noexcept;
+
+    // Human-readable description, e.g. for diagnostic logs.
+    std::string ToString() const noexcept;
+
+    JournalMode journal_mode = JournalMode::kDelete;
+    Synchronous synchronous = Synchronous::kFull;
+    // Zero disables memory-mapped I/O.
+    int64_t mmap_size_bytes = 0;
+    int64_t cache_size_kib = 2000;
+    TempStore temp_store = TempStore::kDefault;
+    // How long writer waits for lock held by another connection.
+    std::chrono::milliseconds busy_timeout{0};
+    // Opens existing database for reading only. Journal mode of such
+    // connections is not changed, since it is stored in the DB file.
+    bool read_only = false;
+    // Collects per-query statistics, see |QueryStats()|.
+    bool profile_queries = false;
+    // If profiling is enabled, plans of queries running longer than that
+    // are logged. Zero disables logging.
+    std::chrono::milliseconds slow_query_threshold{0};
+  };
+
+  // Opens database with default SQLite settings.
   static outcome::std_result<Database> Open(
       const std::filesystem::path& db_path) noexcept;
+  static outcome::std_result<Database> Open(
+      const std::filesystem::path& db_path,
+      const Options& options) noexcept;
   ~Database();
 
   Database(const Database&) = delete;
   Database(Database&& second)
-     : connection_(second.connection_) {
+     : connection_(second.connection_),
+       statement_cache_(std::move(second.statement_cache_)),
+       profiler_(std::move(second.profiler_)),
+       transaction_depth_(second.transaction_depth_) {
+    VERIFY(transaction_depth_ == 0);
     second.connection_ = nullptr;
   }
 
@@ -91,10 +267,151 @@ class Database {
       const std::string_view query,
       const std::unordered_map<std::string, Param>& params) noexcept;
 
+  // Variants of the functions above, that don't allocate per parameter.
+  // Arguments wrapped with |Bind()| are bound by name, others - by their
+  // position in the argument list (?1, ?2, ...). Named parameter indices
+  // are resolved once per cached statement.
+  // Strings are bound without copying, so for |Select| they must outlive
+  // returned SelectRows.
+  template<typename... Args>
+  outcome::std_result<SelectRows> Select(
+      std::string_view query, const Args&... args) noexcept {
+    auto maybe_stmt = PrepareWithArgs(query, args...);
+    if (!maybe_stmt) {
+      return maybe_stmt.error();
+    }
+    return SelectRows(maybe_stmt.value(), statement_cache_.get());
+  }
+
+  template<typename... Args>
+  outcome::std_result<int64_t> Execute(
+      std::string_view query, const Args&... args) noexcept {
+    auto maybe_stmt = PrepareWithArgs(query, args...);
+    if (!maybe_stmt) {
+      return maybe_stmt.error();
+    }
+    return StepAndRelease(maybe_stmt.value());
+  }
+
+  // Rows of multi-row statements with up to 3 parameters per row, that
+  // keep them below default SQLite limit of 999 parameters, that older
+  // versions have.
+  static constexpr size_t kMaxRowsPerStatement = 256;
+
+  // Binds |values| to positional parameters ?1, ?2, ... in order. Intended
+  // for statements with variable number of parameters, e.g. multi-row
+  // INSERT. Returns last insert rowid.
+  outcome::std_result<int64_t> ExecuteWithValues(
+      std::string_view query,
+      const std::vector<std::optional<int64_t>>& values) noexcept;
+
+  outcome::std_result<Transaction> BeginTransaction() noexcept;
+
+  // Reads back settings, actually used by the connection. They may differ
+  // from requested ones, e.g. in-memory databases never use WAL.
+  outcome::std_result<Options> LoadAppliedOptions() noexcept;
+
+  // Returns empty vector unless connection was opened with
+  // |Options::profile_queries|. May be called from any thread.
+  std::vector<QueryProfiler::Entry> QueryStats() const noexcept;
+
+  const StatementCache::Stats& statement_cache_stats() const noexcept {
+    VERIFY(statement_cache_);  // Check that we're not moved-from.
+    return statement_cache_->stats();
+  }
+
  private:
   explicit Database(sqlite3* connection) noexcept;
 
+  outcome::std_result<void> ApplyOptions(const Options& options) noexcept;
+  // Runs PRAGMA statement, ignoring any rows it returns.
+  outcome::std_result<void> ExecutePragma(std::string_view query) noexcept;
+  // Runs PRAGMA statement, that returns single value.
+  outcome::std_result<int64_t> LoadIntPragma(std::string_view query) noexcept;
+
+  // Returns statement from |statement_cache_| with all |params| bound.
+  outcome::std_result<sqlite3_stmt*> PrepareWithParams(
+      std::string_view query,
+      const std::unordered_map<std::string, Param>& params) noexcept;
+
+  template<typename... Args>
+  outcome::std_result<sqlite3_stmt*> PrepareWithArgs(
+      std::string_view query, const Args&... args) noexcept {
+    VERIFY(connection_);  // Check that we're not moved-from.
+    LogSlowQueries();
+    auto maybe_stmt = statement_cache_->Acquire(query);
+    if (!maybe_stmt) {
+      return maybe_stmt.error();
+    }
+    sqlite3_stmt* stmt = maybe_stmt.value();
+    int* index_slots = statement_cache_->ParamIndexSlots(
+        stmt, sizeof...(Args));
+    const outcome::std_result<void> bind_result = BindArgs(
+        stmt, index_slots, std::index_sequence_for<Args...>(), args...);
+    if (!bind_result) {
+      statement_cache_->Release(stmt);
+      return bind_result.error();
+    }
+    return stmt;
+  }
+
+  template<typename... Args, size_t... Positions>
+  static outcome::std_result<void> BindArgs(
+      [[maybe_unused]] sqlite3_stmt* stmt,
+      [[maybe_unused]] int* index_slots,
+      std::index_sequence<Positions...>,
+      const Args&... args) noexcept {
+    outcome::std_result<void> result = outcome::success();
+    // Stops on the first failed binding.
+    const bool all_bound = (true && ... && (result = BindArg(
+        stmt,
+        static_cast<int>(Positions) + 1,
+        index_slots ? index_slots + Positions : nullptr,
+        args)));
+    VERIFY(all_bound == static_cast<bool>(result));
+    return result;
+  }
+
+  template<typename T>
+  static outcome::std_result<void> BindArg(
+      sqlite3_stmt* stmt, int position, int*, const T& value) noexcept {
+    return ResultFromSqlite(internal::BindValue(stmt, position, value));
+  }
+
+  template<typename T>
+  static outcome::std_result<void> BindArg(
+      sqlite3_stmt* stmt,
+      int,
+      int* index_slot,
+      const NamedParam<T>& param) noexcept {
+    const int index = ResolveParamIndex(stmt, param.name, index_slot);
+    if (index == 0) {
+      return ErrorCodes::kUnknownDbParameterName;
+    }
+    return ResultFromSqlite(internal::BindValue(stmt, index, param.value));
+  }
+
+  // Returns 0 if |stmt| has no parameter with such name.
+  // |index_slot| may be nullptr if statement is not cached.
+  static int ResolveParamIndex(
+      sqlite3_stmt* stmt, const char* name, int* index_slot) noexcept;
+  static outcome::std_result<void> ResultFromSqlite(int result) noexcept;
+  outcome::std_result<int64_t> StepAndRelease(sqlite3_stmt* stmt) noexcept;
+
+  void LogSlowQueries() noexcept {
+    if (profiler_) {
+      profiler_->LogSlowQueries();
+    }
+  }
+
   sqlite3* connection_ = nullptr;
+  // Held by pointer, since SelectRows objects refer to it and must
+  // survive moves of the Database.
+  std::unique_ptr<StatementCache> statement_cache_;
+  // Null unless profiling is enabled.
+  std::unique_ptr<QueryProfiler> profiler_;
+  // Number of currently alive Transaction objects.
+  int transaction_depth_ = 0;
 };
 
 }  // namespace m_time_tracker
@@ -0,0 +1,103 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/database_pool.h"
+
+#include <iterator>
+#include <utility>
+
+namespace m_time_tracker {
+
+DatabasePool::Reader::~Reader() {
+  if (db_) {
+    pool_->Release(db_);
+  }
+}
+
+// static
+outcome::std_result<std::unique_ptr<DatabasePool>> DatabasePool::Open(
+    const std::filesystem::path& db_path,
+    const Database::Options& options,
+    size_t reader_count) noexcept {
+  VERIFY(db_path != ":memory:");
+  VERIFY(reader_count > 0);
+  Database::Options writer_options = options;
+  writer_options.journal_mode = Database::Options::JournalMode::kWal;
+  writer_options.read_only = false;
+  // Writer goes first, since it creates DB file and switches it to WAL.
+  auto maybe_writer = Database::Open(db_path, writer_options);
+  if (!maybe_writer) {
+    return maybe_writer.error();
+  }
+  Database::Options reader_options = writer_options;
+  reader_options.read_only = true;
+  std::vector<Database> readers;
+  readers.reserve(reader_count);
+  for (size_t i = 0; i < reader_count; ++i) {
+    auto maybe_reader = Database::Open(db_path, reader_options);
+    if (!maybe_reader) {
+      return maybe_reader.error();
+    }
+    readers.emplace_back(std::move(maybe_reader.value()));
+  }
+  return std::unique_ptr<DatabasePool>(new DatabasePool(
+      std::move(maybe_writer.value()),
+      std::move(readers)));
+}
+
+DatabasePool::DatabasePool(
+    Database writer, std::vector<Database> readers) noexcept
+    : writer_(std::move(writer)),
+      readers_(std::move(readers)) {
+  free_readers_.reserve(readers_.size());
+  for (Database& reader : readers_) {
+    free_readers_.push_back(&reader);
+  }
+}
+
+DatabasePool::~DatabasePool() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // All Reader objects must be destroyed before the pool.
+  VERIFY(free_readers_.size() == readers_.size());
+}
+
+DatabasePool::Reader DatabasePool::AcquireReader() noexcept {
+  std::unique_lock<std::mutex> lock(mutex_);
+  reader_released_.wait(lock, [this]() { return !free_readers_.empty(); });
+  Database* db = free_readers_.back();
+  free_readers_.pop_back();
+  return Reader(this, db);
+}
+
+std::optional<DatabasePool::Reader> DatabasePool::TryAcquireReader() noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_readers_.empty()) {
+    return std::nullopt;
+  }
+  Database* db = free_readers_.back();
+  free_readers_.pop_back();
+  return Reader(this, db);
+}
+
+std::vector<QueryProfiler::Entry> DatabasePool::QueryStats() const noexcept {
+  std::vector<QueryProfiler::Entry> result = writer_.QueryStats();
+  for (const Database& reader : readers_) {
+    std::vector<QueryProfiler::Entry> reader_stats = reader.QueryStats();
+    result.insert(
+        result.end(),
+        std::make_move_iterator(reader_stats.begin()),
+        std::make_move_iterator(reader_stats.end()));
+  }
+  return QueryProfiler::Merge(std::move(result));
+}
+
+void DatabasePool::Release(Database* reader) noexcept {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_readers_.push_back(reader);
+  }
+  reader_released_.notify_one();
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,110 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "app/database.h"
+#include "app/error_codes.h"
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+// One writer connection plus several read-only connections to the same
+// database file in WAL mode, so readers work in parallel with each other
+// and with the writer.
+// Readers may be checked out from any thread. Writer is not guarded and
+// must be used by one thread only (UI thread in this application).
+class DatabasePool {
+ public:
+  // Read-only connection checked out of the pool. Returned back to the
+  // pool on destruction, so must not outlive it.
+  class Reader {
+   public:
+    Reader(Reader&& second) noexcept
+        : pool_(second.pool_),
+          db_(second.db_) {
+      second.db_ = nullptr;
+    }
+    ~Reader();
+
+    Reader(const Reader&) = delete;
+    Reader& operator = (const Reader&) = delete;
+
+    Database* get() const noexcept {
+      VERIFY(db_);
+      return db_;
+    }
+
+    Database* operator -> () const noexcept {
+      return get();
+    }
+
+    Database& operator * () const noexcept {
+      return *get();
+    }
+
+   private:
+    friend class DatabasePool;
+
+    Reader(DatabasePool* pool, Database* db) noexcept
+        : pool_(pool),
+          db_(db) {}
+
+    DatabasePool* pool_;
+    // nullptr if moved-from.
+    Database* db_;
+  };
+
+  // All connections use |options|, except that WAL journal mode is always
+  // enabled. |db_path| must point to a file - each connection to
+  // ":memory:" would open its own empty database.
+  static outcome::std_result<std::unique_ptr<DatabasePool>> Open(
+      const std::filesystem::path& db_path,
+      const Database::Options& options,
+      size_t reader_count) noexcept;
+
+  ~DatabasePool();
+
+  DatabasePool(const DatabasePool&) = delete;
+  DatabasePool& operator = (const DatabasePool&) = delete;
+
+  Database& writer() noexcept {
+    return writer_;
+  }
+
+  // Blocks until some reader is free.
+  Reader AcquireReader() noexcept;
+  // Returns nullopt if all readers are busy.
+  std::optional<Reader> TryAcquireReader() noexcept;
+
+  // Statistics of all connections, merged. Empty unless pool was opened
+  // with |Database::Options::profile_queries|.
+  std::vector<QueryProfiler::Entry> QueryStats() const noexcept;
+
+  size_t reader_count() const noexcept {
+    return readers_.size();
+  }
+
+ private:
+  DatabasePool(Database writer, std::vector<Database> readers) noexcept;
+
+  void Release(Database* reader) noexcept;
+
+  Database writer_;
+  // Never resized after construction, so pointers to elements are stable.
+  std::vector<Database> readers_;
+  std::mutex mutex_;
+  std::condition_variable reader_released_;
+  // Guarded by |mutex_|.
+  std::vector<Database*> free_readers_;
+};
+
+}  // namespace m_time_tracker
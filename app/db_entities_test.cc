@@ -4,17 +4,38 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
 #include <unordered_set>
 
 #include "app/activity.h"
+#include "app/activity_columns.h"
+#include "app/activity_interval_index.h"
+#include "app/daily_task_totals.h"
 #include "app/database.h"
+#include "app/database_pool.h"
+#include "app/history_generator.h"
+#include "app/schema_migrations.h"
+#include "app/stats_cache.h"
 #include "app/task.h"
+#include "app/task_repository.h"
 #include "app/verify.h"
 
 using m_time_tracker::Activity;
+using m_time_tracker::ActivityColumns;
+using m_time_tracker::ActivityIntervalIndex;
 using m_time_tracker::Database;
+using m_time_tracker::DatabasePool;
+using m_time_tracker::SelectRows;
+using m_time_tracker::StatsCache;
 using m_time_tracker::Task;
+using m_time_tracker::TaskRef;
+using m_time_tracker::TaskRepository;
 namespace outcome = m_time_tracker::outcome;
 
 template<typename Type>
@@ -36,10 +57,8 @@ class DbEntitiesTest : public ::testing::Test {
       VERIFY(false);
     }
     db_.emplace(std::move(maybe_db.value()));
-    auto create_outcome = Task::EnsureTableCreated(db());
-    VERIFY(create_outcome);
-    create_outcome = Activity::EnsureTableCreated(db());
-    VERIFY(create_outcome);
+    const auto upgrade_outcome = m_time_tracker::UpgradeSchema(db());
+    VERIFY(upgrade_outcome);
   }
 
  protected:
@@ -114,6 +133,256 @@ TEST_F(DbEntitiesTest, TaskSave) {
   }
 }
 
+TEST_F(DbEntitiesTest, TaskHierarchyOfAnyDepth) {
+  // Distance from |ancestor| to |descendant|, if it is in the subtree.
+  auto closure_depth = [this](const Task& ancestor, const Task& descendant) {
+    auto maybe_rows = db()->Select(
+        "SELECT depth FROM TaskClosure "
+        " WHERE ancestor = ?1 AND descendant = ?2",
+        *ancestor.id(),
+        *descendant.id());
+    VERIFY(maybe_rows);
+    std::optional<int64_t> result;
+    for (SelectRows& row : maybe_rows.value()) {
+      result = std::get<0>(row.Get<int64_t>());
+    }
+    return result;
+  };
+  Task root("root");
+  ASSERT_TRUE(root.Save(db()));
+  Task child("child");
+  child.SetParentTask(root);
+  ASSERT_TRUE(child.Save(db()));
+  Task grandchild("grandchild");
+  grandchild.SetParentTask(child);
+  ASSERT_TRUE(grandchild.Save(db()));
+  Task other("other");
+  ASSERT_TRUE(other.Save(db()));
+  EXPECT_EQ(closure_depth(root, root), 0);
+  EXPECT_EQ(closure_depth(root, child), 1);
+  EXPECT_EQ(closure_depth(root, grandchild), 2);
+  EXPECT_EQ(closure_depth(child, grandchild), 1);
+  EXPECT_EQ(closure_depth(grandchild, root), std::nullopt);
+
+  const Activity::TimePoint start = Activity::TimePointFromInt(1000000);
+  std::vector<Activity> activities;
+  activities.emplace_back(grandchild, start);
+  activities.back().SetInterval(start, start + std::chrono::hours(1));
+  activities.emplace_back(child, start);
+  activities.back().SetInterval(
+      start + std::chrono::hours(1), start + std::chrono::hours(3));
+  activities.emplace_back(other, start);
+  activities.back().SetInterval(
+      start + std::chrono::hours(3), start + std::chrono::hours(4));
+  ASSERT_TRUE(Activity::SaveBatch(db(), &activities));
+  const Activity::TimePoint end = start + std::chrono::hours(4);
+  VerifyActivityStats(
+      Activity::LoadStatsForTopLevelTasksInInterval(db(), start, end),
+      {{*root.id(), std::chrono::hours(3)},
+       {*other.id(), std::chrono::hours(1)}});
+  VerifyActivityStats(
+      Activity::LoadStatsForInterval(db(), start, end, *root.id()),
+      {{*child.id(), std::chrono::hours(3)}});
+  VerifyActivityStats(
+      Activity::LoadStatsForInterval(db(), start, end, *child.id()),
+      {{*grandchild.id(), std::chrono::hours(1)}});
+  const auto maybe_top_level_groups = Activity::LoadStatGroups(
+      db(), std::nullopt);
+  ASSERT_TRUE(maybe_top_level_groups);
+  EXPECT_EQ(maybe_top_level_groups.value(),
+            (std::unordered_map<Task::Id, Task::Id>{
+                {*root.id(), *root.id()},
+                {*child.id(), *root.id()},
+                {*grandchild.id(), *root.id()},
+                {*other.id(), *other.id()}}));
+  const auto maybe_root_groups = Activity::LoadStatGroups(db(), *root.id());
+  ASSERT_TRUE(maybe_root_groups);
+  EXPECT_EQ(maybe_root_groups.value(),
+            (std::unordered_map<Task::Id, Task::Id>{
+                {*child.id(), *child.id()},
+                {*grandchild.id(), *child.id()}}));
+
+  // Moving task moves its whole subtree.
+  child.SetParentTask(other);
+  ASSERT_TRUE(child.Save(db()));
+  EXPECT_EQ(closure_depth(root, grandchild), std::nullopt);
+  EXPECT_EQ(closure_depth(other, grandchild), 2);
+  EXPECT_EQ(closure_depth(child, grandchild), 1);
+  auto maybe_index = ActivityIntervalIndex::Load(db());
+  ASSERT_TRUE(maybe_index);
+  VerifyActivityStats(
+      Activity::LoadStatsForTopLevelTasksInInterval(
+          db(), start, end, maybe_index.value().get()),
+      {{*other.id(), std::chrono::hours(4)}});
+
+  // Task can not become a descendant of itself.
+  other.SetParentTask(grandchild);
+  const auto cycle_result = other.Save(db());
+  ASSERT_FALSE(cycle_result);
+  EXPECT_EQ(
+      cycle_result.error(), m_time_tracker::ErrorCodes::kTaskHierarchyCycle);
+  other.set_parent_task_id(other.id());
+  EXPECT_FALSE(other.Save(db()));
+  auto maybe_other = Task::LoadById(db(), *other.id());
+  ASSERT_TRUE(maybe_other);
+  EXPECT_EQ(maybe_other.value().parent_task_id(), std::nullopt);
+
+  child.set_parent_task_id(std::nullopt);
+  ASSERT_TRUE(child.Save(db()));
+  EXPECT_EQ(closure_depth(other, grandchild), std::nullopt);
+  EXPECT_EQ(closure_depth(child, grandchild), 1);
+}
+
+TEST_F(DbEntitiesTest, TwoLevelStats) {
+  Task root("root");
+  root.set_archived(true);
+  ASSERT_TRUE(root.Save(db()));
+  Task child("child");
+  child.SetParentTask(root);
+  ASSERT_TRUE(child.Save(db()));
+  Task grandchild("grandchild");
+  grandchild.SetParentTask(child);
+  ASSERT_TRUE(grandchild.Save(db()));
+  Task other("other");
+  ASSERT_TRUE(other.Save(db()));
+  Task idle("idle");
+  ASSERT_TRUE(idle.Save(db()));
+
+  const Activity::TimePoint start = Activity::TimePointFromInt(1000000);
+  std::vector<Activity> activities;
+  activities.emplace_back(grandchild, start);
+  activities.back().SetInterval(start, start + std::chrono::hours(1));
+  activities.emplace_back(child, start);
+  activities.back().SetInterval(
+      start + std::chrono::hours(1), start + std::chrono::hours(3));
+  activities.emplace_back(other, start);
+  activities.back().SetInterval(
+      start + std::chrono::hours(3), start + std::chrono::hours(4));
+  ASSERT_TRUE(Activity::SaveBatch(db(), &activities));
+  const Activity::TimePoint end = start + std::chrono::hours(4);
+  auto maybe_index = ActivityIntervalIndex::Load(db());
+  ASSERT_TRUE(maybe_index);
+
+  for (const ActivityIntervalIndex* index :
+       {static_cast<const ActivityIntervalIndex*>(nullptr),
+        static_cast<const ActivityIntervalIndex*>(
+            maybe_index.value().get())}) {
+    auto maybe_top_level = Activity::LoadTwoLevelStats(
+        db(), start, end, std::nullopt, index);
+    ASSERT_TRUE(maybe_top_level);
+    const std::vector<Activity::StatEntry>& top_level =
+        maybe_top_level.value().level.stats;
+    // Tasks without time in the interval are not listed; others are
+    // ordered by id.
+    ASSERT_EQ(top_level.size(), 2u);
+    EXPECT_EQ(top_level[0].task_id, *root.id());
+    EXPECT_EQ(top_level[0].duration, std::chrono::hours(3));
+    EXPECT_EQ(top_level[1].task_id, *other.id());
+    EXPECT_EQ(top_level[1].duration, std::chrono::hours(1));
+
+    auto maybe_two_level = Activity::LoadTwoLevelStats(
+        db(), start, end, *root.id(), index);
+    ASSERT_TRUE(maybe_two_level);
+    const Activity::TwoLevelStats& two_level = maybe_two_level.value();
+    ASSERT_EQ(two_level.level.stats.size(), 1u);
+    EXPECT_EQ(two_level.level.stats[0].task_id, *child.id());
+    EXPECT_EQ(two_level.level.stats[0].duration, std::chrono::hours(3));
+    EXPECT_EQ(two_level.level.groups,
+              (std::unordered_map<Task::Id, Task::Id>{
+                  {*child.id(), *child.id()},
+                  {*grandchild.id(), *child.id()}}));
+    ASSERT_EQ(two_level.child_levels.size(), 1u);
+    const Activity::StatsLevel& child_level =
+        two_level.child_levels.at(*child.id());
+    ASSERT_EQ(child_level.stats.size(), 1u);
+    EXPECT_EQ(child_level.stats[0].task_id, *grandchild.id());
+    EXPECT_EQ(child_level.stats[0].duration, std::chrono::hours(1));
+    EXPECT_EQ(child_level.groups,
+              (std::unordered_map<Task::Id, Task::Id>{
+                  {*grandchild.id(), *grandchild.id()}}));
+  }
+}
+
+TEST_F(DbEntitiesTest, TaskRepositoryFollowsSavedTasks) {
+  Task parent("parent");
+  ASSERT_TRUE(parent.Save(db()));
+  Task other_parent("other_parent");
+  ASSERT_TRUE(other_parent.Save(db()));
+  Task child("child");
+  child.SetParentTask(parent);
+  ASSERT_TRUE(child.Save(db()));
+
+  auto maybe_tasks = TaskRepository::Load(db());
+  ASSERT_TRUE(maybe_tasks);
+  TaskRepository& tasks = maybe_tasks.value();
+  EXPECT_EQ(tasks.size(), 3u);
+  const TaskRef found = tasks.FindById(*child.id());
+  ASSERT_TRUE(found);
+  EXPECT_EQ(found->name(), "child");
+  EXPECT_EQ(tasks.FindById(*child.id()), found);  // Same snapshot.
+  EXPECT_EQ(tasks.FindByName("parent"), tasks.FindById(*parent.id()));
+  EXPECT_EQ(tasks.FindByName("unknown"), nullptr);
+  EXPECT_EQ(
+      tasks.ChildIds(std::nullopt),
+      (std::set<Task::Id>{*parent.id(), *other_parent.id()}));
+  EXPECT_EQ(tasks.ChildIds(parent.id()), std::set<Task::Id>{*child.id()});
+  EXPECT_TRUE(tasks.ChildIds(child.id()).empty());
+
+  // Rename and move child; old snapshot must stay unchanged.
+  child.set_name("moved_child");
+  child.SetParentTask(other_parent);
+  ASSERT_TRUE(child.Save(db()));
+  const TaskRef moved = tasks.Put(child);
+  EXPECT_EQ(tasks.size(), 3u);
+  EXPECT_EQ(found->name(), "child");
+  EXPECT_EQ(found->parent_task_id(), parent.id());
+  EXPECT_EQ(moved->name(), "moved_child");
+  EXPECT_EQ(moved->parent_task_id(), other_parent.id());
+  EXPECT_EQ(tasks.FindById(*child.id()), moved);
+  EXPECT_EQ(tasks.FindByName("child"), nullptr);
+  EXPECT_EQ(tasks.FindByName("moved_child"), moved);
+  EXPECT_TRUE(tasks.ChildIds(parent.id()).empty());
+  EXPECT_EQ(
+      tasks.ChildIds(other_parent.id()), std::set<Task::Id>{*child.id()});
+
+  Task new_task("new_task");
+  ASSERT_TRUE(new_task.Save(db()));
+  tasks.Put(new_task);
+  EXPECT_EQ(tasks.size(), 4u);
+  EXPECT_EQ(tasks.ChildIds(std::nullopt).count(*new_task.id()), 1u);
+  const std::vector<TaskRef> all_tasks = tasks.All();
+  ASSERT_EQ(all_tasks.size(), 4u);
+  EXPECT_EQ(all_tasks[0], tasks.FindById(*parent.id()));
+  EXPECT_EQ(all_tasks[2], moved);
+  EXPECT_EQ(all_tasks[3], tasks.FindById(*new_task.id()));
+}
+
+TEST_F(DbEntitiesTest, TaskRepositoryAncestors) {
+  Task root("root");
+  ASSERT_TRUE(root.Save(db()));
+  Task child("child");
+  child.SetParentTask(root);
+  ASSERT_TRUE(child.Save(db()));
+  Task grandchild("grandchild");
+  grandchild.SetParentTask(child);
+  ASSERT_TRUE(grandchild.Save(db()));
+  Task other("other");
+  ASSERT_TRUE(other.Save(db()));
+
+  auto maybe_tasks = TaskRepository::Load(db());
+  ASSERT_TRUE(maybe_tasks);
+  const TaskRepository& tasks = maybe_tasks.value();
+  EXPECT_EQ(tasks.TopLevelAncestorId(*root.id()), *root.id());
+  EXPECT_EQ(tasks.TopLevelAncestorId(*child.id()), *root.id());
+  EXPECT_EQ(tasks.TopLevelAncestorId(*grandchild.id()), *root.id());
+  EXPECT_EQ(tasks.TopLevelAncestorId(*other.id()), *other.id());
+  EXPECT_TRUE(tasks.IsInSubtree(*root.id(), *root.id()));
+  EXPECT_TRUE(tasks.IsInSubtree(*grandchild.id(), *root.id()));
+  EXPECT_TRUE(tasks.IsInSubtree(*grandchild.id(), *child.id()));
+  EXPECT_FALSE(tasks.IsInSubtree(*child.id(), *grandchild.id()));
+  EXPECT_FALSE(tasks.IsInSubtree(*grandchild.id(), *other.id()));
+}
+
 TEST_F(DbEntitiesTest, TaskLoad) {
   // Parent tasks
   Task foo("foo");
@@ -331,6 +600,38 @@ TEST_F(DbEntitiesTest, ActivityLoad) {
   }
 }
 
+TEST_F(DbEntitiesTest, ActivitySaveBatch) {
+  Task foo("foo");
+  ASSERT_TRUE(foo.Save(db()));
+  Activity single(foo, Activity::GetCurrentTimePoint());
+  ASSERT_TRUE(single.Save(db()));
+
+  const Activity::TimePoint start_time = Activity::GetCurrentTimePoint();
+  std::vector<Activity> batch;
+  // More than fits in one INSERT statement.
+  for (int i = 0; i < 600; ++i) {
+    Activity a(foo, start_time);
+    a.SetInterval(
+        start_time + std::chrono::minutes(i),
+        start_time + std::chrono::minutes(i + 1));
+    batch.push_back(a);
+  }
+  ASSERT_TRUE(Activity::SaveBatch(db(), &batch));
+  for (const Activity& a : batch) {
+    ASSERT_TRUE(a.id());
+    const auto maybe_loaded = Activity::LoadById(db(), *a.id());
+    ASSERT_TRUE(maybe_loaded);
+    EXPECT_EQ(maybe_loaded.value().start_time(), a.start_time());
+    EXPECT_EQ(maybe_loaded.value().end_time(), a.end_time());
+  }
+  const auto maybe_all = Activity::LoadAll(db());
+  ASSERT_TRUE(maybe_all);
+  EXPECT_EQ(maybe_all.value().size(), 601u);
+  std::unordered_set<Activity::Id> ids;
+  AddIdsToSet(maybe_all.value(), &ids);
+  EXPECT_EQ(ids.size(), 601u);
+}
+
 TEST_F(DbEntitiesTest, LoadEarliestActivityStart) {
   Task foo("foo");
 
@@ -462,6 +763,18 @@ TEST_F(DbEntitiesTest, ActivityStatsForIntervalBothChildrenIncluded) {
       {*foo.id(), std::chrono::minutes(1)},
     });
   }
+  {
+    // Interval starts where first entry ends and ends exactly where
+    // second entry ends.
+    auto maybe_result = Activity::LoadStatsForInterval(
+        db(),
+        start_time + std::chrono::minutes(5),
+        start_time + std::chrono::minutes(13),
+        *parent.id());
+    VerifyActivityStats(maybe_result, {
+      {*bar.id(), std::chrono::minutes(8)},
+    });
+  }
 }
 
 TEST_F(DbEntitiesTest, ActivityStatsForIntervalOneChildIncluded) {
@@ -594,6 +907,373 @@ struct ActivityInfo {
   Activity::TimePoint end_time;
 };
 
+TEST_F(DbEntitiesTest, DailyTaskTotalsFollowActivities) {
+  using m_time_tracker::DailyTaskTotals;
+  auto load_totals = [this]() {
+    std::vector<std::tuple<int64_t, int64_t, int64_t>> result;
+    auto maybe_rows = db()->Select(
+        "SELECT day, task_id, seconds FROM DailyTaskTotals ORDER BY day");
+    VERIFY(maybe_rows);
+    for (SelectRows& row : maybe_rows.value()) {
+      result.push_back(row.Get<int64_t, int64_t, int64_t>());
+    }
+    VERIFY(maybe_rows.value().status());
+    return result;
+  };
+  Task task("task");
+  ASSERT_TRUE(task.Save(db()));
+  const Task::Id task_id = *task.id();
+  // Mid-January, far from DST switches.
+  const Activity::TimePoint day_start = DailyTaskTotals::LocalDayStart(
+      Activity::TimePointFromInt(1579089600));
+  const Activity::TimePoint next_day_start =
+      DailyTaskTotals::NextLocalDayStart(day_start);
+  const int64_t day = Activity::IntFromTimePoint(day_start);
+  const int64_t next_day = Activity::IntFromTimePoint(next_day_start);
+
+  // Running activities are not accounted.
+  Activity activity(task, next_day_start - std::chrono::hours(2));
+  ASSERT_TRUE(activity.Save(db()));
+  EXPECT_TRUE(load_totals().empty());
+
+  // Activity crossing midnight is split between days.
+  activity.SetInterval(
+      next_day_start - std::chrono::hours(2),
+      next_day_start + std::chrono::hours(1));
+  ASSERT_TRUE(activity.Save(db()));
+  using Totals = std::vector<std::tuple<int64_t, int64_t, int64_t>>;
+  EXPECT_EQ(load_totals(), (Totals{
+      {day, task_id, 2 * 3600},
+      {next_day, task_id, 3600}}));
+
+  std::vector<Activity> batch;
+  batch.emplace_back(task, day_start);
+  batch.back().SetInterval(day_start, day_start + std::chrono::minutes(10));
+  ASSERT_TRUE(Activity::SaveBatch(db(), &batch));
+  EXPECT_EQ(load_totals(), (Totals{
+      {day, task_id, 2 * 3600 + 600},
+      {next_day, task_id, 3600}}));
+
+  // Days, that lost all their time, are removed.
+  activity.SetInterval(
+      day_start + std::chrono::hours(1),
+      day_start + std::chrono::hours(2));
+  ASSERT_TRUE(activity.Save(db()));
+  EXPECT_EQ(load_totals(), (Totals{{day, task_id, 3600 + 600}}));
+  ASSERT_TRUE(Activity::Delete(db(), *activity.id()));
+  ASSERT_TRUE(Activity::Delete(db(), *batch.front().id()));
+  EXPECT_TRUE(load_totals().empty());
+
+  // Rebuild gives the same result as incremental updates.
+  batch = {Activity(task, day_start)};
+  batch.back().SetInterval(day_start, next_day_start + std::chrono::hours(5));
+  ASSERT_TRUE(Activity::SaveBatch(db(), &batch));
+  const Totals incremental_totals = load_totals();
+  ASSERT_TRUE(DailyTaskTotals::Rebuild(db()));
+  EXPECT_EQ(load_totals(), incremental_totals);
+}
+
+// Compares stats, that use daily totals, with stats computed from
+// activities directly, for intervals with different alignment to days.
+TEST_F(DbEntitiesTest, ActivityStatsMatchRawActivities) {
+  using m_time_tracker::DailyTaskTotals;
+  Task parent("parent");
+  ASSERT_TRUE(parent.Save(db()));
+  Task child("child");
+  child.SetParentTask(parent);
+  ASSERT_TRUE(child.Save(db()));
+  Task other("other");
+  ASSERT_TRUE(other.Save(db()));
+
+  const Activity::TimePoint first_day_start = DailyTaskTotals::LocalDayStart(
+      Activity::TimePointFromInt(1579089600));
+  std::vector<Activity> activities;
+  Activity::TimePoint current = first_day_start + std::chrono::hours(1);
+  for (int i = 0; i < 40; ++i) {
+    // Durations from 1 to 19 hours, so many of activities cross midnight.
+    const Activity::Duration duration = std::chrono::hours(1 + (i * 7) % 19);
+    activities.emplace_back((i % 3 == 0) ? other : child, current);
+    activities.back().SetInterval(current, current + duration);
+    current += duration + std::chrono::minutes(17);
+  }
+  ASSERT_TRUE(Activity::SaveBatch(db(), &activities));
+  auto maybe_index = ActivityIntervalIndex::Load(db());
+  ASSERT_TRUE(maybe_index);
+  const ActivityIntervalIndex* index = maybe_index.value().get();
+
+  for (int start_offset_hours = 0; start_offset_hours < 48;
+       start_offset_hours += 5) {
+    for (int length_hours : {1, 20, 24, 49, 150, 400}) {
+      const Activity::TimePoint from =
+          first_day_start + std::chrono::hours(start_offset_hours);
+      const Activity::TimePoint to = from + std::chrono::hours(length_hours);
+      std::unordered_map<Task::Id, Activity::Duration> expected_top_level;
+      std::unordered_map<Task::Id, Activity::Duration> expected_children;
+      for (const Activity& a : activities) {
+        const auto clipped_start = std::max(from, a.start_time());
+        const auto clipped_end = std::min(to, *a.end_time());
+        if (clipped_start >= clipped_end) {
+          continue;
+        }
+        const Activity::Duration duration = clipped_end - clipped_start;
+        if (a.task_id() == *child.id()) {
+          expected_top_level[*parent.id()] += duration;
+          expected_children[*child.id()] += duration;
+        } else {
+          expected_top_level[*other.id()] += duration;
+        }
+      }
+      VerifyActivityStats(
+          Activity::LoadStatsForTopLevelTasksInInterval(db(), from, to),
+          expected_top_level);
+      VerifyActivityStats(
+          Activity::LoadStatsForInterval(db(), from, to, *parent.id()),
+          expected_children);
+      VerifyActivityStats(
+          Activity::LoadStatsForTopLevelTasksInInterval(db(), from, to, index),
+          expected_top_level);
+      VerifyActivityStats(
+          Activity::LoadStatsForInterval(db(), from, to, *parent.id(), index),
+          expected_children);
+      for (const ActivityIntervalIndex* two_level_index : {
+               static_cast<const ActivityIntervalIndex*>(nullptr), index}) {
+        auto maybe_two_level = Activity::LoadTwoLevelStats(
+            db(), from, to, std::nullopt, two_level_index);
+        ASSERT_TRUE(maybe_two_level);
+        const Activity::TwoLevelStats& two_level = maybe_two_level.value();
+        VerifyActivityStats(
+            two_level.level.stats, expected_top_level);
+        ASSERT_EQ(
+            two_level.child_levels.size(), expected_top_level.size());
+        if (expected_top_level.count(*parent.id()) != 0) {
+          VerifyActivityStats(
+              two_level.child_levels.at(*parent.id()).stats,
+              expected_children);
+        }
+        if (expected_top_level.count(*other.id()) != 0) {
+          EXPECT_TRUE(two_level.child_levels.at(*other.id()).stats.empty());
+        }
+      }
+    }
+  }
+}
+
+TEST_F(DbEntitiesTest, BucketedStatsMatchIntervalStats) {
+  m_time_tracker::HistoryGeneratorParams params;
+  params.tasks_per_level = {3, 10};
+  params.activity_count = 500;
+  params.history_start = m_time_tracker::DailyTaskTotals::LocalDayStart(
+      Activity::TimePointFromInt(1579089600));
+  params.history_span = std::chrono::hours(24 * 70);
+  auto maybe_history = m_time_tracker::GenerateHistory(db(), params);
+  ASSERT_TRUE(maybe_history);
+  const Task& parent = maybe_history.value().tasks_by_level[0][0];
+  auto maybe_index = ActivityIntervalIndex::Load(db());
+  ASSERT_TRUE(maybe_index);
+  const ActivityIntervalIndex* index = maybe_index.value().get();
+  const Activity::TimePoint from =
+      params.history_start + std::chrono::hours(27) + std::chrono::seconds(5);
+  const Activity::TimePoint to =
+      from + std::chrono::hours(24 * 65 + 7);
+
+  for (const Activity::BucketKind bucket_kind : {
+           Activity::BucketKind::kDay,
+           Activity::BucketKind::kWeek,
+           Activity::BucketKind::kMonth}) {
+    for (const std::optional<Task::Id> parent_task_id :
+         {std::optional<Task::Id>(), parent.id()}) {
+      for (const ActivityIntervalIndex* bucket_index : {
+               static_cast<const ActivityIntervalIndex*>(nullptr), index}) {
+        auto maybe_stats = Activity::LoadBucketedStats(
+            db(), from, to, bucket_kind, parent_task_id, bucket_index);
+        ASSERT_TRUE(maybe_stats);
+        const Activity::BucketedStats& stats = maybe_stats.value();
+        ASSERT_FALSE(stats.bucket_starts.empty());
+        EXPECT_EQ(stats.bucket_starts.front(), from);
+        ASSERT_EQ(
+            stats.durations.size(),
+            stats.bucket_starts.size() * stats.task_ids.size());
+        for (size_t bucket = 0; bucket < stats.bucket_starts.size();
+             ++bucket) {
+          const Activity::TimePoint bucket_start = stats.bucket_starts[bucket];
+          const Activity::TimePoint bucket_end =
+              (bucket + 1 < stats.bucket_starts.size()) ?
+                  stats.bucket_starts[bucket + 1] : to;
+          ASSERT_LT(bucket_start, bucket_end);
+          if (bucket > 0) {
+            EXPECT_EQ(
+                m_time_tracker::DailyTaskTotals::LocalDayStart(bucket_start),
+                bucket_start);
+          }
+          std::unordered_map<Task::Id, Activity::Duration> bucket_durations;
+          for (size_t i = 0; i < stats.task_ids.size(); ++i) {
+            if (stats.duration(bucket, i).count() > 0) {
+              bucket_durations[stats.task_ids[i]] = stats.duration(bucket, i);
+            }
+          }
+          if (parent_task_id) {
+            VerifyActivityStats(
+                Activity::LoadStatsForInterval(
+                    db(), bucket_start, bucket_end, *parent_task_id),
+                bucket_durations);
+          } else {
+            VerifyActivityStats(
+                Activity::LoadStatsForTopLevelTasksInInterval(
+                    db(), bucket_start, bucket_end),
+                bucket_durations);
+          }
+        }
+      }
+    }
+  }
+  auto maybe_weeks = Activity::LoadBucketedStats(
+      db(), from, to, Activity::BucketKind::kWeek, std::nullopt);
+  ASSERT_TRUE(maybe_weeks);
+  EXPECT_EQ(maybe_weeks.value().bucket_starts.size(), 10u);
+  auto maybe_months = Activity::LoadBucketedStats(
+      db(), from, to, Activity::BucketKind::kMonth, std::nullopt);
+  ASSERT_TRUE(maybe_months);
+  EXPECT_EQ(maybe_months.value().bucket_starts.size(), 3u);
+}
+
+TEST_F(DbEntitiesTest, ActivityIntervalIndexFollowsChanges) {
+  Task foo("foo");
+  ASSERT_TRUE(foo.Save(db()));
+  Task bar("bar");
+  ASSERT_TRUE(bar.Save(db()));
+  const Activity::TimePoint start = Activity::TimePointFromInt(1000000);
+  auto verify_same_as_db = [&](ActivityIntervalIndex* index) {
+    for (const std::optional<Task::Id> task_id :
+         {std::optional<Task::Id>(), foo.id(), bar.id()}) {
+      auto from_db = Activity::LoadFiltered(
+          db(), task_id, start + std::chrono::minutes(10), std::nullopt);
+      auto from_index = Activity::LoadFiltered(
+          db(), task_id, start + std::chrono::minutes(10), std::nullopt,
+          index);
+      ASSERT_TRUE(from_db);
+      ASSERT_TRUE(from_index);
+      std::unordered_set<Activity::Id> db_ids;
+      std::unordered_set<Activity::Id> index_ids;
+      AddIdsToSet(from_db.value(), &db_ids);
+      AddIdsToSet(from_index.value(), &index_ids);
+      EXPECT_EQ(db_ids, index_ids);
+    }
+  };
+
+  CreateTestActivitiesRecords(start, foo, bar);
+  auto maybe_index = ActivityIntervalIndex::Load(db());
+  ASSERT_TRUE(maybe_index);
+  ActivityIntervalIndex* index = maybe_index.value().get();
+  // Running activity is not indexed.
+  EXPECT_EQ(index->size(), 3u);
+  verify_same_as_db(index);
+
+  Activity added(foo, start + std::chrono::minutes(30));
+  added.SetInterval(
+      start + std::chrono::minutes(30), start + std::chrono::minutes(40));
+  ASSERT_TRUE(added.Save(db()));
+  index->Add(added);
+  verify_same_as_db(index);
+
+  // Batch, that is partially earlier than existing activities.
+  std::vector<Activity> batch;
+  for (int minutes : {50, 11, 60}) {
+    batch.emplace_back(bar, start + std::chrono::minutes(minutes));
+    batch.back().SetInterval(
+        start + std::chrono::minutes(minutes),
+        start + std::chrono::minutes(minutes + 1));
+  }
+  ASSERT_TRUE(Activity::SaveBatch(db(), &batch));
+  index->AddBatch(batch);
+  verify_same_as_db(index);
+
+  added.SetInterval(
+      start + std::chrono::minutes(5), start + std::chrono::minutes(45));
+  added.SetTask(bar);
+  ASSERT_TRUE(added.Save(db()));
+  index->Update(added);
+  verify_same_as_db(index);
+
+  index->Remove(added);
+  ASSERT_TRUE(Activity::Delete(db(), *added.id()));
+  verify_same_as_db(index);
+  EXPECT_EQ(index->size(), 6u);
+
+  // Activities are clipped to the interval; one touching its start is
+  // skipped.
+  std::unordered_map<Task::Id, Activity::Duration> durations;
+  index->AddOverlappingDurations(
+      start + std::chrono::minutes(12),
+      start + std::chrono::minutes(51),
+      &durations);
+  EXPECT_EQ(durations, (std::unordered_map<Task::Id, Activity::Duration>{
+      {*foo.id(), std::chrono::minutes(7)},
+      {*bar.id(), std::chrono::minutes(1 + 1)}}));
+}
+
+TEST_F(DbEntitiesTest, ActivityColumnsMatchStats) {
+  m_time_tracker::HistoryGeneratorParams params;
+  params.tasks_per_level = {5, 20};
+  params.activity_count = 2003;
+  params.history_span = std::chrono::hours(24 * 60);
+  auto maybe_history = m_time_tracker::GenerateHistory(db(), params);
+  ASSERT_TRUE(maybe_history);
+  auto maybe_tasks = Task::LoadAll(db());
+  ASSERT_TRUE(maybe_tasks);
+  std::unordered_map<Task::Id, Task::Id> top_level_ids;
+  for (const Task& task : maybe_tasks.value()) {
+    top_level_ids[*task.id()] = task.parent_task_id().value_or(*task.id());
+  }
+  auto maybe_columns = ActivityColumns::Load(db());
+  ASSERT_TRUE(maybe_columns);
+  const ActivityColumns& columns = maybe_columns.value();
+  ASSERT_EQ(columns.size(), 2003u);
+
+  for (int start_offset_hours : {0, 7, 300}) {
+    for (int length_hours : {1, 25, 24 * 10, 24 * 90}) {
+      const Activity::TimePoint from = params.history_start +
+          std::chrono::hours(start_offset_hours) + std::chrono::seconds(13);
+      const Activity::TimePoint to = from + std::chrono::hours(length_hours);
+      std::unordered_map<Task::Id, Activity::Duration> task_durations;
+      columns.AddClippedDurations(
+          0,
+          columns.size(),
+          Activity::IntFromTimePoint(from),
+          Activity::IntFromTimePoint(to),
+          &task_durations);
+      std::unordered_map<Task::Id, Activity::Duration> top_level_durations;
+      for (const auto& [task_id, duration] : task_durations) {
+        top_level_durations[top_level_ids[task_id]] += duration;
+      }
+      VerifyActivityStats(
+          Activity::LoadStatsForTopLevelTasksInInterval(db(), from, to),
+          top_level_durations);
+    }
+  }
+
+  // Row ranges of odd length exercise the scalar tail of vector kernels.
+  const int64_t from = Activity::IntFromTimePoint(
+      params.history_start + std::chrono::hours(24 * 3));
+  const int64_t to = Activity::IntFromTimePoint(
+      params.history_start + std::chrono::hours(24 * 40));
+  for (size_t first_row : {0u, 1u, 3u}) {
+    for (size_t last_row : {first_row + 1, first_row + 6, columns.size()}) {
+      std::unordered_map<Task::Id, Activity::Duration> expected;
+      for (size_t i = first_row; i < last_row; ++i) {
+        const ActivityColumns::Row row = columns.row(i);
+        const int64_t duration =
+            std::min(row.end_time, to) - std::max(row.start_time, from);
+        if (duration > 0) {
+          expected[row.task_id] += Activity::Duration(duration);
+        }
+      }
+      std::unordered_map<Task::Id, Activity::Duration> actual;
+      columns.AddClippedDurations(first_row, last_row, from, to, &actual);
+      EXPECT_EQ(expected, actual);
+    }
+  }
+}
+
 TEST_F(DbEntitiesTest, LoadFiltered) {
   using std::chrono::minutes;
 
@@ -711,3 +1391,429 @@ TEST_F(DbEntitiesTest, LoadFiltered) {
     assert_results(result, {});
   }
 }
+
+TEST_F(DbEntitiesTest, StatementCacheReusesStatements) {
+  Task foo("foo");
+  ASSERT_TRUE(foo.Save(db()));
+  ASSERT_TRUE(Task::LoadById(db(), *foo.id()));
+  const int64_t misses = db()->statement_cache_stats().misses;
+  const int64_t hits = db()->statement_cache_stats().hits;
+  for (int i = 0; i < 3; ++i) {
+    const auto maybe_task = Task::LoadById(db(), *foo.id());
+    ASSERT_TRUE(maybe_task);
+    EXPECT_EQ(maybe_task.value().name(), "foo");
+  }
+  EXPECT_EQ(db()->statement_cache_stats().misses, misses);
+  EXPECT_EQ(db()->statement_cache_stats().hits, hits + 3);
+
+  // Same query may be run while its cached statement is still in use.
+  static constexpr std::string_view kQuery = "SELECT name FROM Tasks";
+  auto maybe_outer = db()->Select(kQuery);
+  ASSERT_TRUE(maybe_outer);
+  ASSERT_TRUE(maybe_outer.value().NextRow());
+  {
+    auto maybe_inner = db()->Select(kQuery);
+    ASSERT_TRUE(maybe_inner);
+    ASSERT_TRUE(maybe_inner.value().NextRow());
+    EXPECT_EQ(maybe_inner.value().StringColumn(0), "foo");
+  }
+  EXPECT_EQ(maybe_outer.value().StringColumn(0), "foo");
+  EXPECT_EQ(maybe_outer.value().NextRow(), SelectRows::kOutcomeDone);
+}
+
+TEST_F(DbEntitiesTest, TypedRowAccess) {
+  Task foo("foo");
+  ASSERT_TRUE(foo.Save(db()));
+  Task bar("bar");
+  bar.SetParentTask(foo);
+  ASSERT_TRUE(bar.Save(db()));
+
+  auto maybe_rows = db()->Select(
+      "SELECT id, name, parent_task_id FROM Tasks ORDER BY id");
+  ASSERT_TRUE(maybe_rows);
+  SelectRows& rows = maybe_rows.value();
+  using Row = std::tuple<
+      int64_t, std::string_view, std::optional<int64_t>>;
+  ASSERT_TRUE(rows.NextRow());
+  EXPECT_EQ(rows.StringViewColumn(1), "foo");
+  EXPECT_EQ(rows.Get<int64_t>(), std::make_tuple(*foo.id()));
+  EXPECT_EQ(
+      (rows.Get<int64_t, std::string_view, std::optional<int64_t>>()),
+      Row(*foo.id(), "foo", std::nullopt));
+  ASSERT_TRUE(rows.NextRow());
+  EXPECT_EQ(
+      (rows.Get<int64_t, std::string_view, std::optional<int64_t>>()),
+      Row(*bar.id(), "bar", foo.id()));
+  const auto [id, name] =
+      rows.Get<std::optional<int>, std::optional<std::string_view>>();
+  EXPECT_EQ(id, bar.id());
+  EXPECT_EQ(name, "bar");
+  EXPECT_EQ(rows.NextRow(), SelectRows::kOutcomeDone);
+}
+
+TEST_F(DbEntitiesTest, RowsIterationAndBatches) {
+  for (int i = 0; i < 5; ++i) {
+    Task task("task" + std::to_string(i));
+    ASSERT_TRUE(task.Save(db()));
+  }
+  static constexpr std::string_view kQuery =
+      "SELECT id, name FROM Tasks ORDER BY id";
+  {
+    auto maybe_rows = db()->Select(kQuery);
+    ASSERT_TRUE(maybe_rows);
+    SelectRows& rows = maybe_rows.value();
+    std::vector<std::string> names;
+    for (SelectRows& row : rows) {
+      names.emplace_back(std::get<1>(row.Get<int64_t, std::string_view>()));
+    }
+    ASSERT_TRUE(rows.status());
+    EXPECT_EQ(names.size(), 5u);
+    EXPECT_EQ(names.back(), "task4");
+    // Statement is not restarted after all rows are consumed.
+    EXPECT_EQ(rows.NextRow(), SelectRows::kOutcomeDone);
+    EXPECT_TRUE(rows.begin() == rows.end());
+  }
+  {
+    auto maybe_rows = db()->Select(kQuery);
+    ASSERT_TRUE(maybe_rows);
+    SelectRows& rows = maybe_rows.value();
+    std::vector<int64_t> ids;
+    std::vector<std::string> names;
+    auto maybe_fetched = rows.FetchBatch(3, &ids, &names);
+    ASSERT_TRUE(maybe_fetched);
+    EXPECT_EQ(maybe_fetched.value(), 3u);
+    maybe_fetched = rows.FetchBatch(3, &ids, &names);
+    ASSERT_TRUE(maybe_fetched);
+    EXPECT_EQ(maybe_fetched.value(), 2u);
+    maybe_fetched = rows.FetchBatch(3, &ids, &names);
+    ASSERT_TRUE(maybe_fetched);
+    EXPECT_EQ(maybe_fetched.value(), 0u);
+    ASSERT_EQ(ids.size(), 5u);
+    ASSERT_EQ(names.size(), 5u);
+    EXPECT_EQ(names[0], "task0");
+    EXPECT_LT(ids[0], ids[4]);
+  }
+}
+
+TEST_F(DbEntitiesTest, VariadicParamsBinding) {
+  Task foo("foo");
+  ASSERT_TRUE(foo.Save(db()));
+  Task bar("bar");
+  bar.SetParentTask(foo);
+  ASSERT_TRUE(bar.Save(db()));
+
+  static constexpr std::string_view kQuery =
+      "SELECT id FROM Tasks WHERE name = :name AND parent_task_id IS :parent";
+  const std::string name = "bar";
+  for (int i = 0; i < 2; ++i) {
+    // Second iteration uses parameter indices, cached with statement.
+    auto maybe_rows = db()->Select(
+        kQuery,
+        m_time_tracker::Bind(":name", name),
+        m_time_tracker::Bind(":parent", foo.id()));
+    ASSERT_TRUE(maybe_rows);
+    ASSERT_TRUE(maybe_rows.value().NextRow());
+    EXPECT_EQ(maybe_rows.value().Int64Column(0), bar.id());
+  }
+  {
+    // Same query with parameters in different order.
+    auto maybe_rows = db()->Select(
+        kQuery,
+        m_time_tracker::Bind(":parent", std::optional<Task::Id>()),
+        m_time_tracker::Bind(":name", std::string_view("foo")));
+    ASSERT_TRUE(maybe_rows);
+    ASSERT_TRUE(maybe_rows.value().NextRow());
+    EXPECT_EQ(maybe_rows.value().Int64Column(0), foo.id());
+  }
+  {
+    // Positional parameters.
+    auto maybe_rows = db()->Select(
+        "SELECT count(*) FROM Tasks WHERE id IN (?1, ?2)",
+        *foo.id(),
+        *bar.id());
+    ASSERT_TRUE(maybe_rows);
+    ASSERT_TRUE(maybe_rows.value().NextRow());
+    EXPECT_EQ(maybe_rows.value().Int64Column(0), 2);
+  }
+  {
+    const auto maybe_result = db()->Execute(
+        "DELETE FROM Tasks WHERE id = :id",
+        m_time_tracker::Bind(":unknown", *foo.id()));
+    ASSERT_FALSE(maybe_result);
+    EXPECT_EQ(
+        maybe_result.error(),
+        m_time_tracker::ErrorCodes::kUnknownDbParameterName);
+  }
+}
+
+TEST_F(DbEntitiesTest, Transactions) {
+  auto tasks_count = [this]() {
+    const auto maybe_tasks = Task::LoadAll(db());
+    VERIFY(maybe_tasks);
+    return maybe_tasks.value().size();
+  };
+  {
+    auto maybe_transaction = db()->BeginTransaction();
+    ASSERT_TRUE(maybe_transaction);
+    Task foo("foo");
+    ASSERT_TRUE(foo.Save(db()));
+    // Destroyed without commit.
+  }
+  EXPECT_EQ(tasks_count(), 0u);
+  {
+    auto maybe_transaction = db()->BeginTransaction();
+    ASSERT_TRUE(maybe_transaction);
+    Task foo("foo");
+    ASSERT_TRUE(foo.Save(db()));
+    {
+      auto maybe_nested = db()->BeginTransaction();
+      ASSERT_TRUE(maybe_nested);
+      Task bar("bar");
+      ASSERT_TRUE(bar.Save(db()));
+      EXPECT_EQ(tasks_count(), 2u);
+      // Nested transaction is rolled back.
+    }
+    EXPECT_EQ(tasks_count(), 1u);
+    {
+      auto maybe_nested = db()->BeginTransaction();
+      ASSERT_TRUE(maybe_nested);
+      Task baz("baz");
+      ASSERT_TRUE(baz.Save(db()));
+      ASSERT_TRUE(maybe_nested.value().Commit());
+    }
+    ASSERT_TRUE(maybe_transaction.value().Commit());
+  }
+  EXPECT_EQ(tasks_count(), 2u);
+}
+
+TEST(DatabaseTest, OptionsApplied) {
+  const std::filesystem::path db_path =
+      std::filesystem::temp_directory_path() / "time_keeper_options_test.db";
+  std::filesystem::remove(db_path);
+  {
+    auto maybe_db = Database::Open(db_path, Database::Options::Desktop());
+    ASSERT_TRUE(maybe_db);
+    const auto maybe_applied = maybe_db.value().LoadAppliedOptions();
+    ASSERT_TRUE(maybe_applied);
+    const Database::Options& applied = maybe_applied.value();
+    const Database::Options expected = Database::Options::Desktop();
+    EXPECT_EQ(applied.journal_mode, Database::Options::JournalMode::kWal);
+    EXPECT_EQ(applied.synchronous, expected.synchronous);
+    EXPECT_EQ(applied.cache_size_kib, expected.cache_size_kib);
+    EXPECT_EQ(applied.temp_store, expected.temp_store);
+    EXPECT_EQ(applied.busy_timeout, expected.busy_timeout);
+    EXPECT_EQ(applied.ToString(), expected.ToString());
+  }
+  {
+    // In-memory databases can not use WAL.
+    auto maybe_db = Database::Open(
+        ":memory:", Database::Options::LowMemoryPhone());
+    ASSERT_TRUE(maybe_db);
+    const auto maybe_applied = maybe_db.value().LoadAppliedOptions();
+    ASSERT_TRUE(maybe_applied);
+    EXPECT_EQ(
+        maybe_applied.value().journal_mode,
+        Database::Options::JournalMode::kMemory);
+    EXPECT_EQ(
+        maybe_applied.value().cache_size_kib,
+        Database::Options::LowMemoryPhone().cache_size_kib);
+  }
+  std::filesystem::remove(db_path);
+}
+
+TEST(DatabaseTest, SchemaMigrations) {
+  auto maybe_db = Database::Open(":memory:");
+  ASSERT_TRUE(maybe_db);
+  Database& db = maybe_db.value();
+  auto schema_version = [&db]() {
+    auto maybe_rows = db.Select("PRAGMA user_version");
+    VERIFY(maybe_rows);
+    VERIFY(maybe_rows.value().NextRow());
+    return maybe_rows.value().IntColumn(0);
+  };
+  auto index_count = [&db]() {
+    auto maybe_rows = db.Select(
+        "SELECT count(*) FROM sqlite_master "
+        " WHERE type = 'index' AND sql IS NOT NULL");
+    VERIFY(maybe_rows);
+    VERIFY(maybe_rows.value().NextRow());
+    return maybe_rows.value().IntColumn(0);
+  };
+  // Tables of databases, created before migrations were introduced.
+  ASSERT_TRUE(Task::EnsureTableCreated(&db));
+  ASSERT_TRUE(Activity::EnsureTableCreated(&db));
+  ASSERT_TRUE(db.Execute(
+      "INSERT INTO Activities(task_id, start_time, end_time) "
+      " VALUES(1, 1000, 1100)"));
+  ASSERT_TRUE(db.Execute(
+      "INSERT INTO Tasks(id, name, is_archived, parent_task_id) VALUES "
+      " (1, 'root', 0, NULL), (2, 'child', 0, 1), (3, 'grandchild', 0, 2)"));
+  EXPECT_EQ(schema_version(), 0);
+
+  ASSERT_TRUE(m_time_tracker::UpgradeSchema(&db));
+  EXPECT_EQ(schema_version(), m_time_tracker::LatestSchemaVersion());
+  // Existing activities are accounted in daily totals.
+  auto maybe_total = db.Select("SELECT SUM(seconds) FROM DailyTaskTotals");
+  ASSERT_TRUE(maybe_total);
+  ASSERT_TRUE(maybe_total.value().NextRow());
+  EXPECT_EQ(maybe_total.value().Int64Column(0), 100);
+  // Existing hierarchy is accounted in task closure: 3 self links, 2 links
+  // to parents and 1 to grandparent.
+  auto maybe_closure = db.Select(
+      "SELECT COUNT(*), SUM(depth) FROM TaskClosure");
+  ASSERT_TRUE(maybe_closure);
+  ASSERT_TRUE(maybe_closure.value().NextRow());
+  EXPECT_EQ(maybe_closure.value().Int64Column(0), 6);
+  EXPECT_EQ(maybe_closure.value().Int64Column(1), 4);
+  EXPECT_EQ(index_count(), 6);
+  // Second upgrade does nothing.
+  ASSERT_TRUE(m_time_tracker::UpgradeSchema(&db));
+  EXPECT_EQ(index_count(), 6);
+
+  ASSERT_TRUE(db.Execute("PRAGMA user_version = 1000"));
+  const auto upgrade_result = m_time_tracker::UpgradeSchema(&db);
+  ASSERT_FALSE(upgrade_result);
+  EXPECT_EQ(
+      upgrade_result.error(),
+      m_time_tracker::ErrorCodes::kUnsupportedSchemaVersion);
+}
+
+TEST(DatabasePoolTest, ReadersWorkInParallel) {
+  const std::filesystem::path db_path =
+      std::filesystem::temp_directory_path() / "time_keeper_pool_test.db";
+  std::filesystem::remove(db_path);
+  {
+    auto maybe_pool = DatabasePool::Open(
+        db_path, Database::Options::Desktop(), 2);
+    ASSERT_TRUE(maybe_pool);
+    DatabasePool& pool = *maybe_pool.value();
+    ASSERT_TRUE(m_time_tracker::UpgradeSchema(&pool.writer()));
+    Task foo("foo");
+    ASSERT_TRUE(foo.Save(&pool.writer()));
+
+    DatabasePool::Reader first = pool.AcquireReader();
+    std::optional<DatabasePool::Reader> second = pool.TryAcquireReader();
+    ASSERT_TRUE(second);
+    EXPECT_FALSE(pool.TryAcquireReader());
+    const auto maybe_applied = first->LoadAppliedOptions();
+    ASSERT_TRUE(maybe_applied);
+    EXPECT_TRUE(maybe_applied.value().read_only);
+    EXPECT_EQ(
+        maybe_applied.value().journal_mode,
+        Database::Options::JournalMode::kWal);
+    EXPECT_FALSE(Task("bar").Save(first.get()));
+
+    // Reader started in the middle of write transaction sees last
+    // committed state.
+    auto maybe_transaction = pool.writer().BeginTransaction();
+    ASSERT_TRUE(maybe_transaction);
+    ASSERT_TRUE(Task("bar").Save(&pool.writer()));
+    std::thread thread([&pool]() {
+      // Blocks until |second| is released.
+      DatabasePool::Reader reader = pool.AcquireReader();
+      const auto maybe_tasks = Task::LoadAll(reader.get());
+      VERIFY(maybe_tasks);
+      VERIFY(maybe_tasks.value().size() == 1);
+    });
+    second.reset();
+    thread.join();
+    ASSERT_TRUE(maybe_transaction.value().Commit());
+    const auto maybe_tasks = Task::LoadAll(first.get());
+    ASSERT_TRUE(maybe_tasks);
+    EXPECT_EQ(maybe_tasks.value().size(), 2u);
+  }
+  std::filesystem::remove(db_path);
+}
+
+TEST(DatabaseTest, QueryProfiling) {
+  using m_time_tracker::QueryProfiler;
+  Database::Options options;
+  options.profile_queries = true;
+  auto maybe_db = Database::Open(":memory:", options);
+  ASSERT_TRUE(maybe_db);
+  Database& db = maybe_db.value();
+  ASSERT_TRUE(m_time_tracker::UpgradeSchema(&db));
+  Task foo("foo");
+  ASSERT_TRUE(foo.Save(&db));
+  Task bar("bar");
+  ASSERT_TRUE(bar.Save(&db));
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(Task::LoadAll(&db));
+  }
+  const std::vector<QueryProfiler::Entry> stats = db.QueryStats();
+  const auto it = std::find_if(
+      stats.begin(),
+      stats.end(),
+      [](const QueryProfiler::Entry& entry) {
+        return entry.query.rfind("SELECT", 0) == 0 &&
+            entry.query.find("FROM Tasks") != std::string::npos &&
+            entry.query.find("WHERE") == std::string::npos;
+      });
+  ASSERT_TRUE(it != stats.end());
+  EXPECT_EQ(it->calls, 3);
+  EXPECT_EQ(it->rows, 6);
+  EXPECT_GT(it->vm_steps, 0);
+  EXPECT_GE(it->max_time.count(), 0);
+  EXPECT_GE(it->total_time, it->max_time);
+
+  const auto maybe_applied = db.LoadAppliedOptions();
+  ASSERT_TRUE(maybe_applied);
+  EXPECT_TRUE(maybe_applied.value().profile_queries);
+
+  EXPECT_EQ(
+      QueryProfiler::NormalizeQuery("  SELECT a,\n   b FROM  T "),
+      "SELECT a, b FROM T");
+  const std::vector<QueryProfiler::Entry> merged = QueryProfiler::Merge(
+      {*it, *it});
+  ASSERT_EQ(merged.size(), 1u);
+  EXPECT_EQ(merged[0].calls, 6);
+  EXPECT_EQ(merged[0].max_time, it->max_time);
+}
+
+TEST_F(DbEntitiesTest, StatsCacheInvalidatesOverlappingEntries) {
+  const Activity::TimePoint day = Activity::TimePointFromInt(1000000);
+  const auto make_key = [day](int first_day, int last_day) {
+    return StatsCache::Key{
+        day + std::chrono::hours(24 * first_day),
+        day + std::chrono::hours(24 * last_day),
+        std::nullopt};
+  };
+  const auto make_value = [](Task::Id task_id) {
+    StatsCache::Value value;
+    value.stats.emplace_back(task_id, std::chrono::seconds(1));
+    value.stat_groups[task_id] = task_id;
+    return value;
+  };
+  StatsCache cache(2);
+  cache.Insert(make_key(0, 1), make_value(1));
+  cache.Insert(make_key(1, 2), make_value(2));
+  const StatsCache::Value* value = cache.Find(make_key(0, 1));
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(value->stats[0].task_id, 1);
+  StatsCache::Key child_key = make_key(0, 1);
+  child_key.parent_task_id = 1;
+  EXPECT_EQ(cache.Find(child_key), nullptr);
+
+  // Least recently used entry is evicted.
+  cache.Insert(make_key(2, 3), make_value(3));
+  EXPECT_EQ(cache.size(), 2u);
+  EXPECT_EQ(cache.Find(make_key(1, 2)), nullptr);
+  EXPECT_NE(cache.Find(make_key(0, 1)), nullptr);
+
+  // Intervals are half-open, so activity, ending at day 1 start, does
+  // not affect the second day.
+  Task task("task");
+  ASSERT_TRUE(task.Save(db()));
+  Activity activity(task, day);
+  activity.SetInterval(
+      day + std::chrono::hours(23), day + std::chrono::hours(24));
+  cache.Insert(make_key(1, 2), make_value(2));
+  cache.InvalidateActivity(activity);
+  EXPECT_EQ(cache.Find(make_key(0, 1)), nullptr);
+  EXPECT_NE(cache.Find(make_key(1, 2)), nullptr);
+  // Not completed activities are not accounted in statistics.
+  cache.InvalidateActivity(Activity(task, day + std::chrono::hours(24)));
+  EXPECT_NE(cache.Find(make_key(1, 2)), nullptr);
+  cache.Clear();
+  EXPECT_EQ(cache.size(), 0u);
+}
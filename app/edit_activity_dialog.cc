@@ -83,13 +83,10 @@ void EditActivityDialog::FillTasksCombo() noexcept {
           return *t.id() == activity_->task_id();
         });
     if (it_activity_task == tasks.end()) {
-      auto maybe_cur_task = Task::LoadById(
-          &app_state_->db_for_read_only(),
+      const TaskRef cur_task = app_state_->tasks().FindById(
           activity_->task_id());
-      if (!maybe_cur_task) {
-        main_window_->OnFatalError(maybe_cur_task.assume_error());
-      }
-      tasks.push_back(std::move(maybe_cur_task.value()));
+      VERIFY(cur_task);
+      tasks.push_back(*cur_task);
     }
   }
   std::sort(
@@ -5,6 +5,7 @@
 #include "app/edit_task_dialog.h"
 
 #include <charconv>
+#include <set>
 #include <vector>
 #include <boost/algorithm/string/trim.hpp>
 
@@ -60,16 +61,11 @@ void EditTaskDialog::on_response(int response_id) {
 
 void EditTaskDialog::on_show() {
   Gtk::Dialog::on_show();
-  const std::vector<Task> child_tasks = LoadChildTasks();
-  InitializeParentTaskCombo(child_tasks);
+  InitializeParentTaskCombo();
   if (task_) {
     edt_task_name_->set_text(task_->name());
     chk_archived_->set_active(task_->is_archived());
-    const bool has_not_arcived_childern = (child_tasks.end() != std::find_if(
-        child_tasks.begin(),
-        child_tasks.end(),
-        [](const Task& t) { return !t.is_archived(); }));
-    if (has_not_arcived_childern) {
+    if (HasNotArchivedDescendants()) {
       chk_archived_->set_sensitive(false);
     } else {
       chk_archived_->set_sensitive(true);
@@ -79,50 +75,49 @@ void EditTaskDialog::on_show() {
   edt_task_name_->grab_focus();
 }
 
-std::vector<Task> EditTaskDialog::LoadChildTasks() noexcept {
-  if (task_ && task_->id()) {
-    auto maybe_child_tasks = Task::LoadChildTasks(
-        &app_state_->db_for_read_only(),
-        *task_);
-    if (!maybe_child_tasks) {
-      main_window_->OnFatalError(maybe_child_tasks.assume_error());
+bool EditTaskDialog::HasNotArchivedDescendants() noexcept {
+  if (!task_ || !task_->id()) {
+    return false;
+  }
+  const TaskRepository& all_tasks = app_state_->tasks();
+  // Archived child may still have not archived children, so the whole
+  // subtree is checked.
+  std::vector<Task::Id> ids_to_visit(
+      all_tasks.ChildIds(task_->id()).begin(),
+      all_tasks.ChildIds(task_->id()).end());
+  while (!ids_to_visit.empty()) {
+    const Task::Id id = ids_to_visit.back();
+    ids_to_visit.pop_back();
+    const TaskRef t = all_tasks.FindById(id);
+    VERIFY(t);
+    if (!t->is_archived()) {
+      return true;
     }
-    return maybe_child_tasks.value();
-  } else {
-    return std::vector<Task>();
+    const std::set<Task::Id>& child_ids = all_tasks.ChildIds(id);
+    ids_to_visit.insert(ids_to_visit.end(), child_ids.begin(), child_ids.end());
   }
+  return false;
 }
 
-void EditTaskDialog::InitializeParentTaskCombo(
-    const std::vector<Task>& child_tasks) noexcept {
+void EditTaskDialog::InitializeParentTaskCombo() noexcept {
   cmb_parent_task_->remove_all();
   cmb_parent_task_->append(kNoneTaskId, _L("<NO TASK>"));
-  if (!child_tasks.empty()) {
-    // At present we support only one level in tasks hierarchy. Primly
-    // due to difficulties in select task UI.
-    const bool task_found = cmb_parent_task_->set_active_id(kNoneTaskId);
-    VERIFY(task_found);
-    cmb_parent_task_->set_sensitive(false);
-    return;
-  }
-  cmb_parent_task_->set_sensitive(true);
-  auto maybe_tasks = Task::LoadTopLevel(&app_state_->db_for_read_only());
-  if (!maybe_tasks) {
-    main_window_->OnFatalError(maybe_tasks.assume_error());
-  }
+  const TaskRepository& all_tasks = app_state_->tasks();
+  std::vector<TaskRef> tasks = all_tasks.All();
   std::sort(
-      maybe_tasks.value().begin(),
-      maybe_tasks.value().end(),
-      [](const Task& first, const Task& second) {
-        return first.name() < second.name();
+      tasks.begin(),
+      tasks.end(),
+      [](const TaskRef& first, const TaskRef& second) {
+        return first->name() < second->name();
       });
-  for (const Task& t : maybe_tasks.value()) {
-    VERIFY(t.id());
-    if (task_ && t.id() == task_->id()) {
+  for (const TaskRef& t : tasks) {
+    VERIFY(t->id());
+    if (task_ && task_->id() && all_tasks.IsInSubtree(*t->id(), *task_->id())) {
+      // Task can not become a descendant of itself.
       continue;
     }
-    const std::string id = std::to_string(*t.id());
-    cmb_parent_task_->append(id, t.name());
+    const std::string id = std::to_string(*t->id());
+    cmb_parent_task_->append(id, t->name());
   }
   if (task_) {
     const std::optional<Task::Id> parent_task_id = task_->parent_task_id();
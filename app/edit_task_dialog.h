@@ -35,9 +35,9 @@ class EditTaskDialog : public Gtk::Dialog {
  private:
   void OnTaskNameChange() noexcept;
   std::string GetTrimmedEditText() noexcept;
-  std::vector<Task> LoadChildTasks() noexcept;
-  void InitializeParentTaskCombo(
-      const std::vector<Task>& child_tasks) noexcept;
+  // True if any task in subtree of |task_| is not archived.
+  bool HasNotArchivedDescendants() noexcept;
+  void InitializeParentTaskCombo() noexcept;
 
   Gtk::Entry* edt_task_name_ = nullptr;
   Gtk::Button* btn_ok_ = nullptr;
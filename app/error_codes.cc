@@ -20,6 +20,10 @@ std::string CustomErrorCategory::message(int c) const {
       return "Unknown DB parameter name";
     case ErrorCodes::kEmptyResults:
       return "Result set is empty";
+    case ErrorCodes::kUnsupportedSchemaVersion:
+      return "Database was created by newer application version";
+    case ErrorCodes::kTaskHierarchyCycle:
+      return "Task can not be moved inside its own subtree";
     default:
       NOTREACHED();
   }
@@ -17,6 +17,8 @@ enum class ErrorCodes {
   kOk = 0,
   kUnknownDbParameterName,
   kEmptyResults,
+  kUnsupportedSchemaVersion,
+  kTaskHierarchyCycle,
 };
 
 static_assert(SQLITE_OK == 0, "Ok code should be 0 for std::result");
@@ -75,6 +75,8 @@ void ExportView::OnBtnExportClicked() noexcept {
   VERIFY(!export_file_path_.empty());
   CSVExporter exporter(
       &app_state_->db_for_read_only(),
+      &app_state_->tasks(),
+      app_state_->activity_index(),
       from_time(),
       to_time(),
       export_file_path_);
@@ -0,0 +1,210 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/history_generator.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+// Activities are saved with few big transactions, without keeping all of
+// them in memory.
+constexpr int64_t kActivityBatchSize = 100000;
+// How many times try to pick random task, that is not archived yet,
+// before falling back to the list of not archived tasks.
+constexpr int kMaxPickAttempts = 8;
+
+// SplitMix64 generator. Unlike <random> distributions, that are
+// implementation-defined, it gives the same sequence with any standard
+// library, so generated databases are reproducible everywhere.
+class Random {
+ public:
+  explicit Random(uint64_t seed) noexcept
+      : state_(seed) {}
+
+  uint64_t Next() noexcept {
+    state_ += 0x9e3779b97f4a7c15ULL;
+    uint64_t result = state_;
+    result = (result ^ (result >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    result = (result ^ (result >> 27)) * 0x94d049bb133111ebULL;
+    return result ^ (result >> 31);
+  }
+
+  // Returns value in range [0, bound). Modulo bias is negligible for
+  // bounds used here.
+  uint64_t Uniform(uint64_t bound) noexcept {
+    VERIFY(bound > 0);
+    return Next() % bound;
+  }
+
+  // Returns value in range [0, 1).
+  double UniformReal() noexcept {
+    return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+  }
+
+  bool Chance(double probability) noexcept {
+    return UniformReal() < probability;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+struct LeafTask {
+  const Task* task;
+  // Task gets no new activities after that time.
+  Activity::TimePoint archived_at;
+};
+
+outcome::std_result<std::vector<std::vector<Task>>> GenerateTasks(
+    Database* db,
+    const HistoryGeneratorParams& params,
+    Random* random) noexcept {
+  std::vector<std::vector<Task>> tasks_by_level;
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  for (size_t level = 0; level < params.tasks_per_level.size(); ++level) {
+    const int task_count = params.tasks_per_level[level];
+    std::vector<Task> level_tasks;
+    level_tasks.reserve(static_cast<size_t>(task_count));
+    for (int i = 0; i < task_count; ++i) {
+      Task task(
+          "Task " + std::to_string(level + 1) + "." + std::to_string(i + 1));
+      bool is_archived = random->Chance(params.archived_fraction);
+      if (level > 0) {
+        const std::vector<Task>& parents = tasks_by_level[level - 1];
+        const Task& parent = parents[random->Uniform(parents.size())];
+        task.SetParentTask(parent);
+        is_archived = is_archived || parent.is_archived();
+      }
+      task.set_archived(is_archived);
+      auto save_result = task.Save(db);
+      if (!save_result) {
+        return save_result.error();
+      }
+      level_tasks.push_back(std::move(task));
+    }
+    tasks_by_level.push_back(std::move(level_tasks));
+  }
+  auto commit_result = maybe_transaction.value().Commit();
+  if (!commit_result) {
+    return commit_result.error();
+  }
+  return tasks_by_level;
+}
+
+std::vector<LeafTask> CollectLeafTasks(
+    const std::vector<std::vector<Task>>& tasks_by_level,
+    const HistoryGeneratorParams& params,
+    Random* random) noexcept {
+  std::vector<LeafTask> result;
+  const Activity::TimePoint history_end =
+      params.history_start + params.history_span;
+  std::unordered_set<Task::Id> parent_ids;
+  for (const std::vector<Task>& level_tasks : tasks_by_level) {
+    for (const Task& task : level_tasks) {
+      if (task.parent_task_id()) {
+        parent_ids.insert(*task.parent_task_id());
+      }
+    }
+  }
+  for (const std::vector<Task>& level_tasks : tasks_by_level) {
+    for (const Task& task : level_tasks) {
+      if (parent_ids.count(*task.id()) > 0) {
+        continue;
+      }
+      Activity::TimePoint archived_at = history_end;
+      if (task.is_archived()) {
+        archived_at = params.history_start +
+            std::chrono::duration_cast<Activity::Duration>(
+                params.history_span * random->UniformReal());
+      }
+      result.push_back(LeafTask{&task, archived_at});
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+outcome::std_result<GeneratedHistory> GenerateHistory(
+    Database* db, const HistoryGeneratorParams& params) noexcept {
+  VERIFY(params.activity_count >= 0);
+  VERIFY(params.history_span.count() > 0);
+  Random random(params.seed);
+  GeneratedHistory result;
+  result.history_end = params.history_start;
+  auto maybe_tasks = GenerateTasks(db, params, &random);
+  if (!maybe_tasks) {
+    return maybe_tasks.error();
+  }
+  result.tasks_by_level = std::move(maybe_tasks.value());
+  if (params.activity_count == 0) {
+    return result;
+  }
+
+  const std::vector<LeafTask> leaf_tasks = CollectLeafTasks(
+      result.tasks_by_level, params, &random);
+  VERIFY(!leaf_tasks.empty());
+  std::vector<const LeafTask*> active_leaf_tasks;
+  for (const LeafTask& leaf_task : leaf_tasks) {
+    if (!leaf_task.task->is_archived()) {
+      active_leaf_tasks.push_back(&leaf_task);
+    }
+  }
+  const auto pick_task = [&](Activity::TimePoint start) -> const Task& {
+    const LeafTask* leaf_task = nullptr;
+    for (int i = 0; i < kMaxPickAttempts; ++i) {
+      leaf_task = &leaf_tasks[random.Uniform(leaf_tasks.size())];
+      if (start < leaf_task->archived_at) {
+        return *leaf_task->task;
+      }
+    }
+    if (!active_leaf_tasks.empty()) {
+      leaf_task = active_leaf_tasks[
+          random.Uniform(active_leaf_tasks.size())];
+    }
+    return *leaf_task->task;
+  };
+
+  // Average duration plus gap is equal to |slot|, so activities cover
+  // requested history span.
+  const uint64_t slot = static_cast<uint64_t>(std::max<int64_t>(
+      1, params.history_span.count() / params.activity_count));
+  std::vector<Activity> batch;
+  batch.reserve(static_cast<size_t>(
+      std::min(kActivityBatchSize, params.activity_count)));
+  Activity::TimePoint current = params.history_start;
+  for (int64_t i = 0; i < params.activity_count; ++i) {
+    const Activity::Duration duration(
+        static_cast<int64_t>(1 + slot / 4 + random.Uniform(slot)));
+    Activity activity(pick_task(current), current);
+    activity.SetInterval(current, current + duration);
+    batch.push_back(std::move(activity));
+    current += duration;
+    result.history_end = current;
+    current += Activity::Duration(
+        static_cast<int64_t>(random.Uniform(slot / 2 + 1)));
+    if (static_cast<int64_t>(batch.size()) == kActivityBatchSize ||
+        i + 1 == params.activity_count) {
+      auto save_result = Activity::SaveBatch(db, &batch);
+      if (!save_result) {
+        return save_result.error();
+      }
+      batch.clear();
+    }
+  }
+  return result;
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,50 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "app/activity.h"
+#include "app/database.h"
+#include "app/error_codes.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+// Parameters of synthetic history, that imitates years of real use.
+struct HistoryGeneratorParams {
+  // Same seed and parameters always produce the same database.
+  uint64_t seed = 1;
+  // Number of tasks on each hierarchy level, starting from top-level ones.
+  // Parent of each task is randomly chosen from the previous level.
+  std::vector<int> tasks_per_level = {40, 260};
+  // Fraction of tasks, that are archived. Children of archived tasks are
+  // archived too, so actual fraction is bigger for deep hierarchies.
+  double archived_fraction = 0.3;
+  int64_t activity_count = 100000;
+  Activity::TimePoint history_start = Activity::TimePointFromInt(
+      1420070400);  // 2015-01-01 00:00:00 UTC
+  Activity::Duration history_span = std::chrono::hours(24 * 365 * 5);
+};
+
+struct GeneratedHistory {
+  // Saved tasks, grouped like |HistoryGeneratorParams::tasks_per_level|.
+  std::vector<std::vector<Task>> tasks_by_level;
+  // End time of the latest activity.
+  Activity::TimePoint history_end;
+};
+
+// Fills |db| with tasks and completed activities. Activities are assigned
+// only to tasks without children; archived tasks get activities only
+// before their randomly chosen "archivation" time. Activities follow each
+// other with random durations and gaps, so all of them are
+// non-overlapping, and some of them cross midnight.
+// DB schema must be already created.
+outcome::std_result<GeneratedHistory> GenerateHistory(
+    Database* db, const HistoryGeneratorParams& params) noexcept;
+
+}  // namespace m_time_tracker
@@ -0,0 +1,146 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "app/activity.h"
+#include "app/database.h"
+#include "app/history_generator.h"
+#include "app/schema_migrations.h"
+#include "app/task.h"
+#include "app/verify.h"
+
+using m_time_tracker::Activity;
+using m_time_tracker::Database;
+using m_time_tracker::GeneratedHistory;
+using m_time_tracker::HistoryGeneratorParams;
+using m_time_tracker::Task;
+
+class HistoryGeneratorTest : public ::testing::Test {
+ protected:
+  static Database CreateDb() noexcept {
+    auto maybe_db = Database::Open(":memory:");
+    VERIFY(maybe_db);
+    VERIFY(m_time_tracker::UpgradeSchema(&maybe_db.value()));
+    return std::move(maybe_db.value());
+  }
+
+  static HistoryGeneratorParams SmallHistoryParams() noexcept {
+    HistoryGeneratorParams params;
+    params.seed = 42;
+    params.tasks_per_level = {5, 20, 30};
+    params.archived_fraction = 0.3;
+    params.activity_count = 5000;
+    params.history_span = std::chrono::hours(24 * 365);
+    return params;
+  }
+
+  static std::vector<Activity> LoadActivities(
+      Database* db, const HistoryGeneratorParams& params) noexcept {
+    auto maybe_activities = Activity::LoadAfter(db, params.history_start);
+    VERIFY(maybe_activities);
+    std::vector<Activity> result = std::move(maybe_activities.value());
+    std::sort(result.begin(), result.end(),
+        [](const Activity& first, const Activity& second) {
+          return first.start_time() < second.start_time();
+        });
+    return result;
+  }
+};
+
+TEST_F(HistoryGeneratorTest, SameSeedGivesSameHistory) {
+  const HistoryGeneratorParams params = SmallHistoryParams();
+  Database first_db = CreateDb();
+  Database second_db = CreateDb();
+  ASSERT_TRUE(m_time_tracker::GenerateHistory(&first_db, params));
+  ASSERT_TRUE(m_time_tracker::GenerateHistory(&second_db, params));
+
+  const std::vector<Activity> first_activities = LoadActivities(
+      &first_db, params);
+  const std::vector<Activity> second_activities = LoadActivities(
+      &second_db, params);
+  ASSERT_EQ(
+      params.activity_count,
+      static_cast<int64_t>(first_activities.size()));
+  ASSERT_EQ(first_activities.size(), second_activities.size());
+  for (size_t i = 0; i < first_activities.size(); ++i) {
+    const Activity& first = first_activities[i];
+    const Activity& second = second_activities[i];
+    EXPECT_EQ(first.task_id(), second.task_id());
+    EXPECT_EQ(first.start_time(), second.start_time());
+    EXPECT_EQ(first.end_time(), second.end_time());
+  }
+
+  HistoryGeneratorParams other_params = params;
+  other_params.seed = 43;
+  Database other_db = CreateDb();
+  ASSERT_TRUE(m_time_tracker::GenerateHistory(&other_db, other_params));
+  const std::vector<Activity> other_activities = LoadActivities(
+      &other_db, other_params);
+  EXPECT_NE(first_activities.back().end_time(),
+            other_activities.back().end_time());
+}
+
+TEST_F(HistoryGeneratorTest, HistoryIsConsistent) {
+  const HistoryGeneratorParams params = SmallHistoryParams();
+  Database db = CreateDb();
+  const auto maybe_history = m_time_tracker::GenerateHistory(&db, params);
+  ASSERT_TRUE(maybe_history);
+  const GeneratedHistory& history = maybe_history.value();
+  ASSERT_EQ(params.tasks_per_level.size(), history.tasks_by_level.size());
+
+  std::unordered_map<Task::Id, const Task*> tasks;
+  std::unordered_set<Task::Id> parent_ids;
+  int archived_count = 0;
+  for (size_t level = 0; level < history.tasks_by_level.size(); ++level) {
+    const auto& level_tasks = history.tasks_by_level[level];
+    ASSERT_EQ(params.tasks_per_level[level],
+              static_cast<int>(level_tasks.size()));
+    for (const Task& task : level_tasks) {
+      ASSERT_TRUE(task.id());
+      tasks.emplace(*task.id(), &task);
+      EXPECT_EQ(level == 0, !task.parent_task_id());
+      if (task.parent_task_id()) {
+        parent_ids.insert(*task.parent_task_id());
+        // Children of archived tasks must be archived too.
+        const Task* parent = tasks.at(*task.parent_task_id());
+        EXPECT_TRUE(!parent->is_archived() || task.is_archived());
+      }
+      if (task.is_archived()) {
+        ++archived_count;
+      }
+    }
+  }
+  EXPECT_GT(archived_count, 0);
+
+  const std::vector<Activity> activities = LoadActivities(&db, params);
+  constexpr int64_t kSecondsPerDay = 24 * 60 * 60;
+  int crossing_midnight_count = 0;
+  std::optional<Activity::TimePoint> previous_end;
+  for (const Activity& activity : activities) {
+    ASSERT_TRUE(activity.end_time());
+    EXPECT_LT(activity.start_time(), *activity.end_time());
+    EXPECT_EQ(0, parent_ids.count(activity.task_id()));
+    EXPECT_EQ(1, tasks.count(activity.task_id()));
+    if (previous_end) {
+      EXPECT_LE(*previous_end, activity.start_time());
+    }
+    previous_end = activity.end_time();
+    if (Activity::IntFromTimePoint(activity.start_time()) / kSecondsPerDay !=
+        Activity::IntFromTimePoint(*activity.end_time()) / kSecondsPerDay) {
+      ++crossing_midnight_count;
+    }
+  }
+  EXPECT_EQ(history.history_end, previous_end);
+  EXPECT_GT(crossing_midnight_count, 0);
+  EXPECT_LE(history.history_end, params.history_start + params.history_span +
+      std::chrono::hours(24 * 30));
+}
@@ -5,10 +5,12 @@
 #pragma once
 
 #include <sigc++/sigc++.h>
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "app/order_statistic_tree.h"
 #include "app/ui_helpers.h"
 
 namespace m_time_tracker {
@@ -44,7 +46,8 @@ class ListModelBase: public Gio::ListStore<Gtk::Widget> {
 
  protected:
   explicit ListModelBase(AppState* app_state) noexcept
-      : app_state_(app_state) {
+      : app_state_(app_state),
+        displayed_objects_(ObjectOrder(this)) {
     VERIFY(app_state_);
   }
 
@@ -71,12 +74,11 @@ class ListModelBase: public Gio::ListStore<Gtk::Widget> {
   Glib::RefPtr<Gtk::Widget> DoCreateRowFromObject(
       const ObjectType& o) noexcept;
 
-  void InsertUpdatindIndeces(
-      guint position, const Glib::RefPtr<Gtk::Widget>& control) noexcept;
-  // Item in |object_id_to_item_info_|, describing modified element,
-  // is not touched. All items with greater positions are updated.
-  void RemoveUpdatingIndices(guint position) noexcept;
-  guint ComputePositionForItem(const ObjectType& t) const noexcept;
+  // Adds copy of |t| to displayed objects and |control| at its position.
+  void InsertObject(
+      const ObjectType& t, const Glib::RefPtr<Gtk::Widget>& control) noexcept;
+  // Removes object with id of |t| and its control, if it is displayed.
+  void RemoveObject(const ObjectType& t) noexcept;
 
   Gtk::Widget* CreateWidget(const Glib::RefPtr<Glib::Object> obj) noexcept {
     // Caller responsible on releasing reference.
@@ -86,16 +88,34 @@ class ListModelBase: public Gio::ListStore<Gtk::Widget> {
 
   static const Glib::Quark object_id_quark_;
 
-  struct ItemInfo {
-    ItemInfo(guint idx, const ObjectType& obj) noexcept
-        : item_index(idx),
-          object(obj) {}
+  // Order of |FirstObjectShouldPrecedeSecond|, with ties broken by id, so
+  // each object has single position.
+  class ObjectOrder {
+   public:
+    explicit ObjectOrder(const ListModelBase* model) noexcept
+        : model_(model) {}
+
+    bool operator()(
+        const ObjectType* first, const ObjectType* second) const noexcept {
+      if (model_->FirstObjectShouldPrecedeSecond(*first, *second)) {
+        return true;
+      }
+      if (model_->FirstObjectShouldPrecedeSecond(*second, *first)) {
+        return false;
+      }
+      return *first->id() < *second->id();
+    }
 
-    guint item_index;
-    ObjectType object;
+   private:
+    const ListModelBase* model_;
   };
 
-  std::unordered_map<typename ObjectType::Id, ItemInfo> object_id_to_item_info_;
+  // Displayed objects; values are not moved in memory, while they are in
+  // the map, so |displayed_objects_| may point to them.
+  std::unordered_map<typename ObjectType::Id, ObjectType> objects_by_id_;
+  // Positions of displayed objects in the list model, so control positions
+  // are found and shifted in O(log n) on each change.
+  OrderStatisticTree<const ObjectType*, ObjectOrder> displayed_objects_;
 };
 
 template<typename ObjectType>
@@ -123,22 +143,27 @@ Glib::RefPtr<Gtk::Widget> ListModelBase<ObjectType>::DoCreateRowFromObject(
 template<typename ObjectType>
 void ListModelBase<ObjectType>::SetContent(
     std::vector<ObjectType> objects) noexcept {
-  object_id_to_item_info_.clear();
-  std::vector<Glib::RefPtr<Gtk::Widget>> items;
-  items.reserve(objects.size());
-  std::sort(
-      objects.begin(),
-      objects.end(),
-      [this](const ObjectType& first, const ObjectType& second) {
-        return FirstObjectShouldPrecedeSecond(first, second);
-      });
-  for (const ObjectType& t : objects) {
+  displayed_objects_.Clear();
+  objects_by_id_.clear();
+  std::vector<const ObjectType*> sorted_objects;
+  sorted_objects.reserve(objects.size());
+  for (ObjectType& t : objects) {
     VERIFY(t.id());
-    auto control = DoCreateRowFromObject(t);
+    const auto [it, inserted] = objects_by_id_.emplace(*t.id(), std::move(t));
+    VERIFY(inserted);
+    sorted_objects.push_back(&it->second);
+  }
+  std::sort(
+      sorted_objects.begin(),
+      sorted_objects.end(),
+      ObjectOrder(this));
+  std::vector<Glib::RefPtr<Gtk::Widget>> items;
+  items.reserve(sorted_objects.size());
+  for (const ObjectType* t : sorted_objects) {
+    auto control = DoCreateRowFromObject(*t);
     VERIFY(control);
     items.push_back(std::move(control));
-    VERIFY(object_id_to_item_info_.insert(
-        {*t.id(), ItemInfo(static_cast<guint>(items.size() - 1), t)}).second);
+    VERIFY(displayed_objects_.Insert(t) == items.size() - 1);
   }
   const guint old_size = get_n_items();
   splice(0U, /* n_removals */ old_size, items);
@@ -148,31 +173,11 @@ template<typename ObjectType>
 void ListModelBase<ObjectType>::ExistingObjectChanged(
     const ObjectType& t) noexcept {
   VERIFY(t.id());
-  auto it = object_id_to_item_info_.find(*t.id());
-  if (it != object_id_to_item_info_.end()) {
-    RemoveUpdatingIndices(it->second.item_index);
-    object_id_to_item_info_.erase(it);
-  }
-  const guint item_position = ComputePositionForItem(t);
-
+  RemoveObject(t);
   auto new_control = DoCreateRowFromObject(t);
   if (new_control) {
-    InsertUpdatindIndeces(item_position, new_control);
-    object_id_to_item_info_.insert_or_assign(
-        *t.id(), ItemInfo(item_position, t));
-  }
-}
-
-template<typename ObjectType>
-guint ListModelBase<ObjectType>::ComputePositionForItem(
-    const ObjectType& t) const noexcept {
-  guint item_position = 0;
-  for (const auto& [id, info] : object_id_to_item_info_) {
-    if (FirstObjectShouldPrecedeSecond(info.object, t)) {
-      ++item_position;
-    }
+    InsertObject(t, new_control);
   }
-  return item_position;
 }
 
 template<typename ObjectType>
@@ -183,44 +188,36 @@ void ListModelBase<ObjectType>::AfterObjectAdded(
   if (!new_control) {
     return;
   }
-  const guint new_item_index = ComputePositionForItem(t);
-  InsertUpdatindIndeces(new_item_index, new_control);
-  const auto insert_result = object_id_to_item_info_.insert(
-      {*t.id(),
-       ItemInfo(new_item_index, t)});
-  VERIFY(insert_result.second);
+  VERIFY(objects_by_id_.count(*t.id()) == 0);
+  InsertObject(t, new_control);
 }
 
 template<typename ObjectType>
 void ListModelBase<ObjectType>::BeforeObjectDeleted(
     const ObjectType& t) noexcept {
   VERIFY(t.id());
-  auto it = object_id_to_item_info_.find(*t.id());
-  if (it != object_id_to_item_info_.end()) {
-    RemoveUpdatingIndices(it->second.item_index);
-    object_id_to_item_info_.erase(it);
-  }
+  RemoveObject(t);
 }
 
 template<typename ObjectType>
-void ListModelBase<ObjectType>::InsertUpdatindIndeces(
-    guint position, const Glib::RefPtr<Gtk::Widget>& control) noexcept {
-  insert(position, control);
-  for (auto& [object_id, object_info] : object_id_to_item_info_) {
-    if (object_info.item_index >= position) {
-      ++object_info.item_index;
-    }
-  }
+void ListModelBase<ObjectType>::InsertObject(
+    const ObjectType& t, const Glib::RefPtr<Gtk::Widget>& control) noexcept {
+  const auto [it, inserted] = objects_by_id_.emplace(*t.id(), t);
+  VERIFY(inserted);
+  const size_t position = displayed_objects_.Insert(&it->second);
+  insert(static_cast<guint>(position), control);
 }
 
 template<typename ObjectType>
-void ListModelBase<ObjectType>::RemoveUpdatingIndices(guint position) noexcept {
-  remove(position);
-  for (auto& [object_id, object_info] : object_id_to_item_info_) {
-    if (object_info.item_index > position) {
-      --object_info.item_index;
-    }
+void ListModelBase<ObjectType>::RemoveObject(const ObjectType& t) noexcept {
+  const auto it = objects_by_id_.find(*t.id());
+  if (it == objects_by_id_.end()) {
+    return;
   }
+  // Old version of the object defines its current position.
+  const size_t position = displayed_objects_.Erase(&it->second);
+  remove(static_cast<guint>(position));
+  objects_by_id_.erase(it);
 }
 
 template<typename ObjectType>
@@ -5,6 +5,8 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 
 #include "app/ui_helpers.h"
@@ -44,6 +46,46 @@ std::filesystem::path GetDbPathOrExit() noexcept {
   return app_folder / kDbFileName;
 }
 
+// Preset may be overridden with TIME_KEEPER_DB_PROFILE environment variable,
+// set to "desktop" or "phone". Applied settings are reported in that case.
+m_time_tracker::Database::Options GetDbOptions(bool* report) noexcept {
+  using Options = m_time_tracker::Database::Options;
+  const char* profile = std::getenv("TIME_KEEPER_DB_PROFILE");
+  *report = (profile != nullptr);
+  if (profile) {
+    const std::string_view profile_name(profile);
+    if (profile_name == "phone") {
+      return Options::LowMemoryPhone();
+    }
+    if (profile_name == "desktop") {
+      return Options::Desktop();
+    }
+    std::cerr << "Unknown TIME_KEEPER_DB_PROFILE value " << profile_name
+              << ", using default" << std::endl;
+  }
+#if defined(__aarch64__) || defined(__arm__)
+  // Assume ARM builds are targeted to phones.
+  return Options::LowMemoryPhone();
+#else
+  return Options::Desktop();
+#endif
+}
+
+// Query profiling is enabled with TIME_KEEPER_QUERY_STATS environment
+// variable; collected statistics are dumped on exit in that case.
+// TIME_KEEPER_SLOW_QUERY_MS additionally enables logging of plans of
+// queries, running longer than specified number of milliseconds.
+void ApplyProfilingOptions(
+    m_time_tracker::Database::Options* options, bool* dump_stats) noexcept {
+  *dump_stats = (std::getenv("TIME_KEEPER_QUERY_STATS") != nullptr);
+  const char* slow_query_ms = std::getenv("TIME_KEEPER_SLOW_QUERY_MS");
+  if (slow_query_ms) {
+    options->slow_query_threshold = std::chrono::milliseconds(
+        std::strtoll(slow_query_ms, nullptr, 10));
+  }
+  options->profile_queries = *dump_stats || slow_query_ms != nullptr;
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -60,7 +102,16 @@ int main(int argc, char* argv[]) {
 
   const std::filesystem::path db_path = GetDbPathOrExit();
 
-  auto maybe_app_state = m_time_tracker::AppState::Open(db_path.native());
+  bool report_db_options = false;
+  m_time_tracker::Database::Options db_options =
+      GetDbOptions(&report_db_options);
+  bool dump_query_stats = false;
+  ApplyProfilingOptions(&db_options, &dump_query_stats);
+  // In-memory activity index may be disabled to compare with plain SQL.
+  const bool use_activity_index =
+      (std::getenv("TIME_KEEPER_NO_ACTIVITY_INDEX") == nullptr);
+  auto maybe_app_state = m_time_tracker::AppState::Open(
+      db_path.native(), db_options, use_activity_index);
   if (!maybe_app_state) {
     std::cerr << "Failed open database file " << db_path
               << " Error " << maybe_app_state.error().message()
@@ -69,11 +120,29 @@ int main(int argc, char* argv[]) {
   }
 
   m_time_tracker::AppState app_state(std::move(maybe_app_state.value()));
+  if (report_db_options) {
+    const auto maybe_applied =
+        app_state.db_for_read_only().LoadAppliedOptions();
+    if (maybe_applied) {
+      std::clog << "Database settings: "
+                << maybe_applied.value().ToString() << std::endl;
+    } else {
+      std::cerr << "Failed read database settings: "
+                << maybe_applied.error().message() << std::endl;
+    }
+  }
 
   Glib::RefPtr<m_time_tracker::MainWindow> wnd =
       m_time_tracker::GetWindowDerived<m_time_tracker::MainWindow>(
           builder, "main_window",
           &app_state);
 
-  return app->run(*wnd.get(), argc, argv);
+  const int result = app->run(*wnd.get(), argc, argv);
+  if (dump_query_stats) {
+    std::clog << "Query statistics:\n"
+              << m_time_tracker::QueryProfiler::Format(
+                  app_state.db_pool().QueryStats())
+              << std::flush;
+  }
+  return result;
 }
@@ -46,14 +46,14 @@ class EditTaskListModel : public TaskListModelBase {
 
  private:
   void EditTask(Task::Id task_id) {
-    auto maybe_task = Task::LoadById(
-        &app_state_->db_for_read_only(), task_id);
-    VERIFY(maybe_task);
-    main_window_->EditTask(&maybe_task.value());
+    const TaskRef task = app_state_->tasks().FindById(task_id);
+    VERIFY(task);
+    // Shared snapshot is immutable, so edit a copy.
+    Task edited_task = *task;
+    main_window_->EditTask(&edited_task);
   }
 
-  void OnRunningTaskChanged(
-      const std::optional<Task>& new_running_task) noexcept;
+  void OnRunningTaskChanged(const TaskRef& new_running_task) noexcept;
 
   AppState* const app_state_;
   MainWindow* const main_window_;
@@ -94,7 +94,7 @@ void EditTaskListModel::CustomizeRow(
 
   task_id_to_btn_edit_[*t.id()] = btn_edit;
 
-  const auto maybe_running_task = app_state_->running_task();
+  const TaskRef& maybe_running_task = app_state_->running_task();
   if (maybe_running_task &&
       maybe_running_task->id() == t.id()) {
     btn_edit->set_sensitive(false);
@@ -114,7 +114,7 @@ void EditTaskListModel::ReCustomizeRow(
 }
 
 void EditTaskListModel::OnRunningTaskChanged(
-    const std::optional<Task>& new_running_task) noexcept {
+    const TaskRef& new_running_task) noexcept {
   for (const auto& [task_id, btn_edit] : task_id_to_btn_edit_) {
     if (new_running_task && new_running_task->id() == task_id) {
       btn_edit->set_sensitive(false);
@@ -133,7 +133,8 @@ MainWindow::MainWindow(
     : Gtk::Window(wnd),
       resource_builder_(builder),
       app_state_(app_state),
-      statistics_view_(this, builder, app_state),
+      async_db_(&app_state->db_pool()),
+      statistics_view_(this, builder, app_state, &async_db_),
       export_view_(this, builder, app_state) {
   VERIFY(app_state_);
   InitializeWidgetPointers(builder);
@@ -155,7 +156,7 @@ MainWindow::MainWindow(
       sigc::mem_fun(*this, &MainWindow::OnStackSidebarButtonReleased));
   recent_activities_model_ =
       RecentActivitiesModel::create<RecentActivitiesModel>(
-          app_state_, this, resource_builder_);
+          app_state_, this, resource_builder_, &async_db_);
   lst_recent_activities_->bind_model(
       recent_activities_model_,
       recent_activities_model_->slot_create_widget());
@@ -230,11 +231,9 @@ void MainWindow::EditTask(Task* task) noexcept {
       break;
     }
     // Check for already present task with that name.
-    outcome::std_result<Task> maybe_conflicting_task = Task::LoadByName(
-        &app_state_->db_for_read_only(),
+    const TaskRef conflicting_task = app_state_->tasks().FindByName(
         task->name());
-    if (maybe_conflicting_task &&
-        maybe_conflicting_task.value().id() != task->id()) {
+    if (conflicting_task && conflicting_task->id() != task->id()) {
       Gtk::MessageDialog message_dlg(
           *this,
           _L("Error - this name already used by another task"),
@@ -280,24 +279,19 @@ void MainWindow::OnBtnStartStopClicked() noexcept {
         Gtk::BUTTONS_YES_NO,
         /* modal */ true);
     const int result = message_dlg.run();
-    if (result == Gtk::RESPONSE_YES) {
-      const auto save_result = app_state_->RecordRunningTaskActivity();
-      if (!save_result) {
-        OnFatalError(save_result.assume_error());
-      }
-    }
-    const auto drop_result = app_state_->DropRunningTask();
-    if (!drop_result) {
-      OnFatalError(drop_result.assume_error());
+    const auto stop_result = app_state_->StopRunningTask(
+        result == Gtk::RESPONSE_YES);
+    if (!stop_result) {
+      OnFatalError(stop_result.assume_error());
     }
   } else {
     StartTaskTimer();
     Gtk::ListBoxRow* selected_row = lst_tasks_->get_selected_row();
     VERIFY(selected_row);  // Button should be disabled if selection is abent.
     const Task::Id task_id = task_list_model_->GetTaskIdForRow(selected_row);
-    auto maybe_task = Task::LoadById(&app_state_->db_for_read_only(), task_id);
-    VERIFY(maybe_task);
-    const auto start_result = app_state_->StartRunningTask(maybe_task.value());
+    TaskRef task = app_state_->tasks().FindById(task_id);
+    VERIFY(task);
+    const auto start_result = app_state_->StartRunningTask(std::move(task));
     if (!start_result) {
       OnFatalError(start_result.assume_error());
     }
@@ -323,12 +317,9 @@ void MainWindow::OnLstTasksSelectionChanged(
   if (IsTaskRunning()) {
     // Active task archiving or changing must be disallowed by UI.
     VERIFY(selected_task_id);
-    auto maybe_task = Task::LoadById(
-        &app_state_->db_for_read_only(),
-        *selected_task_id);
-    VERIFY(maybe_task);
-    const auto maybe_result = app_state_->ChangeRunningTask(
-        std::move(maybe_task.value()));
+    TaskRef task = app_state_->tasks().FindById(*selected_task_id);
+    VERIFY(task);
+    const auto maybe_result = app_state_->ChangeRunningTask(std::move(task));
     VERIFY(maybe_result);
   }
   UpdateBtnStartStop();
@@ -360,14 +351,14 @@ bool MainWindow::OnTaskTimer() noexcept {
 }
 
 void MainWindow::OnRunningTaskChanged(
-    const std::optional<Task>& running_task) noexcept {
+    const TaskRef& running_task) noexcept {
   UpdateLblRunningTime();
   UpdateBtnStartStop();
-  btn_make_record_->set_sensitive(running_task != std::nullopt);
+  btn_make_record_->set_sensitive(running_task != nullptr);
 }
 
 void MainWindow::UpdateLblRunningTime() noexcept {
-  std::optional<Task> running_task = app_state_->running_task();
+  const TaskRef& running_task = app_state_->running_task();
   if (!running_task) {
     lbl_running_time_->set_text(_L("<No task running>"));
   } else {
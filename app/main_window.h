@@ -10,6 +10,7 @@
 #include "app/activity.h"
 #include "app/ui_helpers.h"
 #include "app/app_state.h"
+#include "app/async_db.h"
 #include "app/export_view.h"
 #include "app/statistics_view.h"
 
@@ -48,12 +49,12 @@ class MainWindow : public Gtk::Window {
   void OnBtnMakeRecordClicked() noexcept;
   void OnLstTasksSelectionChanged(
       const std::optional<Task::Id>& selected_task_id) noexcept;
-  void OnRunningTaskChanged(const std::optional<Task>&) noexcept;
+  void OnRunningTaskChanged(const TaskRef&) noexcept;
   void UpdateBtnStartStop() noexcept;
   bool OnTaskTimer() noexcept;
   void UpdateLblRunningTime() noexcept;
   bool IsTaskRunning() const noexcept {
-    return app_state_->running_task() != std::nullopt;
+    return app_state_->running_task() != nullptr;
   }
 
   Gtk::Button* btn_menu_ = nullptr;
@@ -71,6 +72,8 @@ class MainWindow : public Gtk::Window {
   Gtk::StackSidebar* page_stack_sidebar_ = nullptr;
   Glib::RefPtr<Gtk::Builder> resource_builder_;
   AppState* const app_state_;
+  // Must outlive all views and models, that post queries to it.
+  AsyncDb async_db_;
   sigc::connection running_task_changed_connection_;
   Glib::RefPtr<TaskListModelBase> task_list_model_;
   Glib::RefPtr<RecentActivitiesModel> recent_activities_model_;
@@ -0,0 +1,182 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+// Values, sorted by |Less|, with positions. Insertion, removal and position
+// lookup take O(log n) expected time. Implemented as treap, where each node
+// knows size of its subtree.
+// |Less| must be strict total order - no two distinct values may be
+// equivalent, so each value has single position.
+template<typename T, typename Less>
+class OrderStatisticTree {
+ public:
+  explicit OrderStatisticTree(Less less) noexcept
+      : less_(std::move(less)) {}
+
+  OrderStatisticTree(OrderStatisticTree&&) = default;
+  OrderStatisticTree& operator = (OrderStatisticTree&&) = default;
+
+  size_t size() const noexcept {
+    return Size(root_);
+  }
+
+  // Number of values, that precede |value|.
+  size_t LowerBoundRank(const T& value) const noexcept {
+    size_t rank = 0;
+    const Node* node = root_.get();
+    while (node) {
+      if (less_(node->value, value)) {
+        rank += Size(node->left) + 1;
+        node = node->right.get();
+      } else {
+        node = node->left.get();
+      }
+    }
+    return rank;
+  }
+
+  const T& At(size_t rank) const noexcept {
+    VERIFY(rank < size());
+    const Node* node = root_.get();
+    while (true) {
+      const size_t left_size = Size(node->left);
+      if (rank < left_size) {
+        node = node->left.get();
+      } else if (rank == left_size) {
+        return node->value;
+      } else {
+        rank -= left_size + 1;
+        node = node->right.get();
+      }
+    }
+  }
+
+  // Returns position of inserted value. Equivalent value must be absent.
+  size_t Insert(T value) noexcept {
+    NodePtr less;
+    NodePtr not_less;
+    Split(std::move(root_), value, &less, &not_less);
+    VERIFY(!not_less || less_(value, First(not_less)));
+    const size_t rank = Size(less);
+    auto node = std::make_unique<Node>(
+        std::move(value), static_cast<uint32_t>(random_()));
+    root_ = Merge(Merge(std::move(less), std::move(node)),
+                  std::move(not_less));
+    return rank;
+  }
+
+  // Returns position, that removed value had. Equivalent value must be
+  // present.
+  size_t Erase(const T& value) noexcept {
+    NodePtr less;
+    NodePtr not_less;
+    Split(std::move(root_), value, &less, &not_less);
+    VERIFY(not_less && !less_(value, First(not_less)));
+    const size_t rank = Size(less);
+    root_ = Merge(std::move(less), RemoveFirst(std::move(not_less)));
+    return rank;
+  }
+
+  void Clear() noexcept {
+    root_.reset();
+  }
+
+ private:
+  struct Node {
+    Node(T v, uint32_t p) noexcept
+        : value(std::move(v)),
+          priority(p) {}
+
+    T value;
+    // Parents have greater priorities than children, so random priorities
+    // keep the tree balanced.
+    uint32_t priority;
+    size_t size = 1;
+    std::unique_ptr<Node> left;
+    std::unique_ptr<Node> right;
+  };
+  using NodePtr = std::unique_ptr<Node>;
+
+  static size_t Size(const NodePtr& node) noexcept {
+    return node ? node->size : 0;
+  }
+
+  static void UpdateSize(Node* node) noexcept {
+    node->size = Size(node->left) + Size(node->right) + 1;
+  }
+
+  static const T& First(const NodePtr& node) noexcept {
+    const Node* result = node.get();
+    while (result->left) {
+      result = result->left.get();
+    }
+    return result->value;
+  }
+
+  // Splits |node| to values, that precede |value|, and all others.
+  void Split(NodePtr node,
+             const T& value,
+             NodePtr* less,
+             NodePtr* not_less) const noexcept {
+    if (!node) {
+      less->reset();
+      not_less->reset();
+      return;
+    }
+    if (less_(node->value, value)) {
+      Split(std::move(node->right), value, &node->right, not_less);
+      UpdateSize(node.get());
+      *less = std::move(node);
+    } else {
+      Split(std::move(node->left), value, less, &node->left);
+      UpdateSize(node.get());
+      *not_less = std::move(node);
+    }
+  }
+
+  // All values of |first| must precede values of |second|.
+  static NodePtr Merge(NodePtr first, NodePtr second) noexcept {
+    if (!first) {
+      return second;
+    }
+    if (!second) {
+      return first;
+    }
+    if (first->priority > second->priority) {
+      first->right = Merge(std::move(first->right), std::move(second));
+      UpdateSize(first.get());
+      return first;
+    } else {
+      second->left = Merge(std::move(first), std::move(second->left));
+      UpdateSize(second.get());
+      return second;
+    }
+  }
+
+  static NodePtr RemoveFirst(NodePtr node) noexcept {
+    if (!node->left) {
+      return std::move(node->right);
+    }
+    node->left = RemoveFirst(std::move(node->left));
+    UpdateSize(node.get());
+    return node;
+  }
+
+  Less less_;
+  // Fixed seed keeps tree shape reproducible.
+  std::minstd_rand random_;
+  NodePtr root_;
+};
+
+}  // namespace m_time_tracker
@@ -0,0 +1,82 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "app/order_statistic_tree.h"
+
+using m_time_tracker::OrderStatisticTree;
+
+namespace {
+
+using IntTree = OrderStatisticTree<int, std::less<int>>;
+
+void ExpectSameContent(const IntTree& tree, const std::vector<int>& expected) {
+  ASSERT_EQ(tree.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(tree.At(i), expected[i]);
+  }
+}
+
+}  // namespace
+
+TEST(OrderStatisticTreeTest, Basic) {
+  IntTree tree{std::less<int>()};
+  EXPECT_EQ(tree.size(), 0u);
+  EXPECT_EQ(tree.LowerBoundRank(10), 0u);
+
+  EXPECT_EQ(tree.Insert(20), 0u);
+  EXPECT_EQ(tree.Insert(10), 0u);
+  EXPECT_EQ(tree.Insert(30), 2u);
+  EXPECT_EQ(tree.Insert(25), 2u);
+  ExpectSameContent(tree, {10, 20, 25, 30});
+  EXPECT_EQ(tree.LowerBoundRank(5), 0u);
+  EXPECT_EQ(tree.LowerBoundRank(20), 1u);
+  EXPECT_EQ(tree.LowerBoundRank(21), 2u);
+  EXPECT_EQ(tree.LowerBoundRank(40), 4u);
+
+  EXPECT_EQ(tree.Erase(20), 1u);
+  ExpectSameContent(tree, {10, 25, 30});
+  EXPECT_EQ(tree.Erase(30), 2u);
+  EXPECT_EQ(tree.Erase(10), 0u);
+  ExpectSameContent(tree, {25});
+
+  tree.Clear();
+  EXPECT_EQ(tree.size(), 0u);
+}
+
+TEST(OrderStatisticTreeTest, MatchesSortedVector) {
+  // Custom order, as in list models.
+  auto greater = [](int first, int second) {
+    return first > second;
+  };
+  OrderStatisticTree<int, decltype(greater)> tree(greater);
+  std::vector<int> expected;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> values(0, 999);
+  for (int i = 0; i < 5000; ++i) {
+    const int value = values(random);
+    const auto it = std::lower_bound(
+        expected.begin(), expected.end(), value, greater);
+    const size_t rank = static_cast<size_t>(it - expected.begin());
+    EXPECT_EQ(tree.LowerBoundRank(value), rank);
+    if (it != expected.end() && *it == value) {
+      EXPECT_EQ(tree.Erase(value), rank);
+      expected.erase(it);
+    } else {
+      EXPECT_EQ(tree.Insert(value), rank);
+      expected.insert(it, value);
+    }
+    ASSERT_EQ(tree.size(), expected.size());
+  }
+  ASSERT_FALSE(expected.empty());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(tree.At(i), expected[i]);
+  }
+}
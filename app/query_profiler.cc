@@ -0,0 +1,223 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/query_profiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+double Milliseconds(std::chrono::nanoseconds time) noexcept {
+  return std::chrono::duration<double, std::milli>(time).count();
+}
+
+}  // namespace
+
+QueryProfiler::QueryProfiler(
+    sqlite3* connection,
+    std::chrono::milliseconds slow_query_threshold) noexcept
+    : connection_(connection),
+      slow_query_threshold_(slow_query_threshold) {
+  VERIFY(connection_);
+  const int result = sqlite3_trace_v2(
+      connection_,
+      SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW,
+      &QueryProfiler::TraceCallback,
+      this);
+  VERIFY(result == SQLITE_OK);
+}
+
+QueryProfiler::~QueryProfiler() {
+  const int result = sqlite3_trace_v2(connection_, 0, nullptr, nullptr);
+  VERIFY(result == SQLITE_OK);
+}
+
+// static
+int QueryProfiler::TraceCallback(
+    unsigned int type, void* context, void* p, void* x) noexcept {
+  QueryProfiler* self = static_cast<QueryProfiler*>(context);
+  if (self->logging_slow_queries_) {
+    return 0;
+  }
+  sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(p);
+  if (type == SQLITE_TRACE_ROW) {
+    self->OnRow(stmt);
+  } else if (type == SQLITE_TRACE_PROFILE) {
+    const int64_t nanoseconds = *static_cast<const int64_t*>(x);
+    self->OnProfile(stmt, std::chrono::nanoseconds(nanoseconds));
+  }
+  return 0;
+}
+
+void QueryProfiler::OnRow(sqlite3_stmt* stmt) noexcept {
+  ++pending_rows_[stmt];
+}
+
+void QueryProfiler::OnProfile(
+    sqlite3_stmt* stmt, std::chrono::nanoseconds time) noexcept {
+  int64_t rows = 0;
+  const auto it = pending_rows_.find(stmt);
+  if (it != pending_rows_.end()) {
+    rows = it->second;
+    pending_rows_.erase(it);
+  }
+  // Counter is reset, so next run of the same cached statement starts
+  // from zero.
+  const int vm_steps = sqlite3_stmt_status(
+      stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+  const char* sql = sqlite3_sql(stmt);
+  VERIFY(sql);
+  std::string query = NormalizeQuery(sql);
+  if (slow_query_threshold_.count() != 0 && time >= slow_query_threshold_) {
+    slow_queries_.push_back({query, time});
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto [entry_it, inserted] = stats_.try_emplace(query);
+  Entry& entry = entry_it->second;
+  if (inserted) {
+    entry.query = std::move(query);
+  }
+  ++entry.calls;
+  entry.total_time += time;
+  entry.max_time = std::max(entry.max_time, time);
+  entry.rows += rows;
+  entry.vm_steps += vm_steps;
+}
+
+void QueryProfiler::LogSlowQueries() noexcept {
+  if (slow_queries_.empty() || logging_slow_queries_) {
+    return;
+  }
+  logging_slow_queries_ = true;
+  std::vector<SlowQuery> slow_queries;
+  slow_queries.swap(slow_queries_);
+  for (const SlowQuery& slow_query : slow_queries) {
+    LogQueryPlan(slow_query);
+  }
+  logging_slow_queries_ = false;
+}
+
+void QueryProfiler::LogQueryPlan(const SlowQuery& slow_query) noexcept {
+  std::clog << "Slow query (" << Milliseconds(slow_query.time) << " ms): "
+            << slow_query.query << std::endl;
+  const std::string explain_query = "EXPLAIN QUERY PLAN " + slow_query.query;
+  sqlite3_stmt* stmt = nullptr;
+  int result = sqlite3_prepare_v2(
+      connection_,
+      explain_query.c_str(),
+      static_cast<int>(explain_query.size()),
+      &stmt,
+      nullptr);
+  if (result != SQLITE_OK) {
+    std::clog << "  Failed get query plan: " << sqlite3_errstr(result)
+              << std::endl;
+    return;
+  }
+  // Unbound parameters are treated as NULL, that does not affect the plan.
+  while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    // Columns are: id, parent, notused, detail.
+    const unsigned char* detail = sqlite3_column_text(stmt, 3);
+    std::clog << "  " << (detail ? reinterpret_cast<const char*>(detail) : "")
+              << std::endl;
+  }
+  if (result != SQLITE_DONE) {
+    std::clog << "  Failed get query plan: " << sqlite3_errstr(result)
+              << std::endl;
+  }
+  sqlite3_finalize(stmt);
+}
+
+std::vector<QueryProfiler::Entry> QueryProfiler::Stats() const noexcept {
+  std::vector<Entry> result;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    result.reserve(stats_.size());
+    for (const auto& [query, entry] : stats_) {
+      result.push_back(entry);
+    }
+  }
+  SortByTotalTime(&result);
+  return result;
+}
+
+// static
+std::vector<QueryProfiler::Entry> QueryProfiler::Merge(
+    std::vector<Entry> entries) noexcept {
+  std::unordered_map<std::string, Entry> merged;
+  for (Entry& entry : entries) {
+    auto [it, inserted] = merged.try_emplace(entry.query);
+    if (inserted) {
+      it->second = std::move(entry);
+      continue;
+    }
+    Entry& target = it->second;
+    target.calls += entry.calls;
+    target.total_time += entry.total_time;
+    target.max_time = std::max(target.max_time, entry.max_time);
+    target.rows += entry.rows;
+    target.vm_steps += entry.vm_steps;
+  }
+  std::vector<Entry> result;
+  result.reserve(merged.size());
+  for (auto& [query, entry] : merged) {
+    result.push_back(std::move(entry));
+  }
+  SortByTotalTime(&result);
+  return result;
+}
+
+// static
+std::string QueryProfiler::Format(const std::vector<Entry>& entries) noexcept {
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(3)
+      << "calls\ttotal_ms\tmax_ms\trows\tvm_steps\tquery\n";
+  for (const Entry& entry : entries) {
+    out << entry.calls << '\t'
+        << Milliseconds(entry.total_time) << '\t'
+        << Milliseconds(entry.max_time) << '\t'
+        << entry.rows << '\t'
+        << entry.vm_steps << '\t'
+        << entry.query << '\n';
+  }
+  return out.str();
+}
+
+// static
+std::string QueryProfiler::NormalizeQuery(std::string_view query) noexcept {
+  std::string result;
+  result.reserve(query.size());
+  bool pending_space = false;
+  for (const char c : query) {
+    if (c == ' ' || c == '\n' || c == '\t' || c == '\r') {
+      pending_space = !result.empty();
+      continue;
+    }
+    if (pending_space) {
+      result.push_back(' ');
+      pending_space = false;
+    }
+    result.push_back(c);
+  }
+  return result;
+}
+
+// static
+void QueryProfiler::SortByTotalTime(std::vector<Entry>* entries) noexcept {
+  std::sort(
+      entries->begin(),
+      entries->end(),
+      [](const Entry& first, const Entry& second) {
+        return first.total_time > second.total_time;
+      });
+}
+
+}  // namespace m_time_tracker
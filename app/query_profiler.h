@@ -0,0 +1,91 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sqlite3.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace m_time_tracker {
+
+// Collects statistics of statements, run on one connection, with
+// sqlite3_trace_v2(). Optionally logs plans of slow statements.
+class QueryProfiler {
+ public:
+  struct Entry {
+    // Query text with whitespace runs collapsed.
+    std::string query;
+    int64_t calls = 0;
+    std::chrono::nanoseconds total_time{0};
+    std::chrono::nanoseconds max_time{0};
+    int64_t rows = 0;
+    int64_t vm_steps = 0;
+  };
+
+  // Zero |slow_query_threshold| disables logging of slow queries.
+  QueryProfiler(
+      sqlite3* connection,
+      std::chrono::milliseconds slow_query_threshold) noexcept;
+  ~QueryProfiler();
+
+  QueryProfiler(const QueryProfiler&) = delete;
+  QueryProfiler& operator = (const QueryProfiler&) = delete;
+
+  std::chrono::milliseconds slow_query_threshold() const noexcept {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        slow_query_threshold_);
+  }
+
+  // Returns entries sorted by total time, descending.
+  // Unlike other methods, may be called from any thread.
+  std::vector<Entry> Stats() const noexcept;
+
+  // Logs plans of slow statements, finished since previous call, to
+  // std::clog. Plans can not be queried from the trace callback itself,
+  // since it is called in the middle of statement reset.
+  void LogSlowQueries() noexcept;
+
+  // Sums statistics of the same queries, e.g. collected by several
+  // connections. Result is sorted like |Stats()| result.
+  static std::vector<Entry> Merge(std::vector<Entry> entries) noexcept;
+  // Human-readable table, one query per line.
+  static std::string Format(const std::vector<Entry>& entries) noexcept;
+
+  static std::string NormalizeQuery(std::string_view query) noexcept;
+
+ private:
+  struct SlowQuery {
+    std::string query;
+    std::chrono::nanoseconds time;
+  };
+
+  static int TraceCallback(
+      unsigned int type, void* context, void* p, void* x) noexcept;
+  void OnRow(sqlite3_stmt* stmt) noexcept;
+  void OnProfile(sqlite3_stmt* stmt, std::chrono::nanoseconds time) noexcept;
+  void LogQueryPlan(const SlowQuery& slow_query) noexcept;
+  static void SortByTotalTime(std::vector<Entry>* entries) noexcept;
+
+  sqlite3* const connection_;
+  const std::chrono::nanoseconds slow_query_threshold_;
+  // Fields below are accessed only from the connection thread.
+  // Rows returned so far by statements in progress.
+  std::unordered_map<sqlite3_stmt*, int64_t> pending_rows_;
+  std::vector<SlowQuery> slow_queries_;
+  // Set while plans are queried, so that their statements are not
+  // accounted.
+  bool logging_slow_queries_ = false;
+
+  mutable std::mutex mutex_;
+  // Keyed by normalized query text. Guarded by |mutex_|.
+  std::unordered_map<std::string, Entry> stats_;
+};
+
+}  // namespace m_time_tracker
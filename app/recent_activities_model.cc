@@ -15,9 +15,22 @@ namespace m_time_tracker {
 RecentActivitiesModel::RecentActivitiesModel(
     AppState* app_state,
     MainWindow* main_window,
-    Glib::RefPtr<Gtk::Builder> resource_builder) noexcept
+    Glib::RefPtr<Gtk::Builder> resource_builder,
+    AsyncDb* async_db) noexcept
     : ActivitiesListModelBase(
-          app_state, main_window, main_window, resource_builder, true) {
+          app_state, main_window, main_window, resource_builder, true),
+      async_db_(async_db) {
+  VERIFY(async_db_);
+  all_connections_.emplace_back(app_state->ConnectExistingActivityChanged(
+      sigc::mem_fun(*this, &RecentActivitiesModel::OnActivityModified)));
+  all_connections_.emplace_back(app_state->ConnectAfterActivityAdded(
+      sigc::mem_fun(*this, &RecentActivitiesModel::OnActivityModified)));
+  all_connections_.emplace_back(app_state->ConnectAfterActivitiesAdded(
+      sigc::mem_fun(*this, &RecentActivitiesModel::OnActivitiesAdded)));
+  // Base class removes deleted row, but pending results would bring it
+  // back. Reload must start after deletion is committed.
+  all_connections_.emplace_back(app_state->ConnectAfterActivityDeleted(
+      sigc::mem_fun(*this, &RecentActivitiesModel::OnActivityModified)));
   Recalculate();
 }
 
@@ -29,11 +42,30 @@ bool RecentActivitiesModel::ShouldShowActivity(
 void RecentActivitiesModel::Recalculate() noexcept {
   earliest_start_time_ = Activity::GetCurrentTimePoint() -
           std::chrono::hours(24);
-  auto maybe_recent = Activity::LoadAfter(
-      &app_state_->db_for_read_only(),
-      earliest_start_time_);
-  VERIFY(maybe_recent);
-  SetContent(std::move(maybe_recent.value()));
+  // Supersedes previous request, if it is still running.
+  load_ticket_ = async_db_->Post(
+      [earliest_start_time = earliest_start_time_](Database* db) {
+        return Activity::LoadAfter(db, earliest_start_time);
+      },
+      [this](outcome::std_result<std::vector<Activity>> maybe_recent) {
+        VERIFY(maybe_recent);
+        SetContent(std::move(maybe_recent.value()));
+      });
+}
+
+void RecentActivitiesModel::OnActivityModified(const Activity&) noexcept {
+  // Pending results may be loaded before this change was committed, and
+  // would overwrite it in the list.
+  if (load_ticket_.is_pending()) {
+    Recalculate();
+  }
+}
+
+void RecentActivitiesModel::OnActivitiesAdded(
+    const std::vector<Activity>&) noexcept {
+  if (load_ticket_.is_pending()) {
+    Recalculate();
+  }
 }
 
 }  // namespace m_time_tracker
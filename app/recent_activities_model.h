@@ -6,6 +6,7 @@
 
 #include "app/activity.h"
 #include "app/activities_list_model_base.h"
+#include "app/async_db.h"
 
 namespace m_time_tracker {
 
@@ -18,15 +19,21 @@ class RecentActivitiesModel: public ActivitiesListModelBase {
 
  protected:
   friend class ListModelBase<Activity>;
+  // |async_db| must outlive this object.
   RecentActivitiesModel(
       AppState* app_state,
       MainWindow* main_window,
-      Glib::RefPtr<Gtk::Builder> resource_builder) noexcept;
+      Glib::RefPtr<Gtk::Builder> resource_builder,
+      AsyncDb* async_db) noexcept;
 
  private:
   bool ShouldShowActivity(const Activity& a) noexcept override;
+  void OnActivityModified(const Activity& a) noexcept;
+  void OnActivitiesAdded(const std::vector<Activity>& activities) noexcept;
 
   Activity::TimePoint earliest_start_time_{};
+  AsyncDb* const async_db_;
+  AsyncDb::Ticket load_ticket_;
 };
 
 }  // namespace m_time_tracker
@@ -38,13 +38,10 @@ outcome::std_result<std::optional<RunningTask>>
   if (!next_outcome) {
     return next_outcome.error();
   }
-  const std::optional<int64_t> task_id = row.Int64Column(0);
-  const std::optional<int64_t> start_time = row.Int64Column(1);
-  VERIFY(task_id);
-  VERIFY(start_time);
+  const auto [task_id, start_time] = row.Get<int64_t, int64_t>();
   return std::optional<RunningTask>(RunningTask(
-      *task_id,
-      Activity::TimePointFromInt(*start_time)));
+      task_id,
+      Activity::TimePointFromInt(start_time)));
 }
 
 outcome::std_result<void> RunningTask::Delete(Database* db) noexcept {
@@ -58,22 +55,23 @@ outcome::std_result<void> RunningTask::Delete(Database* db) noexcept {
 }
 
 outcome::std_result<void> RunningTask::Save(Database* db) noexcept {
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
   const auto delete_result = Delete(db);
   if (!delete_result) {
     return delete_result.error();
   }
-  const std::unordered_map<std::string, Database::Param> params = {
-    {":task_id", Database::Param(task_id_)},
-    {":start_time", Database::Param(Activity::IntFromTimePoint(start_time_))},
-  };
   const auto maybe_result = db->Execute(
       "INSERT INTO RunningTask(task_id, start_time) "
       "VALUES(:task_id, :start_time)",
-      params);
+      Bind(":task_id", task_id_),
+      Bind(":start_time", Activity::IntFromTimePoint(start_time_)));
   if (!maybe_result) {
     return maybe_result.error();
   }
-  return outcome::success();
+  return maybe_transaction.value().Commit();
 }
 
 }  // namespace m_time_tracker
@@ -0,0 +1,144 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/schema_migrations.h"
+
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "app/activity.h"
+#include "app/daily_task_totals.h"
+#include "app/running_task.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+namespace {
+
+using Migration = outcome::std_result<void>(*)(Database*);
+
+// Databases created before migrations were introduced have version 0 and
+// may already contain all these tables.
+outcome::std_result<void> CreateInitialTables(Database* db) noexcept {
+  const auto task_init_result = Task::EnsureTableCreated(db);
+  if (!task_init_result) {
+    return task_init_result.error();
+  }
+  const auto activity_init_result = Activity::EnsureTableCreated(db);
+  if (!activity_init_result) {
+    return activity_init_result.error();
+  }
+  return RunningTask::EnsureTableCreated(db);
+}
+
+outcome::std_result<void> CreateLookupIndices(Database* db) noexcept {
+  static constexpr std::string_view kQueries[] = {
+      "CREATE INDEX ActivitiesStartTime ON Activities(start_time)",
+      "CREATE INDEX ActivitiesEndTime ON Activities(end_time)",
+      "CREATE INDEX ActivitiesTaskIdStartTime "
+      "    ON Activities(task_id, start_time)",
+      "CREATE INDEX TasksParentTaskId ON Tasks(parent_task_id)",
+  };
+  for (std::string_view query : kQueries) {
+    const auto maybe_result = db->Execute(query);
+    if (!maybe_result) {
+      return maybe_result.error();
+    }
+  }
+  return outcome::success();
+}
+
+outcome::std_result<void> CreateDailyTaskTotals(Database* db) noexcept {
+  const auto create_result = DailyTaskTotals::EnsureTableCreated(db);
+  if (!create_result) {
+    return create_result.error();
+  }
+  // Lets statistics find the longest activity quickly, to limit the scan of
+  // activities, that may overlap partial days.
+  const auto index_result = db->Execute(
+      "CREATE INDEX ActivitiesDuration ON Activities(end_time - start_time)");
+  if (!index_result) {
+    return index_result.error();
+  }
+  return DailyTaskTotals::Rebuild(db);
+}
+
+outcome::std_result<void> CreateTaskClosure(Database* db) noexcept {
+  const auto create_result = Task::EnsureClosureTableCreated(db);
+  if (!create_result) {
+    return create_result.error();
+  }
+  return Task::RebuildClosure(db);
+}
+
+// Element with index N upgrades schema from version N to version N + 1.
+// Never change or remove already released migrations, only append new ones.
+constexpr Migration kMigrations[] = {
+    &CreateInitialTables,
+    &CreateLookupIndices,
+    &CreateDailyTaskTotals,
+    &CreateTaskClosure,
+};
+
+outcome::std_result<int> LoadSchemaVersion(Database* db) noexcept {
+  auto maybe_rows = db->Select("PRAGMA user_version");
+  if (!maybe_rows) {
+    return maybe_rows.error();
+  }
+  const auto next_outcome = maybe_rows.value().NextRow();
+  if (!next_outcome) {
+    return next_outcome.error();
+  }
+  const std::optional<int> version = maybe_rows.value().IntColumn(0);
+  VERIFY(version);
+  return *version;
+}
+
+outcome::std_result<void> RunMigration(
+    Database* db, int version) noexcept {
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  const auto migration_result = kMigrations[version](db);
+  if (!migration_result) {
+    return migration_result.error();
+  }
+  // Pragma arguments can not be bound as parameters.
+  const auto version_result = db->Execute(
+      "PRAGMA user_version = " + std::to_string(version + 1));
+  if (!version_result) {
+    return version_result.error();
+  }
+  return maybe_transaction.value().Commit();
+}
+
+}  // namespace
+
+int LatestSchemaVersion() noexcept {
+  return static_cast<int>(std::size(kMigrations));
+}
+
+outcome::std_result<void> UpgradeSchema(Database* db) noexcept {
+  const auto maybe_version = LoadSchemaVersion(db);
+  if (!maybe_version) {
+    return maybe_version.error();
+  }
+  if (maybe_version.value() > LatestSchemaVersion()) {
+    return ErrorCodes::kUnsupportedSchemaVersion;
+  }
+  for (int version = maybe_version.value();
+       version < LatestSchemaVersion();
+       ++version) {
+    const auto migration_result = RunMigration(db, version);
+    if (!migration_result) {
+      return migration_result.error();
+    }
+  }
+  return outcome::success();
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,22 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include "app/database.h"
+#include "app/error_codes.h"
+
+namespace m_time_tracker {
+
+// Brings DB schema to the latest version, running all migrations not yet
+// applied to it. Applied version is stored in "PRAGMA user_version".
+// Each migration runs in its own transaction.
+// Fails with ErrorCodes::kUnsupportedSchemaVersion if DB was created
+// by newer application version.
+outcome::std_result<void> UpgradeSchema(Database* db) noexcept;
+
+// Returns version that would be set by |UpgradeSchema|.
+int LatestSchemaVersion() noexcept;
+
+}  // namespace m_time_tracker
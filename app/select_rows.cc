@@ -12,7 +12,12 @@ const outcome::std_result<void> SelectRows::kOutcomeDone =
     ErrorCodeFromSqlite(SQLITE_DONE);
 
 SelectRows::~SelectRows() {
-  if (stmt_) {
+  if (!stmt_) {
+    return;
+  }
+  if (cache_) {
+    cache_->Release(stmt_);
+  } else {
     const int result = sqlite3_finalize(stmt_);
     VERIFY(result == SQLITE_OK);
   }
@@ -20,6 +25,10 @@ SelectRows::~SelectRows() {
 
 outcome::std_result<void> SelectRows::NextRow() noexcept {
   VERIFY(stmt_);
+  if (!end_result_) {
+    // Stepping again would restart statement from the first row.
+    return end_result_;
+  }
   const int result = sqlite3_step(stmt_);
   if (result == SQLITE_ROW) {
     // Move succeeded.
@@ -27,7 +36,15 @@ outcome::std_result<void> SelectRows::NextRow() noexcept {
   }
   // Don't expect it there. Callers don't know how to handle it in any case.
   VERIFY(result != SQLITE_OK);
-  return ErrorCodeFromSqlite(result);
+  end_result_ = ErrorCodeFromSqlite(result);
+  return end_result_;
+}
+
+outcome::std_result<void> SelectRows::status() const noexcept {
+  if (end_result_ == kOutcomeDone) {
+    return outcome::success();
+  }
+  return end_result_;
 }
 
 std::optional<int> SelectRows::IntColumn(int index) noexcept {
@@ -49,15 +66,18 @@ std::optional<int64_t> SelectRows::Int64Column(int index) noexcept {
 }
 
 std::optional<std::string> SelectRows::StringColumn(int index) noexcept {
-  VERIFY(stmt_);
-  const int type = sqlite3_column_type(stmt_, index);
-  if (type == SQLITE_NULL) {
+  const std::optional<std::string_view> result = StringViewColumn(index);
+  if (!result) {
     return std::nullopt;
   }
-  const char* result = reinterpret_cast<const char*>(
-      sqlite3_column_text(stmt_, index));
-  VERIFY(result);
-  return std::string(result);
+  return std::string(*result);
+}
+
+std::optional<std::string_view> SelectRows::StringViewColumn(
+    int index) noexcept {
+  VERIFY(stmt_);
+  return internal::ColumnReader<std::optional<std::string_view>>::Read(
+      stmt_, index);
 }
 
 }  // namespace m_time_tracker
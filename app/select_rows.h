@@ -6,41 +6,234 @@
 
 #include <sqlite3.h>
 
+#include <cstddef>
+#include <iterator>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "app/error_codes.h"
+#include "app/statement_cache.h"
 #include "app/verify.h"
 
 namespace m_time_tracker {
 
+namespace internal {
+
+// Reads cell without checking its type. NULL cells are read as 0 or as
+// an empty string, so nullable columns must be read as std::optional<T>.
+template<typename T>
+struct ColumnReader;
+
+template<>
+struct ColumnReader<int> {
+  static int Read(sqlite3_stmt* stmt, int index) noexcept {
+    return sqlite3_column_int(stmt, index);
+  }
+};
+
+template<>
+struct ColumnReader<int64_t> {
+  static int64_t Read(sqlite3_stmt* stmt, int index) noexcept {
+    return sqlite3_column_int64(stmt, index);
+  }
+};
+
+template<>
+struct ColumnReader<std::string_view> {
+  static std::string_view Read(sqlite3_stmt* stmt, int index) noexcept {
+    // Text must be fetched before its size, since fetching may convert it.
+    const char* text = reinterpret_cast<const char*>(
+        sqlite3_column_text(stmt, index));
+    if (!text) {
+      return std::string_view();
+    }
+    return std::string_view(
+        text,
+        static_cast<size_t>(sqlite3_column_bytes(stmt, index)));
+  }
+};
+
+template<>
+struct ColumnReader<std::string> {
+  static std::string Read(sqlite3_stmt* stmt, int index) noexcept {
+    return std::string(ColumnReader<std::string_view>::Read(stmt, index));
+  }
+};
+
+template<typename T>
+struct ColumnReader<std::optional<T>> {
+  static std::optional<T> Read(sqlite3_stmt* stmt, int index) noexcept {
+    if (sqlite3_column_type(stmt, index) == SQLITE_NULL) {
+      return std::nullopt;
+    }
+    return ColumnReader<T>::Read(stmt, index);
+  }
+};
+
+template<typename T>
+struct IsViewType : std::is_same<T, std::string_view> {};
+
+template<typename T>
+struct IsViewType<std::optional<T>> : IsViewType<T> {};
+
+}  // namespace internal
+
 class SelectRows {
  public:
   static const outcome::std_result<void> kOutcomeDone;
 
-  explicit SelectRows(sqlite3_stmt* stmt) noexcept
-      : stmt_(stmt) {
+  // Input iterator over rows. Dereferencing gives SelectRows object itself,
+  // positioned at current row. Iteration stops on the last row or on error,
+  // so |status()| must be checked after the loop:
+  //   for (SelectRows& row : rows) {
+  //     ...
+  //   }
+  //   if (!rows.status()) {
+  //     return rows.status().error();
+  //   }
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = SelectRows;
+    using difference_type = std::ptrdiff_t;
+    using pointer = SelectRows*;
+    using reference = SelectRows&;
+
+    explicit Iterator(SelectRows* rows) noexcept
+        : rows_(rows) {
+      Advance();
+    }
+
+    SelectRows& operator * () const noexcept {
+      VERIFY(rows_);
+      return *rows_;
+    }
+
+    Iterator& operator ++ () noexcept {
+      Advance();
+      return *this;
+    }
+
+    bool operator == (const Iterator& second) const noexcept {
+      return rows_ == second.rows_;
+    }
+
+    bool operator != (const Iterator& second) const noexcept {
+      return rows_ != second.rows_;
+    }
+
+   private:
+    void Advance() noexcept {
+      if (rows_ && !rows_->NextRow()) {
+        rows_ = nullptr;
+      }
+    }
+
+    SelectRows* rows_;
+  };
+
+  // If |cache| is not null, |stmt| is handed back to it on destruction
+  // instead of being finalized.
+  SelectRows(sqlite3_stmt* stmt, StatementCache* cache) noexcept
+      : stmt_(stmt),
+        cache_(cache) {
     VERIFY(stmt);
   }
   SelectRows(const SelectRows&) = delete;
   SelectRows& operator = (const SelectRows&) = delete;
   SelectRows(SelectRows&& second) noexcept
-      : stmt_(second.stmt_) {
+      : stmt_(second.stmt_),
+        cache_(second.cache_),
+        end_result_(second.end_result_) {
     second.stmt_ = nullptr;
   }
 
   ~SelectRows();
 
+  // Once kOutcomeDone or an error is returned, subsequent calls return
+  // the same result without touching the statement.
   outcome::std_result<void> NextRow() noexcept;
 
+  // Returns success unless stepping through rows failed.
+  outcome::std_result<void> status() const noexcept;
+
+  Iterator begin() noexcept {
+    return Iterator(this);
+  }
+
+  Iterator end() noexcept {
+    return Iterator(nullptr);
+  }
+
   // Column indices are zero-based.
   // Returns nullopt if corresponding cell is NULL.
   std::optional<int> IntColumn(int index) noexcept;
   std::optional<int64_t> Int64Column(int index) noexcept;
   std::optional<std::string> StringColumn(int index) noexcept;
+  // Returned view is valid until next call to |NextRow()|.
+  std::optional<std::string_view> StringViewColumn(int index) noexcept;
+
+  // Reads first sizeof...(Ts) columns of current row, e.g.
+  //   auto [id, name] = rows.Get<int64_t, std::optional<std::string_view>>();
+  // Supported types are int, int64_t, std::string_view and std::optional
+  // of them. Only std::optional<T> columns are checked for NULL, NULL cells
+  // of other types are read as 0 or as an empty string. Views are valid
+  // until next call to |NextRow()|.
+  template<typename... Ts>
+  std::tuple<Ts...> Get() noexcept {
+    VERIFY(stmt_);
+    VERIFY(sqlite3_data_count(stmt_) >= static_cast<int>(sizeof...(Ts)));
+    return GetImpl<Ts...>(std::index_sequence_for<Ts...>());
+  }
+
+  // Fetches at most |max_rows| next rows, appending cells of each column to
+  // corresponding vector, in the order of columns. Column types are
+  // the same as for |Get()|, except views, that can not outlive the row.
+  // Returns number of fetched rows; zero when there are no more rows.
+  template<typename... Ts>
+  outcome::std_result<size_t> FetchBatch(
+      size_t max_rows, std::vector<Ts>*... columns) noexcept {
+    static_assert(
+        !(false || ... || internal::IsViewType<Ts>::value),
+        "Views are invalidated by fetching of the next row");
+    VERIFY(stmt_);
+    size_t fetched = 0;
+    for (; fetched < max_rows; ++fetched) {
+      const auto next_outcome = NextRow();
+      if (!next_outcome) {
+        if (next_outcome != kOutcomeDone) {
+          return next_outcome.error();
+        }
+        break;
+      }
+      AppendRow(std::index_sequence_for<Ts...>(), columns...);
+    }
+    return fetched;
+  }
 
  private:
+  template<typename... Ts, size_t... Is>
+  void AppendRow(
+      std::index_sequence<Is...>, std::vector<Ts>*... columns) noexcept {
+    (columns->push_back(
+        internal::ColumnReader<Ts>::Read(stmt_, static_cast<int>(Is))), ...);
+  }
+
+  template<typename... Ts, size_t... Is>
+  std::tuple<Ts...> GetImpl(std::index_sequence<Is...>) noexcept {
+    return std::tuple<Ts...>{
+        internal::ColumnReader<Ts>::Read(stmt_, static_cast<int>(Is))...};
+  }
+
   sqlite3_stmt* stmt_;
+  StatementCache* cache_;
+  // Success while there may be more rows, kOutcomeDone or error otherwise.
+  outcome::std_result<void> end_result_ = outcome::success();
 };
 
 }  // namespace m_time_tracker
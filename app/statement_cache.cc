@@ -0,0 +1,116 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/statement_cache.h"
+
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+StatementCache::StatementCache(sqlite3* connection, size_t capacity) noexcept
+    : connection_(connection),
+      capacity_(capacity) {
+  VERIFY(connection_);
+}
+
+StatementCache::~StatementCache() {
+  for (const Entry& entry : entries_) {
+    // All SelectRows objects must be destroyed before Database.
+    VERIFY(!entry.in_use);
+    const int result = sqlite3_finalize(entry.stmt);
+    VERIFY(result == SQLITE_OK);
+  }
+}
+
+outcome::std_result<sqlite3_stmt*> StatementCache::Acquire(
+    std::string_view query) noexcept {
+  auto it = query_to_entry_.find(query);
+  if (it != query_to_entry_.end() && !it->second->in_use) {
+    ++stats_.hits;
+    it->second->in_use = true;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->stmt;
+  }
+  ++stats_.misses;
+  if (it != query_to_entry_.end()) {
+    // Same query is executed recursively. Don't cache this copy.
+    return Prepare(query, 0);
+  }
+  auto maybe_stmt = Prepare(query, SQLITE_PREPARE_PERSISTENT);
+  if (!maybe_stmt) {
+    return maybe_stmt.error();
+  }
+  entries_.emplace_front(std::string(query), maybe_stmt.value());
+  entries_.front().in_use = true;
+  query_to_entry_.emplace(entries_.front().query, entries_.begin());
+  stmt_to_entry_.emplace(entries_.front().stmt, entries_.begin());
+  EvictUnused();
+  return maybe_stmt.value();
+}
+
+void StatementCache::Release(sqlite3_stmt* stmt) noexcept {
+  VERIFY(stmt);
+  // Result code of reset repeats error of the last step, if any, that is
+  // already reported to the client.
+  sqlite3_reset(stmt);
+  const int result = sqlite3_clear_bindings(stmt);
+  VERIFY(result == SQLITE_OK);
+  const auto it = stmt_to_entry_.find(stmt);
+  if (it != stmt_to_entry_.end()) {
+    VERIFY(it->second->in_use);
+    it->second->in_use = false;
+    EvictUnused();
+  } else {
+    const int result = sqlite3_finalize(stmt);
+    VERIFY(result == SQLITE_OK);
+  }
+}
+
+int* StatementCache::ParamIndexSlots(
+    sqlite3_stmt* stmt, size_t count) noexcept {
+  const auto it = stmt_to_entry_.find(stmt);
+  if (it == stmt_to_entry_.end()) {
+    return nullptr;
+  }
+  std::vector<int>& param_indices = it->second->param_indices;
+  if (param_indices.size() != count) {
+    param_indices.assign(count, 0);
+  }
+  return param_indices.data();
+}
+
+outcome::std_result<sqlite3_stmt*> StatementCache::Prepare(
+    std::string_view query, unsigned int flags) noexcept {
+  sqlite3_stmt* stmt = nullptr;
+  const int result = sqlite3_prepare_v3(
+      connection_,
+      query.data(),
+      static_cast<int>(query.size()),
+      flags,
+      &stmt,
+      nullptr);
+  if (result != SQLITE_OK) {
+    return ErrorCodeFromSqlite(result);
+  }
+  return stmt;
+}
+
+void StatementCache::EvictUnused() noexcept {
+  auto it = entries_.end();
+  while (entries_.size() > capacity_ && it != entries_.begin()) {
+    --it;
+    if (it->in_use) {
+      continue;
+    }
+    VERIFY(query_to_entry_.erase(it->query) == 1);
+    VERIFY(stmt_to_entry_.erase(it->stmt) == 1);
+    const int result = sqlite3_finalize(it->stmt);
+    VERIFY(result == SQLITE_OK);
+    it = entries_.erase(it);
+  }
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,79 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <sqlite3.h>
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "app/error_codes.h"
+
+namespace m_time_tracker {
+
+// LRU cache of prepared statements, keyed by query text.
+// Statement returned by |Acquire()| stays owned by the cache and must be
+// handed back with |Release()| when client is done with it. If the same
+// query is requested while its cached statement is still in use, a
+// temporary statement is prepared and finalized on release.
+class StatementCache {
+ public:
+  struct Stats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+  };
+
+  StatementCache(sqlite3* connection, size_t capacity) noexcept;
+  ~StatementCache();
+
+  StatementCache(const StatementCache&) = delete;
+  StatementCache& operator = (const StatementCache&) = delete;
+
+  outcome::std_result<sqlite3_stmt*> Acquire(std::string_view query) noexcept;
+  // Resets statement and clears its bindings, so it can be reused.
+  void Release(sqlite3_stmt* stmt) noexcept;
+
+  // Returns storage for |count| parameter indices, associated with cached
+  // |stmt|, so clients may resolve parameter names only once. Slots are
+  // zero-filled when statement is added to the cache.
+  // Returns nullptr if |stmt| is not cached.
+  int* ParamIndexSlots(sqlite3_stmt* stmt, size_t count) noexcept;
+
+  const Stats& stats() const noexcept {
+    return stats_;
+  }
+
+ private:
+  struct Entry {
+    Entry(std::string q, sqlite3_stmt* s) noexcept
+        : query(std::move(q)),
+          stmt(s) {}
+
+    std::string query;
+    sqlite3_stmt* stmt;
+    bool in_use = false;
+    std::vector<int> param_indices;
+  };
+  using EntryList = std::list<Entry>;
+
+  outcome::std_result<sqlite3_stmt*> Prepare(
+      std::string_view query, unsigned int flags) noexcept;
+  void EvictUnused() noexcept;
+
+  sqlite3* const connection_;
+  const size_t capacity_;
+  // Most recently used entries are at the front.
+  EntryList entries_;
+  // Keys point to |Entry::query| strings, that are never changed.
+  std::unordered_map<std::string_view, EntryList::iterator> query_to_entry_;
+  std::unordered_map<sqlite3_stmt*, EntryList::iterator> stmt_to_entry_;
+  Stats stats_;
+};
+
+}  // namespace m_time_tracker
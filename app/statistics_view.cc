@@ -6,6 +6,7 @@
 
 #include <pangomm/layout.h>
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -19,6 +20,9 @@ namespace m_time_tracker {
 namespace {
 
 constexpr int kBarPadding = 10;
+// Each load caches levels of children of all listed tasks, so this is
+// enough for few date ranges with few drill-down levels each.
+constexpr size_t kMaxCachedStats = 64;
 
 struct BarLayoutInfo {
   double bar_height;
@@ -68,7 +72,8 @@ BarLayoutInfo MakeBarLayout(
 StatisticsView::StatisticsView(
     MainWindow* main_window,
     const Glib::RefPtr<Gtk::Builder>& resource_builder,
-    AppState* app_state) noexcept
+    AppState* app_state,
+    AsyncDb* async_db) noexcept
     : ViewWithDateRange(
         main_window,
         resource_builder,
@@ -78,7 +83,10 @@ StatisticsView::StatisticsView(
         "cmb_stat_quick_select_date"),
       main_window_(main_window),
       resource_builder_(resource_builder),
-      app_state_(app_state) {
+      app_state_(app_state),
+      async_db_(async_db),
+      stats_cache_(kMaxCachedStats) {
+  VERIFY(async_db_);
   InitializeWidgetPointers(resource_builder);
 
   drawing_->signal_draw().connect(
@@ -88,10 +96,28 @@ StatisticsView::StatisticsView(
       sigc::mem_fun(*this, &StatisticsView::OnDrawingButtonPressed));
   existing_task_changed_connection_ = app_state_->ConnectExistingTaskChanged(
       sigc::mem_fun(*this, &StatisticsView::OnExistingTaskChanged));
+  after_task_added_connection_ = app_state_->ConnectAfterTaskAdded(
+      sigc::mem_fun(*this, &StatisticsView::OnAfterTaskAdded));
+  after_activity_added_connection_ = app_state_->ConnectAfterActivityAdded(
+      sigc::mem_fun(*this, &StatisticsView::OnAfterActivityAdded));
+  after_activities_added_connection_ =
+      app_state_->ConnectAfterActivitiesAdded(
+          sigc::mem_fun(*this, &StatisticsView::OnAfterActivitiesAdded));
+  existing_activity_replaced_connection_ =
+      app_state_->ConnectExistingActivityReplaced(
+          sigc::mem_fun(*this, &StatisticsView::OnExistingActivityReplaced));
+  after_activity_deleted_connection_ =
+      app_state_->ConnectAfterActivityDeleted(
+          sigc::mem_fun(*this, &StatisticsView::OnAfterActivityDeleted));
 }
 
 StatisticsView::~StatisticsView() {
   existing_task_changed_connection_.disconnect();
+  after_task_added_connection_.disconnect();
+  after_activity_added_connection_.disconnect();
+  after_activities_added_connection_.disconnect();
+  existing_activity_replaced_connection_.disconnect();
+  after_activity_deleted_connection_.disconnect();
 }
 
 void StatisticsView::InitializeWidgetPointers(
@@ -115,8 +141,6 @@ bool StatisticsView::StatisticsDraw(
   double current_y = 0.5;
   ctx->set_line_width(1);
   for (DisplayedStatInfo& entry : displayed_stats_) {
-    const auto it_task = tasks_cache_.find(entry.stat.task_id);
-    VERIFY(it_task != tasks_cache_.end());
     const Cairo::RectangleInt stat_entry_rect = DrawStatEntryRect(
         ctx,
         control_width,
@@ -124,7 +148,7 @@ bool StatisticsView::StatisticsDraw(
         pango_layout,
         total_duration,
         entry.stat.duration,
-        it_task->second);
+        *GetTask(entry.stat.task_id));
     entry.last_drawn_rect = stat_entry_rect;
     current_y += stat_entry_rect.height;
   }
@@ -132,7 +156,7 @@ bool StatisticsView::StatisticsDraw(
 }
 
 bool StatisticsView::OnDrawingButtonPressed(GdkEventButton* evt) noexcept {
-  std::optional<Task> chosen_task;
+  TaskRef chosen_task;
   for (const DisplayedStatInfo& entry : displayed_stats_) {
     if (!entry.last_drawn_rect) {
       continue;
@@ -140,14 +164,12 @@ bool StatisticsView::OnDrawingButtonPressed(GdkEventButton* evt) noexcept {
     // Intentionally don't check X to ease clicking on too narrow bars.
     if (entry.last_drawn_rect->y <= evt->y &&
         (entry.last_drawn_rect->y + entry.last_drawn_rect->height) > evt->y) {
-      const auto it_task = tasks_cache_.find(entry.stat.task_id);
-      VERIFY(it_task != tasks_cache_.end());
-      chosen_task = it_task->second;
+      chosen_task = GetTask(entry.stat.task_id);
       break;
     }
   }
   if (chosen_task) {
-    if (!current_parent_task_id_ && HasChildren(*chosen_task)) {
+    if (HasChildren(*chosen_task)) {
       current_parent_task_id_ = chosen_task->id();
       Recalculate();
     } else {
@@ -155,7 +177,8 @@ bool StatisticsView::OnDrawingButtonPressed(GdkEventButton* evt) noexcept {
           &app_state_->db_for_read_only(),
           chosen_task->id(),
           from_time(),
-          to_time());
+          to_time(),
+          app_state_->activity_index());
       if (!activities_list) {
         main_window_->OnFatalError(activities_list.assume_error());
       }
@@ -167,11 +190,13 @@ bool StatisticsView::OnDrawingButtonPressed(GdkEventButton* evt) noexcept {
       dlg->SetActivitiesList(activities_list.value());
       dlg->run();
       dlg->hide();
-      // User may have edited some of the activities.
-      Recalculate();
+      // Edits, made in the dialog, are already applied through AppState
+      // signals.
     }
   } else if (current_parent_task_id_) {
-    current_parent_task_id_ = std::nullopt;
+    // Go one level up.
+    current_parent_task_id_ =
+        GetTask(*current_parent_task_id_)->parent_task_id();
     Recalculate();
   }
   return false;  // Allow event propagation.
@@ -194,13 +219,11 @@ int StatisticsView::CalculageContentHeight() noexcept {
   SetFontForBarDrawing(pango_layout);
   double result = 0;
   for (const DisplayedStatInfo& entry : displayed_stats_) {
-    const auto it_task = tasks_cache_.find(entry.stat.task_id);
-    VERIFY(it_task != tasks_cache_.end());
     const BarLayoutInfo layout_info = MakeBarLayout(
         pango_layout,
         control_width,
         entry.stat.duration,
-        it_task->second);
+        *GetTask(entry.stat.task_id));
     result += layout_info.bar_height;
   }
   return static_cast<int>(result);
@@ -266,21 +289,59 @@ void StatisticsView::ResetCurrentTaskAndRecalculate() noexcept {
 }
 
 void StatisticsView::Recalculate() noexcept {
-  const outcome::std_result<std::vector<Activity::StatEntry>> maybe_stats =
-      current_parent_task_id_ ?
-          Activity::LoadStatsForInterval(
-              &app_state_->db_for_read_only(),
-              from_time(), to_time(),
-              *current_parent_task_id_) :
-          Activity::LoadStatsForTopLevelTasksInInterval(
-              &app_state_->db_for_read_only(),
-              from_time(), to_time());
+  const StatsCache::Key key = CurrentStatsKey();
+  if (const StatsCache::Value* cached = stats_cache_.Find(key)) {
+    // Previous request, if it is still running, is outdated.
+    stats_ticket_.Cancel();
+    ShowStats(key, cached->stats, cached->stat_groups);
+    return;
+  }
+  // Supersedes previous request, if it is still running.
+  // Children of each listed task are loaded too, so drill-down is served
+  // from the cache.
+  stats_ticket_ = async_db_->Post(
+      [activity_index = app_state_->activity_index(), key](Database* db) {
+        return Activity::LoadTwoLevelStats(
+            db, key.from_time, key.to_time, key.parent_task_id,
+            activity_index);
+      },
+      [this, key](outcome::std_result<Activity::TwoLevelStats> maybe_stats) {
+        OnStatsLoaded(key, std::move(maybe_stats));
+      });
+}
+
+void StatisticsView::OnStatsLoaded(
+    const StatsCache::Key& key,
+    outcome::std_result<Activity::TwoLevelStats> maybe_stats) noexcept {
   if (!maybe_stats) {
     main_window_->OnFatalError(maybe_stats.assume_error());
   }
+  Activity::TwoLevelStats& loaded = maybe_stats.value();
+  for (auto& [task_id, child_level] : loaded.child_levels) {
+    stats_cache_.Insert(
+        StatsCache::Key{key.from_time, key.to_time, task_id},
+        TakeStatsLevel(&child_level));
+  }
+  // Inserted last, so it is the last to be evicted.
+  StatsCache::Value value = TakeStatsLevel(&loaded.level);
+  stats_cache_.Insert(key, value);
+  ShowStats(key, value.stats, std::move(value.stat_groups));
+}
+
+StatsCache::Value StatisticsView::TakeStatsLevel(
+    Activity::StatsLevel* level) noexcept {
+  VERIFY(level);
+  return StatsCache::Value{std::move(level->stats), std::move(level->groups)};
+}
+
+void StatisticsView::ShowStats(
+    const StatsCache::Key& key,
+    const std::vector<Activity::StatEntry>& stats,
+    std::unordered_map<Task::Id, Task::Id> stat_groups) noexcept {
   displayed_stats_.clear();
-  displayed_stats_.reserve(maybe_stats.value().size());
-  for (const Activity::StatEntry& stat : maybe_stats.value()) {
+  displayed_stats_.reserve(stats.size());
+  for (const Activity::StatEntry& stat : stats) {
+    VERIFY(app_state_->tasks().FindById(stat.task_id));
     displayed_stats_.push_back({stat, std::nullopt});
   }
   std::sort(
@@ -290,39 +351,202 @@ void StatisticsView::Recalculate() noexcept {
       // Sort by duration, descending.
       return first.stat.duration > second.stat.duration;
   });
+  stat_groups_ = std::move(stat_groups);
+  displayed_stats_key_ = key;
+  UpdateDrawingSize();
+}
+
+StatsCache::Key StatisticsView::CurrentStatsKey() const noexcept {
+  return StatsCache::Key{from_time(), to_time(), current_parent_task_id_};
+}
+
+void StatisticsView::CacheDisplayedStats() noexcept {
+  if (!displayed_stats_key_) {
+    return;
+  }
+  StatsCache::Value value;
+  value.stats.reserve(displayed_stats_.size());
   for (const DisplayedStatInfo& entry : displayed_stats_) {
-    if (tasks_cache_.count(entry.stat.task_id) == 0) {
-      auto maybe_task = Task::LoadById(
-          &app_state_->db_for_read_only(),
-          entry.stat.task_id);
-      if (!maybe_task) {
-        main_window_->OnFatalError(maybe_task.assume_error());
-      }
-      tasks_cache_.insert({
-        entry.stat.task_id, std::move(maybe_task.value())});
-    }
+    value.stats.push_back(entry.stat);
   }
+  value.stat_groups = stat_groups_;
+  stats_cache_.Insert(*displayed_stats_key_, std::move(value));
+}
+
+void StatisticsView::UpdateDrawingSize() noexcept {
   drawing_->set_size_request(-1, CalculageContentHeight());
   drawing_->queue_draw();
 }
 
-void StatisticsView::OnExistingTaskChanged(const Task& task) noexcept {
+void StatisticsView::OnExistingTaskChanged(const TaskRef& task) noexcept {
+  VERIFY(task->id());
+  const auto it_group = stat_groups_.find(*task->id());
+  const std::optional<Task::Id> group = (it_group != stat_groups_.end()) ?
+      std::optional<Task::Id>(it_group->second) : std::nullopt;
+  if (group != ExpectedStatGroup(*task)) {
+    // Task was moved with its whole subtree to another group. Cached
+    // groups of other levels are likely affected too.
+    stats_cache_.Clear();
+    Recalculate();
+  }
+}
+
+void StatisticsView::OnAfterTaskAdded(const TaskRef& task) noexcept {
+  VERIFY(task->id());
+  // Cached groups miss the new task.
+  stats_cache_.Clear();
+  if (stats_ticket_.is_pending()) {
+    // Loaded groups may miss the new task.
+    Recalculate();
+    return;
+  }
+  const std::optional<Task::Id> group = ExpectedStatGroup(*task);
+  if (group) {
+    stat_groups_[*task->id()] = *group;
+  }
+  CacheDisplayedStats();
+}
+
+TaskRef StatisticsView::GetTask(Task::Id task_id) const noexcept {
+  TaskRef task = app_state_->tasks().FindById(task_id);
+  VERIFY(task);
+  return task;
+}
+
+std::optional<Task::Id> StatisticsView::ExpectedStatGroup(
+    const Task& task) const noexcept {
   VERIFY(task.id());
-  auto it = tasks_cache_.find(*task.id());
-  if (it != tasks_cache_.end()) {
-    it->second = task;
+  if (!displayed_stats_key_) {
+    return std::nullopt;
+  }
+  if (task.parent_task_id() == displayed_stats_key_->parent_task_id) {
+    return task.id();
+  }
+  if (!task.parent_task_id()) {
+    return std::nullopt;
+  }
+  const auto it = stat_groups_.find(*task.parent_task_id());
+  if (it == stat_groups_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void StatisticsView::OnAfterActivityAdded(const Activity& activity) noexcept {
+  stats_cache_.InvalidateActivity(activity);
+  if (stats_ticket_.is_pending() || !AddActivityDuration(activity, 1)) {
+    Recalculate();
+    return;
+  }
+  CacheDisplayedStats();
+  UpdateDrawingSize();
+}
+
+void StatisticsView::OnAfterActivitiesAdded(
+    const std::vector<Activity>& activities) noexcept {
+  for (const Activity& activity : activities) {
+    stats_cache_.InvalidateActivity(activity);
+  }
+  if (stats_ticket_.is_pending()) {
+    Recalculate();
+    return;
   }
+  for (const Activity& activity : activities) {
+    if (!AddActivityDuration(activity, 1)) {
+      Recalculate();
+      return;
+    }
+  }
+  CacheDisplayedStats();
+  UpdateDrawingSize();
+}
+
+void StatisticsView::OnExistingActivityReplaced(
+    const Activity& old_activity, const Activity& new_activity) noexcept {
+  stats_cache_.InvalidateActivity(old_activity);
+  stats_cache_.InvalidateActivity(new_activity);
+  if (stats_ticket_.is_pending() ||
+      !AddActivityDuration(old_activity, -1) ||
+      !AddActivityDuration(new_activity, 1)) {
+    Recalculate();
+    return;
+  }
+  CacheDisplayedStats();
+  UpdateDrawingSize();
+}
+
+void StatisticsView::OnAfterActivityDeleted(
+    const Activity& activity) noexcept {
+  stats_cache_.InvalidateActivity(activity);
+  if (stats_ticket_.is_pending() || !AddActivityDuration(activity, -1)) {
+    Recalculate();
+    return;
+  }
+  CacheDisplayedStats();
+  UpdateDrawingSize();
+}
+
+bool StatisticsView::AddActivityDuration(
+    const Activity& activity, int sign) noexcept {
+  if (!activity.end_time()) {
+    // Not completed activities are not accounted in statistics.
+    return true;
+  }
+  if (!displayed_stats_key_) {
+    // Nothing is loaded yet.
+    return true;
+  }
+  const Activity::TimePoint start =
+      std::max(activity.start_time(), displayed_stats_key_->from_time);
+  const Activity::TimePoint end =
+      std::min(*activity.end_time(), displayed_stats_key_->to_time);
+  if (start >= end) {
+    return true;
+  }
+  const auto it_group = stat_groups_.find(activity.task_id());
+  if (it_group == stat_groups_.end()) {
+    // Task is not displayed at the current level.
+    return true;
+  }
+  const Task::Id group_id = it_group->second;
+  Activity::Duration duration = sign * (end - start);
+  auto it = std::find_if(
+      displayed_stats_.begin(),
+      displayed_stats_.end(),
+      [group_id](const DisplayedStatInfo& entry) {
+        return entry.stat.task_id == group_id;
+      });
+  if (it != displayed_stats_.end()) {
+    duration += it->stat.duration;
+  }
+  if (duration < Activity::Duration::zero()) {
+    // Displayed stats are left as is for the caller to reload them.
+    return false;
+  }
+  if (it != displayed_stats_.end()) {
+    displayed_stats_.erase(it);
+  }
+  if (duration == Activity::Duration::zero()) {
+    return true;
+  }
+  // Only the changed entry is moved to keep sorting by duration,
+  // descending.
+  const auto position = std::upper_bound(
+      displayed_stats_.begin(),
+      displayed_stats_.end(),
+      duration,
+      [](const Activity::Duration& value, const DisplayedStatInfo& entry) {
+        return value > entry.stat.duration;
+      });
+  displayed_stats_.insert(
+      position,
+      DisplayedStatInfo{Activity::StatEntry(group_id, duration), std::nullopt});
+  return true;
 }
 
 bool StatisticsView::HasChildren(const Task& task) const noexcept {
   VERIFY(task.id());
-  const auto maybe_child_count = Task::ChildTasksCount(
-      &app_state_->db_for_read_only(),
-      *task.id());
-  if (!maybe_child_count) {
-    main_window_->OnFatalError(maybe_child_count.assume_error());
-  }
-  return maybe_child_count.value() != 0;
+  return !app_state_->tasks().ChildIds(task.id()).empty();
 }
 
 }  // namespace m_time_tracker
@@ -8,6 +8,8 @@
 
 #include "app/activity.h"
 #include "app/app_state.h"
+#include "app/async_db.h"
+#include "app/stats_cache.h"
 #include "app/ui_helpers.h"
 #include "app/view_with_date_range.h"
 
@@ -20,12 +22,25 @@ class StatisticsView : public ViewWithDateRange {
   StatisticsView(
       MainWindow* main_window,
       const Glib::RefPtr<Gtk::Builder>& resource_builder,
-      AppState* app_state) noexcept;
+      AppState* app_state,
+      AsyncDb* async_db) noexcept;
   ~StatisticsView();
   void ResetCurrentTaskAndRecalculate() noexcept;
 
  private:
+  // Takes statistics from |stats_cache_| if possible.
   void Recalculate() noexcept;
+  void OnStatsLoaded(
+      const StatsCache::Key& key,
+      outcome::std_result<Activity::TwoLevelStats> maybe_stats) noexcept;
+  StatsCache::Value TakeStatsLevel(Activity::StatsLevel* level) noexcept;
+  void ShowStats(
+      const StatsCache::Key& key,
+      const std::vector<Activity::StatEntry>& stats,
+      std::unordered_map<Task::Id, Task::Id> stat_groups) noexcept;
+  StatsCache::Key CurrentStatsKey() const noexcept;
+  // Puts statistics, updated in place, back to the cache.
+  void CacheDisplayedStats() noexcept;
   struct DisplayedStatInfo {
     Activity::StatEntry stat;
     std::optional<Cairo::RectangleInt> last_drawn_rect;
@@ -40,7 +55,23 @@ class StatisticsView : public ViewWithDateRange {
   bool StatisticsDraw(const Cairo::RefPtr<Cairo::Context>& ctx) noexcept;
   bool OnDrawingButtonPressed(GdkEventButton* evt) noexcept;
 
-  void OnExistingTaskChanged(const Task& task) noexcept;
+  void OnExistingTaskChanged(const TaskRef& task) noexcept;
+  void OnAfterTaskAdded(const TaskRef& task) noexcept;
+  void OnAfterActivityAdded(const Activity& activity) noexcept;
+  void OnAfterActivitiesAdded(
+      const std::vector<Activity>& activities) noexcept;
+  void OnExistingActivityReplaced(
+      const Activity& old_activity, const Activity& new_activity) noexcept;
+  void OnAfterActivityDeleted(const Activity& activity) noexcept;
+  // Adds clipped duration of |activity|, multiplied by |sign|, to
+  // displayed statistics. Returns false if statistics can not be updated
+  // in place, and must be reloaded instead.
+  bool AddActivityDuration(const Activity& activity, int sign) noexcept;
+  // Group, that |task| belongs to according to |stat_groups_|, assuming
+  // it is the only task changed since statistics were loaded.
+  std::optional<Task::Id> ExpectedStatGroup(const Task& task) const noexcept;
+  void UpdateDrawingSize() noexcept;
+  TaskRef GetTask(Task::Id task_id) const noexcept;
   Cairo::RectangleInt DrawStatEntryRect(
       const Cairo::RefPtr<Cairo::Context>& ctx,
       int control_width,
@@ -61,8 +92,19 @@ class StatisticsView : public ViewWithDateRange {
   MainWindow* const main_window_;
   Glib::RefPtr<Gtk::Builder> resource_builder_;
   AppState* const app_state_;
-  std::unordered_map<Task::Id, Task> tasks_cache_;
+  AsyncDb* const async_db_;
+  AsyncDb::Ticket stats_ticket_;
+  // Groups of tasks, accounted in |displayed_stats_|.
+  std::unordered_map<Task::Id, Task::Id> stat_groups_;
+  // Interval and parent of |displayed_stats_|, if anything is loaded.
+  std::optional<StatsCache::Key> displayed_stats_key_;
+  StatsCache stats_cache_;
   sigc::connection existing_task_changed_connection_;
+  sigc::connection after_task_added_connection_;
+  sigc::connection after_activity_added_connection_;
+  sigc::connection after_activities_added_connection_;
+  sigc::connection existing_activity_replaced_connection_;
+  sigc::connection after_activity_deleted_connection_;
 };
 
 }  // namespace m_time_tracker
@@ -0,0 +1,74 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/stats_cache.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+StatsCache::StatsCache(size_t max_size) noexcept
+    : max_size_(max_size) {
+  VERIFY(max_size_ > 0);
+}
+
+const StatsCache::Value* StatsCache::Find(const Key& key) noexcept {
+  for (Entry& entry : entries_) {
+    if (entry.key == key) {
+      entry.last_use = ++use_counter_;
+      return &entry.value;
+    }
+  }
+  return nullptr;
+}
+
+void StatsCache::Insert(const Key& key, Value value) noexcept {
+  for (Entry& entry : entries_) {
+    if (entry.key == key) {
+      entry.value = std::move(value);
+      entry.last_use = ++use_counter_;
+      return;
+    }
+  }
+  if (entries_.size() >= max_size_) {
+    const auto it_oldest = std::min_element(
+        entries_.begin(),
+        entries_.end(),
+        [](const Entry& first, const Entry& second) {
+          return first.last_use < second.last_use;
+        });
+    entries_.erase(it_oldest);
+  }
+  entries_.push_back(Entry{key, std::move(value), ++use_counter_});
+}
+
+void StatsCache::InvalidateInterval(
+    const Activity::TimePoint& start_time,
+    const Activity::TimePoint& end_time) noexcept {
+  entries_.erase(
+      std::remove_if(
+          entries_.begin(),
+          entries_.end(),
+          [&start_time, &end_time](const Entry& entry) {
+            return entry.key.from_time < end_time &&
+                start_time < entry.key.to_time;
+          }),
+      entries_.end());
+}
+
+void StatsCache::InvalidateActivity(const Activity& activity) noexcept {
+  // Not completed activities are not accounted in statistics.
+  if (activity.end_time()) {
+    InvalidateInterval(activity.start_time(), *activity.end_time());
+  }
+}
+
+void StatsCache::Clear() noexcept {
+  entries_.clear();
+}
+
+}  // namespace m_time_tracker
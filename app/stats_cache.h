@@ -0,0 +1,73 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "app/activity.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+// Few recently loaded statistics, so switching pages and drill-down
+// levels back and forth does not repeat identical queries.
+// Entries are dropped when activities in their interval change.
+class StatsCache {
+ public:
+  struct Key {
+    Activity::TimePoint from_time;
+    Activity::TimePoint to_time;
+    std::optional<Task::Id> parent_task_id;
+
+    bool operator == (const Key& second) const noexcept {
+      return from_time == second.from_time &&
+          to_time == second.to_time &&
+          parent_task_id == second.parent_task_id;
+    }
+  };
+
+  struct Value {
+    std::vector<Activity::StatEntry> stats;
+    // See Activity::LoadStatGroups.
+    std::unordered_map<Task::Id, Task::Id> stat_groups;
+  };
+
+  explicit StatsCache(size_t max_size) noexcept;
+
+  // Returns nullptr if there is no entry for |key|. Pointer is valid
+  // until the next non-const call.
+  const Value* Find(const Key& key) noexcept;
+  // Replaces previous value for |key|, if any. Evicts least recently
+  // used entry if cache is full.
+  void Insert(const Key& key, Value value) noexcept;
+  // Drops entries with intervals, overlapping [start_time, end_time).
+  void InvalidateInterval(
+      const Activity::TimePoint& start_time,
+      const Activity::TimePoint& end_time) noexcept;
+  // Drops entries, that may be affected by |activity| change.
+  void InvalidateActivity(const Activity& activity) noexcept;
+  void Clear() noexcept;
+
+  size_t size() const noexcept {
+    return entries_.size();
+  }
+
+ private:
+  struct Entry {
+    Key key;
+    Value value;
+    uint64_t last_use;
+  };
+
+  const size_t max_size_;
+  // Small enough for linear search.
+  std::vector<Entry> entries_;
+  uint64_t use_counter_ = 0;
+};
+
+}  // namespace m_time_tracker
@@ -4,6 +4,7 @@
 
 #include "app/task.h"
 
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 
@@ -31,27 +32,68 @@ outcome::std_result<void> Task::EnsureTableCreated(Database* db) noexcept {
   return outcome::success();
 }
 
+// static
+outcome::std_result<void> Task::EnsureClosureTableCreated(
+    Database* db) noexcept {
+  static constexpr std::string_view kQueries[] = {
+      "CREATE TABLE IF NOT EXISTS TaskClosure( "
+      "  ancestor INTEGER NOT NULL, "
+      "  descendant INTEGER NOT NULL, "
+      "  depth INTEGER NOT NULL, "
+      "  PRIMARY KEY(ancestor, descendant)) WITHOUT ROWID",
+      "CREATE INDEX IF NOT EXISTS TaskClosureDescendant "
+      "    ON TaskClosure(descendant)",
+  };
+  for (std::string_view query : kQueries) {
+    const auto maybe_result = db->Execute(query);
+    if (!maybe_result) {
+      return maybe_result.error();
+    }
+  }
+  return outcome::success();
+}
+
+// static
+outcome::std_result<void> Task::RebuildClosure(Database* db) noexcept {
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
+  const auto delete_result = db->Execute("DELETE FROM TaskClosure");
+  if (!delete_result) {
+    return delete_result.error();
+  }
+  const auto insert_result = db->Execute(
+      "INSERT INTO TaskClosure(ancestor, descendant, depth) "
+      " WITH RECURSIVE Closure(ancestor, descendant, depth) AS ("
+      "   SELECT id, id, 0 FROM Tasks "
+      "   UNION ALL "
+      "   SELECT Closure.ancestor, Tasks.id, Closure.depth + 1 "
+      "     FROM Closure, Tasks "
+      "     WHERE Tasks.parent_task_id = Closure.descendant) "
+      " SELECT ancestor, descendant, depth FROM Closure");
+  if (!insert_result) {
+    return insert_result.error();
+  }
+  return maybe_transaction.value().Commit();
+}
+
 // static
 // Assumes same column order as specified by kBaseSelectQuery.
 Task Task::CreateFromSelectRow(SelectRows* row) noexcept {
-  const std::optional<int64_t> id = row->Int64Column(0);
-  std::optional<std::string> name = row->StringColumn(1);
-  const std::optional<int> is_archived = row->IntColumn(2);
-  const std::optional<int64_t> parent_task_id = row->Int64Column(3);
-  // Check non-null fields.
-  VERIFY(id);
-  VERIFY(name);
-  VERIFY(is_archived);
+  // Table schema guarantees that only parent_task_id may be NULL.
+  const auto [id, name, is_archived, parent_task_id] = row->Get<
+      int64_t, std::string_view, int, std::optional<int64_t>>();
   return Task(
-      *id,
-      std::move(*name),
+      id,
+      std::string(name),
       parent_task_id,
-      *is_archived);
+      is_archived);
 }
 
 // static
 outcome::std_result<std::vector<Task>> Task::LoadAll(Database* db) noexcept {
-  return LoadWithQuery(db, kBaseSelectQuery);
+  return TasksFromSelectResults(db->Select(kBaseSelectQuery));
 }
 
 // static
@@ -59,14 +101,14 @@ outcome::std_result<std::vector<Task>> Task::LoadNotArchived(
     Database* db) noexcept {
   const std::string query = std::string(kBaseSelectQuery) +
       " WHERE is_archived=0";
-  return LoadWithQuery(db, query);
+  return TasksFromSelectResults(db->Select(query));
 }
 
 // static
 outcome::std_result<Task> Task::LoadById(Database* db, Id id) noexcept {
   const std::string query = std::string(kBaseSelectQuery) +
-      " WHERE id=" + std::to_string(id);
-  auto maybe_tasks = LoadWithQuery(db, query);
+      " WHERE id=?1";
+  auto maybe_tasks = TasksFromSelectResults(db->Select(query, id));
   if (!maybe_tasks) {
     return maybe_tasks.error();
   }
@@ -82,11 +124,8 @@ outcome::std_result<Task> Task::LoadById(Database* db, Id id) noexcept {
 outcome::std_result<Task> Task::LoadByName(
     Database* db, const std::string& name) noexcept {
   const std::string query = std::string(kBaseSelectQuery) +
-      " WHERE name=:name";
-  const std::unordered_map<std::string, Database::Param> params = {
-    {":name", Database::Param(name)},
-  };
-  auto maybe_tasks = LoadWithQuery(db, query, params);
+      " WHERE name=?1";
+  auto maybe_tasks = TasksFromSelectResults(db->Select(query, name));
   if (!maybe_tasks) {
     return maybe_tasks.error();
   }
@@ -103,7 +142,7 @@ outcome::std_result<std::vector<Task>> Task::LoadTopLevel(
     Database* db) noexcept {
   const std::string query = std::string(kBaseSelectQuery) +
       " WHERE parent_task_id IS NULL";
-  return LoadWithQuery(db, query);
+  return TasksFromSelectResults(db->Select(query));
 }
 
 // static
@@ -111,8 +150,8 @@ outcome::std_result<std::vector<Task>> Task::LoadChildTasks(
       Database* db, const Task& parent) noexcept {
   VERIFY(parent.id_);  // Parent must be saved.
   const std::string query = std::string(kBaseSelectQuery) +
-      " WHERE parent_task_id=" + std::to_string(*parent.id_);
-  return LoadWithQuery(db, query);
+      " WHERE parent_task_id=?1";
+  return TasksFromSelectResults(db->Select(query, *parent.id_));
 }
 
 // static
@@ -120,11 +159,8 @@ outcome::std_result<int64_t> Task::ChildTasksCount(
     Database* db,
     Task::Id task_id) noexcept {
   static const std::string_view kQuery =
-      "SELECT count(*) FROM Tasks WHERE parent_task_id = :id";
-  const std::unordered_map<std::string, Database::Param> params = {
-    {":id", Database::Param(task_id)},
-  };
-  auto maybe_rows = db->Select(kQuery, params);
+      "SELECT count(*) FROM Tasks WHERE parent_task_id = ?1";
+  auto maybe_rows = db->Select(kQuery, task_id);
   if (!maybe_rows) {
     return maybe_rows.error();
   }
@@ -140,28 +176,55 @@ outcome::std_result<int64_t> Task::ChildTasksCount(
 }
 
 // static
-outcome::std_result<std::vector<Task>> Task::LoadWithQuery(
-    Database* db, std::string_view query,
-    const std::unordered_map<std::string, Database::Param>& params) noexcept {
-  auto maybe_rows = db->Select(query, params);
+outcome::std_result<std::vector<Task>> Task::TasksFromSelectResults(
+    outcome::std_result<SelectRows> maybe_rows) noexcept {
   if (!maybe_rows) {
     return maybe_rows.error();
   }
   SelectRows& rows = maybe_rows.value();
   std::vector<Task> result;
-  while (true) {
-    const auto next_outcome = rows.NextRow();
-    if (next_outcome == SelectRows::kOutcomeDone) {
-      break;
-    }
-    if (!next_outcome) {
-      return next_outcome.error();
-    }
-    result.emplace_back(CreateFromSelectRow(&rows));
+  for (SelectRows& row : rows) {
+    result.emplace_back(CreateFromSelectRow(&row));
+  }
+  if (!rows.status()) {
+    return rows.status().error();
   }
   return result;
 }
 
+// static
+outcome::std_result<void> Task::MoveSubtreeInClosure(
+    Database* db,
+    Id id,
+    std::optional<Id> new_parent_task_id) noexcept {
+  // Links between the subtree and its old ancestors.
+  const auto delete_result = db->Execute(
+      "DELETE FROM TaskClosure "
+      " WHERE descendant IN "
+      "     (SELECT descendant FROM TaskClosure WHERE ancestor = :id) "
+      "   AND ancestor NOT IN "
+      "     (SELECT descendant FROM TaskClosure WHERE ancestor = :id)",
+      Bind(":id", id));
+  if (!delete_result) {
+    return delete_result.error();
+  }
+  if (!new_parent_task_id) {
+    return outcome::success();
+  }
+  const auto insert_result = db->Execute(
+      "INSERT INTO TaskClosure(ancestor, descendant, depth) "
+      " SELECT Above.ancestor, Below.descendant, "
+      "     Above.depth + Below.depth + 1 "
+      "   FROM TaskClosure AS Above, TaskClosure AS Below "
+      "   WHERE Above.descendant = :parent_task_id AND Below.ancestor = :id",
+      Bind(":parent_task_id", *new_parent_task_id),
+      Bind(":id", id));
+  if (!insert_result) {
+    return insert_result.error();
+  }
+  return outcome::success();
+}
+
 // static
 outcome::std_result<void> Task::Save(Database* db) noexcept {
   if (parent_task_id_ && !is_archived_) {
@@ -175,41 +238,86 @@ outcome::std_result<void> Task::Save(Database* db) noexcept {
       is_archived_ = true;
     }
   }
+  auto maybe_transaction = db->BeginTransaction();
+  if (!maybe_transaction) {
+    return maybe_transaction.error();
+  }
   if (id_) {
-    const std::unordered_map<std::string, Database::Param> params = {
-      {":name", Database::Param(name_)},
-      {":is_archived", Database::Param(is_archived_)},
-      {":parent_task_id", Database::Param(parent_task_id_)},
-      {":id", Database::Param(id_)},
-    };
+    const auto maybe_old_task = LoadById(db, *id_);
+    if (!maybe_old_task) {
+      return maybe_old_task.error();
+    }
+    const bool parent_changed =
+        maybe_old_task.value().parent_task_id_ != parent_task_id_;
+    if (parent_changed && parent_task_id_) {
+      auto maybe_rows = db->Select(
+          "SELECT 1 FROM TaskClosure "
+          " WHERE ancestor = :id AND descendant = :parent_task_id",
+          Bind(":id", *id_),
+          Bind(":parent_task_id", *parent_task_id_));
+      if (!maybe_rows) {
+        return maybe_rows.error();
+      }
+      const auto next_outcome = maybe_rows.value().NextRow();
+      if (next_outcome != SelectRows::kOutcomeDone) {
+        if (!next_outcome) {
+          return next_outcome.error();
+        }
+        // New parent is inside subtree of this task.
+        return ErrorCodes::kTaskHierarchyCycle;
+      }
+    }
     auto exec_result = db->Execute(
         "UPDATE Tasks SET "
         " name=:name,"
         " is_archived=:is_archived,"
         " parent_task_id=:parent_task_id"
         " WHERE id=:id",
-        params);
+        Bind(":name", name_),
+        Bind(":is_archived", is_archived_),
+        Bind(":parent_task_id", parent_task_id_),
+        Bind(":id", *id_));
     if (!exec_result) {
       return exec_result.error();
     }
-  } else {
-    const std::unordered_map<std::string, Database::Param> params = {
-      {":name", Database::Param(name_)},
-      {":is_archived", Database::Param(is_archived_)},
-      {":parent_task_id", Database::Param(parent_task_id_)},
-    };
-    auto exec_result = db->Execute(
-        "INSERT INTO Tasks(name, is_archived, parent_task_id) VALUES("
-        " :name,"
-        " :is_archived,"
-        " :parent_task_id"
-        ")",
-        params);
-    if (!exec_result) {
-      return exec_result.error();
+    if (parent_changed) {
+      const auto move_result = MoveSubtreeInClosure(
+          db, *id_, parent_task_id_);
+      if (!move_result) {
+        return move_result.error();
+      }
     }
-    id_ = exec_result.value();
+    return maybe_transaction.value().Commit();
+  }
+  auto exec_result = db->Execute(
+      "INSERT INTO Tasks(name, is_archived, parent_task_id) VALUES("
+      " :name,"
+      " :is_archived,"
+      " :parent_task_id"
+      ")",
+      Bind(":name", name_),
+      Bind(":is_archived", is_archived_),
+      Bind(":parent_task_id", parent_task_id_));
+  if (!exec_result) {
+    return exec_result.error();
+  }
+  const Id new_id = exec_result.value();
+  const auto closure_result = db->Execute(
+      "INSERT INTO TaskClosure(ancestor, descendant, depth) "
+      " SELECT ancestor, :id, depth + 1 FROM TaskClosure "
+      "   WHERE descendant = :parent_task_id "
+      " UNION ALL "
+      " SELECT :id, :id, 0",
+      Bind(":id", new_id),
+      Bind(":parent_task_id", parent_task_id_));
+  if (!closure_result) {
+    return closure_result.error();
+  }
+  const auto commit_result = maybe_transaction.value().Commit();
+  if (!commit_result) {
+    return commit_result.error();
   }
+  id_ = new_id;
   return outcome::success();
 }
 
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -22,6 +23,14 @@ class Task {
   using Id = int64_t;
 
   static outcome::std_result<void> EnsureTableCreated(Database* db) noexcept;
+  // TaskClosure table has a row for each pair of task and its ancestor
+  // or task itself, with distance between them in |depth|, so whole
+  // subtrees are joined with a single index lookup. It is kept up to date
+  // by |Save|.
+  static outcome::std_result<void> EnsureClosureTableCreated(
+      Database* db) noexcept;
+  // Recomputes TaskClosure from parent_task_id of all tasks.
+  static outcome::std_result<void> RebuildClosure(Database* db) noexcept;
   static outcome::std_result<std::vector<Task>> LoadAll(Database* db) noexcept;
   static outcome::std_result<std::vector<Task>> LoadNotArchived(
       Database* db) noexcept;
@@ -36,6 +45,9 @@ class Task {
       Database* db,
       Task::Id task_id) noexcept;
 
+  // Tasks may be nested at any depth. Fails with
+  // ErrorCodes::kTaskHierarchyCycle if the new parent is the task itself
+  // or one of its descendants.
   outcome::std_result<void> Save(Database* db) noexcept;
 
   // New task object, without parent task object, not archived.
@@ -89,10 +101,14 @@ class Task {
         is_archived_(is_archived) {
   }
   static Task CreateFromSelectRow(SelectRows* row) noexcept;
-  static outcome::std_result<std::vector<Task>> LoadWithQuery(
-      Database* db, std::string_view query,
-      const std::unordered_map<
-          std::string, Database::Param>& params = {}) noexcept;
+  static outcome::std_result<std::vector<Task>> TasksFromSelectResults(
+      outcome::std_result<SelectRows> maybe_rows) noexcept;
+  // Moves subtree of saved task |id| under |new_parent_task_id| in
+  // TaskClosure.
+  static outcome::std_result<void> MoveSubtreeInClosure(
+      Database* db,
+      Id id,
+      std::optional<Id> new_parent_task_id) noexcept;
 
   std::optional<Id> id_;
   std::string name_;
@@ -100,4 +116,10 @@ class Task {
   bool is_archived_;
 };
 
+// Immutable snapshot of a saved task, shared by all its holders, so
+// copying it costs a reference count increment. To edit a task, copy
+// the pointed Task and save it through AppState, that replaces the
+// snapshot; holders of the old one keep it until they are notified.
+using TaskRef = std::shared_ptr<const Task>;
+
 }  // namespace m_time_tracker
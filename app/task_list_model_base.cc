@@ -4,6 +4,7 @@
 
 #include "app/task_list_model_base.h"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -54,19 +55,25 @@ class ChildTaskListModel: public ListModelBase<Task> {
  protected:
   ChildTaskListModel(
       AppState* app_state,
-      Task::Id parent_task_id,
+      Task::Id top_level_task_id,
       bool should_display_archived,
       TaskListModelBase* parent_model) noexcept
       : ListModelBase(app_state),
-        parent_task_id_(parent_task_id),
+        top_level_task_id_(top_level_task_id),
         should_display_archived_(should_display_archived),
         parent_model_(parent_model) {
     all_connections_.emplace_back(app_state->ConnectExistingTaskChanged(
-        sigc::mem_fun(*this, &ChildTaskListModel::ExistingObjectChanged)));
+        [this](const TaskRef& task) {
+          ExistingObjectChanged(*task);
+        }));
     all_connections_.emplace_back(app_state->ConnectAfterTaskAdded(
-        sigc::mem_fun(*this, &ChildTaskListModel::AfterObjectAdded)));
+        [this](const TaskRef& task) {
+          AfterObjectAdded(*task);
+        }));
     all_connections_.emplace_back(app_state->ConnectBeforeTaskDeleted(
-        sigc::mem_fun(*this, &ChildTaskListModel::BeforeObjectDeleted)));
+        [this](const TaskRef& task) {
+          BeforeObjectDeleted(*task);
+        }));
   }
 
   Glib::RefPtr<Gtk::Widget> CreateRowFromObject(
@@ -78,7 +85,7 @@ class ChildTaskListModel: public ListModelBase<Task> {
   }
 
  private:
-  const Task::Id parent_task_id_;
+  const Task::Id top_level_task_id_;
   const bool should_display_archived_;
   TaskListModelBase* const parent_model_;
 };
@@ -86,8 +93,9 @@ class ChildTaskListModel: public ListModelBase<Task> {
 Glib::RefPtr<Gtk::Widget> ChildTaskListModel::CreateRowFromObject(
     const Task& t) noexcept {
   if (!t.parent_task_id() ||
-      *t.parent_task_id() != parent_task_id_) {
-    // This task does not belong to this parent task ID - do nothing.
+      app_state_->tasks().TopLevelAncestorId(*t.parent_task_id()) !=
+          top_level_task_id_) {
+    // This task is not in subtree of this top-level task - do nothing.
     return Glib::RefPtr<Gtk::Widget>();
   }
   if (t.is_archived() && !should_display_archived_) {
@@ -102,6 +110,15 @@ Glib::RefPtr<Gtk::Widget> ChildTaskListModel::CreateRowFromObject(
   hdy_preferences_row_set_title(
       reinterpret_cast<HdyPreferencesRow*>(wrapped_row->gobj()),
       title.c_str());
+  if (*t.parent_task_id() != top_level_task_id_) {
+    // All descendants are listed together, so show parent of deeper ones.
+    const TaskRef parent_task =
+        app_state_->tasks().FindById(*t.parent_task_id());
+    VERIFY(parent_task);
+    hdy_action_row_set_subtitle(
+        reinterpret_cast<HdyActionRow*>(row),
+        parent_task->name().c_str());
+  }
   parent_model_->CustomizeRow(wrapped_row, t);
   wrapped_row->show();
   return wrapped_row;
@@ -129,18 +146,45 @@ TaskListModelBase::~TaskListModelBase() {
 }
 
 void TaskListModelBase::InitContent() noexcept {
-  const outcome::std_result<std::vector<Task>> maybe_tasks =
-      should_display_archived_ ?
-         Task::LoadAll(&app_state_->db_for_read_only()) :
-         Task::LoadNotArchived(&app_state_->db_for_read_only());
-  VERIFY(maybe_tasks);
-  SetContent(maybe_tasks.value());
+  std::vector<TaskRef> tasks = app_state_->tasks().All();
+  if (!should_display_archived_) {
+    tasks.erase(
+        std::remove_if(
+            tasks.begin(),
+            tasks.end(),
+            [](const TaskRef& t) {
+              return t->is_archived();
+            }),
+        tasks.end());
+  }
+  SetContent(tasks);
+}
+
+void TaskListModelBase::ReloadContent() noexcept {
+  const std::optional<Task::Id> selected_task_id = selected_task_id_;
+  bool selection_restored = false;
+  {
+    // Selected task is usually still displayed, so don't report that
+    // selection was lost while rows are re-created.
+    ScopedChangeValue supperss(&signals_suppressed_, true);
+    InitContent();
+    if (selected_task_id &&
+        (top_level_rows_.count(*selected_task_id) != 0 ||
+            FindTopLevelRowInfoForChild(*selected_task_id))) {
+      SelectTask(selected_task_id);
+      selection_restored = true;
+    }
+  }
+  if (selected_task_id && !selection_restored) {
+    SetNewSelectedTaskId(std::nullopt);
+  }
 }
 
-void TaskListModelBase::SetContent(const std::vector<Task>& tasks) noexcept {
+void TaskListModelBase::SetContent(
+    const std::vector<TaskRef>& tasks) noexcept {
   std::vector<Glib::RefPtr<Gtk::Widget>> row_controls;
   remove_all();
-  top_level_rows_ = ExtractTopLevelRowInfos(tasks);
+  top_level_rows_ = ExtractTopLevelRowInfos(tasks, app_state_->tasks());
   std::vector<TopLevelRowInfo*> sorted_infos;
   sorted_infos.reserve(top_level_rows_.size());
   for (auto& [task_id, info] : top_level_rows_) {
@@ -150,7 +194,7 @@ void TaskListModelBase::SetContent(const std::vector<Task>& tasks) noexcept {
       sorted_infos.begin(),
       sorted_infos.end(),
       [](const TopLevelRowInfo* first, const TopLevelRowInfo* second) {
-        return FirstTaskShouldPrecedeSecond(first->task, second->task);
+        return FirstTaskShouldPrecedeSecond(*first->task, *second->task);
       });
   for (TopLevelRowInfo* info : sorted_infos) {
     CreateTopLevelRowControls(info);
@@ -166,7 +210,7 @@ void TaskListModelBase::CreateTopLevelRowControls(
   } else {
     CreateParentRowControls(info);
   }
-  SetRowId(info->task_row, info->task);
+  SetRowId(info->task_row, *info->task);
 }
 
 void TaskListModelBase::CreateParentRowControls(
@@ -175,23 +219,28 @@ void TaskListModelBase::CreateParentRowControls(
 
   Glib::RefPtr<ChildTaskListModel> child_model =
       ChildTaskListModel::create<ChildTaskListModel>(
-          app_state_, *info->task.id(), should_display_archived_, this);
+          app_state_, *info->task->id(), should_display_archived_, this);
   VERIFY(!info->child_tasks.empty());
   info->child_list_box->bind_model(
       child_model,
       child_model->slot_create_widget());
   info->child_list_box->show();
-  child_model->SetContent(info->child_tasks);
+  std::vector<Task> child_tasks;
+  child_tasks.reserve(info->child_tasks.size());
+  for (const TaskRef& child_task : info->child_tasks) {
+    child_tasks.push_back(*child_task);
+  }
+  child_model->SetContent(std::move(child_tasks));
 
   GtkListBoxRow* row =
       reinterpret_cast<GtkListBoxRow*>(hdy_expander_row_new());
   g_object_ref_sink(row);
   Glib::RefPtr<Gtk::ListBoxRow> wrapped_row(Glib::wrap(row));
-  const std::string& title = info->task.name();
+  const std::string& title = info->task->name();
   hdy_preferences_row_set_title(
       reinterpret_cast<HdyPreferencesRow*>(wrapped_row->gobj()),
       title.c_str());
-  CustomizeRow(wrapped_row, info->task);
+  CustomizeRow(wrapped_row, *info->task);
   gtk_container_add(
       reinterpret_cast<GtkContainer*>(row),
       reinterpret_cast<GtkWidget*>(info->child_list_box->gobj()));
@@ -209,11 +258,11 @@ void TaskListModelBase::CreateNoChildToplevelRow(
   g_object_ref_sink(row);
   Glib::RefPtr<Gtk::ListBoxRow> wrapped_row(Glib::wrap(
       reinterpret_cast<GtkListBoxRow*>(row)));
-  const std::string& title = info->task.name();
+  const std::string& title = info->task->name();
   hdy_preferences_row_set_title(
       reinterpret_cast<HdyPreferencesRow*>(wrapped_row->gobj()),
       title.c_str());
-  CustomizeRow(wrapped_row, info->task);
+  CustomizeRow(wrapped_row, *info->task);
   wrapped_row->show();
   info->task_row = wrapped_row;
   info->child_list_box.reset();
@@ -241,22 +290,25 @@ Task::Id TaskListModelBase::GetTaskIdForRow(Gtk::ListBoxRow* row) noexcept {
 std::unordered_map<Task::Id,
                    std::unique_ptr<TaskListModelBase::TopLevelRowInfo>>
     TaskListModelBase::ExtractTopLevelRowInfos(
-        const std::vector<Task>& tasks) noexcept {
+        const std::vector<TaskRef>& tasks,
+        const TaskRepository& all_tasks) noexcept {
   std::unordered_map<Task::Id, std::unique_ptr<TopLevelRowInfo>>
       parent_task_id_to_info;
-  for (const Task& t : tasks) {
-    VERIFY(t.id());
-    if (!t.parent_task_id()) {
-      auto it = parent_task_id_to_info.find(*t.id());
+  for (const TaskRef& t : tasks) {
+    VERIFY(t->id());
+    if (!t->parent_task_id()) {
+      auto it = parent_task_id_to_info.find(*t->id());
       if (it == parent_task_id_to_info.end()) {
         parent_task_id_to_info.emplace(
-            *t.id(), std::make_unique<TopLevelRowInfo>(t));
+            *t->id(), std::make_unique<TopLevelRowInfo>(t));
       }
     }
   }
-  for (const Task& t : tasks) {
-    if (t.parent_task_id()) {
-      auto it = parent_task_id_to_info.find(*t.parent_task_id());
+  // Tasks of any depth are listed under their top-level ancestor.
+  for (const TaskRef& t : tasks) {
+    if (t->parent_task_id()) {
+      auto it = parent_task_id_to_info.find(
+          all_tasks.TopLevelAncestorId(*t->parent_task_id()));
       VERIFY(it != parent_task_id_to_info.end());
       it->second->child_tasks.emplace_back(t);
     }
@@ -339,8 +391,8 @@ TaskListModelBase::TopLevelRowInfo*
     const auto it = std::find_if(
         parent_row_info->child_tasks.begin(),
         parent_row_info->child_tasks.end(),
-        [child_task_id](const Task& t) {
-          return t.id() == child_task_id;
+        [child_task_id](const TaskRef& t) {
+          return t->id() == child_task_id;
         });
     if (it != parent_row_info->child_tasks.end()) {
       return parent_row_info.get();
@@ -349,36 +401,57 @@ TaskListModelBase::TopLevelRowInfo*
   return nullptr;
 }
 
-void TaskListModelBase::ExistingTaskChanged(const Task& t) noexcept {
+void TaskListModelBase::ExistingTaskChanged(const TaskRef& task) noexcept {
+  const Task& t = *task;
   VERIFY(t.id());
   const auto it_this_task = top_level_rows_.find(*t.id());
+  if (!app_state_->tasks().ChildIds(*t.id()).empty() &&
+      (t.parent_task_id() || it_this_task == top_level_rows_.end())) {
+    // Subtree of this task may move to other top-level row, and rows of
+    // its descendants show its name.
+    ReloadContent();
+    return;
+  }
   const bool should_remove = (t.is_archived() && !should_display_archived_);
+  std::optional<Task::Id> new_top_level_task_id;
+  if (t.parent_task_id()) {
+    new_top_level_task_id =
+        app_state_->tasks().TopLevelAncestorId(*t.parent_task_id());
+  }
 
   TopLevelRowInfo* old_parent_row_info =
       FindTopLevelRowInfoForChild(*t.id());
   if (old_parent_row_info &&
-      (old_parent_row_info->task.id() != t.parent_task_id() ||
+      (old_parent_row_info->task->id() != new_top_level_task_id ||
           should_remove)) {
     HandleTaskRemovedFromParent(old_parent_row_info, t);
   }
 
-  if (t.parent_task_id()) {
-    if (!old_parent_row_info ||
-        old_parent_row_info->task.id() != t.parent_task_id()) {
+  if (new_top_level_task_id) {
+    if (old_parent_row_info &&
+        old_parent_row_info->task->id() == new_top_level_task_id) {
+      // Child task remained in the same parent - replace its snapshot.
+      for (TaskRef& child_task : old_parent_row_info->child_tasks) {
+        if (child_task->id() == t.id()) {
+          child_task = task;
+        }
+      }
+    } else {
       // Task changed parent - ensure old and new parents have proper style
       // that is, has expander where neccessary.
       if (!should_remove) {
-        const auto it_new_parent = top_level_rows_.find(*t.parent_task_id());
+        const auto it_new_parent = top_level_rows_.find(
+            *new_top_level_task_id);
         VERIFY(it_new_parent != top_level_rows_.end());
-        HandleTaskAddedToParent(it_new_parent->second.get(), t);
+        HandleTaskAddedToParent(it_new_parent->second.get(), task);
       }
     }
     if (it_this_task == top_level_rows_.end()) {
       // Child task remained child.
       return;
     }
-    // Top-level task become child.
-    // Only one level in hiearchy supported.
+    // Top-level task become child. Tasks with children are handled by
+    // |ReloadContent| above.
     VERIFY(it_this_task->second->child_tasks.empty());
     const guint item_pos = FindItem(*it_this_task->second);
     remove(item_pos);
@@ -398,7 +471,7 @@ void TaskListModelBase::ExistingTaskChanged(const Task& t) noexcept {
           reinterpret_cast<HdyPreferencesRow*>(
               it_this_task->second->task_row->gobj()),
           t.name().c_str());
-      it_this_task->second->task = t;
+      it_this_task->second->task = task;
 
       const guint prev_pos = FindItem(*it_this_task->second);
       guint new_pos = ComputePositionForTopLevelTask(t);
@@ -416,7 +489,7 @@ void TaskListModelBase::ExistingTaskChanged(const Task& t) noexcept {
   } else {
     if (!should_remove) {
       // Task were not top-level, but become such.
-      AfterTaskAdded(t);
+      AfterTaskAdded(task);
     }
   }
 }
@@ -427,8 +500,8 @@ void TaskListModelBase::HandleTaskRemovedFromParent(
   const auto it = std::find_if(
       old_parent_row_info->child_tasks.begin(),
       old_parent_row_info->child_tasks.end(),
-      [task_id = *t.id()](const Task& child) {
-        return child.id() == task_id;
+      [task_id = *t.id()](const TaskRef& child) {
+        return child->id() == task_id;
       });
   VERIFY(it != old_parent_row_info->child_tasks.end());
   old_parent_row_info->child_tasks.erase(it);
@@ -437,16 +510,16 @@ void TaskListModelBase::HandleTaskRemovedFromParent(
 
 void TaskListModelBase::HandleTaskAddedToParent(
     TopLevelRowInfo* new_parent_row_info,
-    const Task& t) noexcept {
+    const TaskRef& task) noexcept {
   const auto it = std::find_if(
       new_parent_row_info->child_tasks.begin(),
       new_parent_row_info->child_tasks.end(),
-      [task_id = *t.id()](const Task& child) {
-        return child.id() == task_id;
+      [task_id = *task->id()](const TaskRef& child) {
+        return child->id() == task_id;
       });
   // No duplication allowed.
   VERIFY(it == new_parent_row_info->child_tasks.end());
-  new_parent_row_info->child_tasks.emplace_back(t);
+  new_parent_row_info->child_tasks.push_back(task);
   EnsureProperTopLevelControlStyle(new_parent_row_info);
 }
 
@@ -474,34 +547,38 @@ void TaskListModelBase::EnsureProperTopLevelControlStyle(
   }
 }
 
-void TaskListModelBase::AfterTaskAdded(const Task& t) noexcept {
+void TaskListModelBase::AfterTaskAdded(const TaskRef& task) noexcept {
+  const Task& t = *task;
   VERIFY(t.id());
   if (t.is_archived() && !should_display_archived_) {
     return;
   }
   if (t.parent_task_id()) {
-    const auto it = top_level_rows_.find(*t.parent_task_id());
+    const auto it = top_level_rows_.find(
+        app_state_->tasks().TopLevelAncestorId(*t.parent_task_id()));
     VERIFY(it != top_level_rows_.end());
-    HandleTaskAddedToParent(it->second.get(), t);
+    HandleTaskAddedToParent(it->second.get(), task);
     // All other will be handled by ChildTaskListModel.
     return;
   }
   const auto [it, added_ok] = top_level_rows_.emplace(
-      *t.id(), std::make_unique<TopLevelRowInfo>(t));
+      *t.id(), std::make_unique<TopLevelRowInfo>(task));
   VERIFY(added_ok);
   CreateTopLevelRowControls(it->second.get());
   const guint item_pos = ComputePositionForTopLevelTask(t);
   insert(item_pos, it->second->task_row);
 }
 
-void TaskListModelBase::BeforeTaskDeleted(const Task& t) noexcept {
+void TaskListModelBase::BeforeTaskDeleted(const TaskRef& task) noexcept {
+  const Task& t = *task;
   VERIFY(t.id());
   if (t.is_archived() && !should_display_archived_) {
     // Task should be absent in this control.
     return;
   }
   if (t.parent_task_id()) {
-    const auto it = top_level_rows_.find(*t.parent_task_id());
+    const auto it = top_level_rows_.find(
+        app_state_->tasks().TopLevelAncestorId(*t.parent_task_id()));
     VERIFY(it != top_level_rows_.end());
     HandleTaskRemovedFromParent(it->second.get(), t);
     // All other will be handled by ChildTaskListModel.
@@ -548,19 +625,19 @@ void TaskListModelBase::SelectTask(
     const TaskListModelBase::TopLevelRowInfo* parent_row_info =
         TaskListModelBase::FindTopLevelRowInfoForChild(*new_selected_task_id);
     VERIFY(parent_row_info);
-    const auto it_child = std::find_if(
-        parent_row_info->child_tasks.begin(),
-        parent_row_info->child_tasks.end(),
-        [new_selected_task_id](const Task& t) {
-          return t.id() == new_selected_task_id;
-        });
-    VERIFY(it_child != parent_row_info->child_tasks.end());
     UnselectAllChilListBoxesExcept(
         parent_row_info->child_list_box.get());
-    Gtk::ListBoxRow* child_list_box_row =
-        parent_row_info->child_list_box->get_row_at_index(
-            static_cast<int>(it_child - parent_row_info->child_tasks.begin()));
-    VERIFY(child_list_box_row);
+    // Child list is sorted by ChildTaskListModel, so look for the row with
+    // task id rather than rely on order of |child_tasks|.
+    Gtk::ListBoxRow* child_list_box_row = nullptr;
+    for (int i = 0; !child_list_box_row; ++i) {
+      Gtk::ListBoxRow* row =
+          parent_row_info->child_list_box->get_row_at_index(i);
+      VERIFY(row);
+      if (ChildTaskListModel::GetObjectIdForRow(row) == new_selected_task_id) {
+        child_list_box_row = row;
+      }
+    }
     parent_row_info->child_list_box->select_row(
         *child_list_box_row);
   }
@@ -571,7 +648,7 @@ guint TaskListModelBase::ComputePositionForTopLevelTask(
     const Task& t) const noexcept {
   guint result = 0;
   for (const auto& [id, info] : top_level_rows_) {
-    if (FirstTaskShouldPrecedeSecond(info->task, t)) {
+    if (FirstTaskShouldPrecedeSecond(*info->task, t)) {
       ++result;
     }
   }
@@ -18,6 +18,7 @@ namespace m_time_tracker {
 
 class AppState;
 class ChildTaskListModel;
+class TaskRepository;
 
 class TaskListModelBase: public Gio::ListStore<Gtk::Widget> {
  public:
@@ -66,16 +67,17 @@ class TaskListModelBase: public Gio::ListStore<Gtk::Widget> {
 
  private:
   struct TopLevelRowInfo {
-    explicit TopLevelRowInfo(Task t) noexcept
-        : task(t) {}
+    explicit TopLevelRowInfo(TaskRef t) noexcept
+        : task(std::move(t)) {}
     TopLevelRowInfo(const TopLevelRowInfo&) = delete;
     const TopLevelRowInfo& operator=(const TopLevelRowInfo&) = delete;
 
-    Task task;
+    TaskRef task;
     Glib::RefPtr<Gtk::ListBox> child_list_box;
     Glib::RefPtr<Gtk::ListBoxRow> task_row;
-    // May be empty if this task does not have children.
-    std::vector<Task> child_tasks;
+    // All descendants of this task, not only direct children. May be empty
+    // if this task does not have children.
+    std::vector<TaskRef> child_tasks;
   };
 
   sigc::slot<Gtk::Widget*(const Glib::RefPtr<Glib::Object>)>
@@ -92,13 +94,17 @@ class TaskListModelBase: public Gio::ListStore<Gtk::Widget> {
   }
 
   static std::unordered_map<Task::Id, std::unique_ptr<TopLevelRowInfo>>
-      ExtractTopLevelRowInfos(const std::vector<Task>& tasks) noexcept;
-  void SetContent(const std::vector<Task>& tasks) noexcept;
+      ExtractTopLevelRowInfos(
+          const std::vector<TaskRef>& tasks,
+          const TaskRepository& all_tasks) noexcept;
+  // Re-creates all rows, keeping selected task if it is still displayed.
+  void ReloadContent() noexcept;
+  void SetContent(const std::vector<TaskRef>& tasks) noexcept;
   void SetRowId(Glib::RefPtr<Gtk::Widget> task_row, const Task& t) noexcept;
 
-  void ExistingTaskChanged(const Task& t) noexcept;
-  void AfterTaskAdded(const Task& t) noexcept;
-  void BeforeTaskDeleted(const Task& t) noexcept;
+  void ExistingTaskChanged(const TaskRef& task) noexcept;
+  void AfterTaskAdded(const TaskRef& task) noexcept;
+  void BeforeTaskDeleted(const TaskRef& task) noexcept;
 
   void OnChildTaskListRowSelected(Gtk::ListBoxRow* row) noexcept;
   void OnMainTaskListRowSelected(Gtk::ListBoxRow* row) noexcept;
@@ -109,7 +115,7 @@ class TaskListModelBase: public Gio::ListStore<Gtk::Widget> {
 
   void HandleTaskAddedToParent(
       TopLevelRowInfo* new_parent_row_info,
-      const Task& t) noexcept;
+      const TaskRef& task) noexcept;
   void HandleTaskRemovedFromParent(
       TopLevelRowInfo* new_parent_row_info,
       const Task& t) noexcept;
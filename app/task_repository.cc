@@ -0,0 +1,110 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#include "app/task_repository.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "app/verify.h"
+
+namespace m_time_tracker {
+
+// static
+outcome::std_result<TaskRepository> TaskRepository::Load(
+    Database* db) noexcept {
+  auto maybe_tasks = Task::LoadAll(db);
+  if (!maybe_tasks) {
+    return maybe_tasks.error();
+  }
+  TaskRepository result;
+  for (const Task& task : maybe_tasks.value()) {
+    result.Put(task);
+  }
+  return result;
+}
+
+TaskRef TaskRepository::FindById(Task::Id id) const noexcept {
+  const auto it = tasks_by_id_.find(id);
+  return (it != tasks_by_id_.end()) ? it->second : nullptr;
+}
+
+TaskRef TaskRepository::FindByName(std::string_view name) const noexcept {
+  const auto it = ids_by_name_.find(name);
+  return (it != ids_by_name_.end()) ? FindById(it->second) : nullptr;
+}
+
+std::vector<TaskRef> TaskRepository::All() const noexcept {
+  std::vector<TaskRef> result;
+  result.reserve(tasks_by_id_.size());
+  for (const auto& [id, task] : tasks_by_id_) {
+    result.push_back(task);
+  }
+  std::sort(
+      result.begin(),
+      result.end(),
+      [](const TaskRef& first, const TaskRef& second) {
+        return *first->id() < *second->id();
+      });
+  return result;
+}
+
+const std::set<Task::Id>& TaskRepository::ChildIds(
+    std::optional<Task::Id> parent_task_id) const noexcept {
+  static const std::set<Task::Id> kNoChildren;
+  const auto it = child_ids_by_parent_.find(parent_task_id);
+  return (it != child_ids_by_parent_.end()) ? it->second : kNoChildren;
+}
+
+Task::Id TaskRepository::TopLevelAncestorId(Task::Id id) const noexcept {
+  TaskRef task = FindById(id);
+  VERIFY(task);
+  while (task->parent_task_id()) {
+    task = FindById(*task->parent_task_id());
+    VERIFY(task);
+  }
+  return *task->id();
+}
+
+bool TaskRepository::IsInSubtree(
+    Task::Id id, Task::Id ancestor_id) const noexcept {
+  std::optional<Task::Id> current_id = id;
+  while (current_id) {
+    if (*current_id == ancestor_id) {
+      return true;
+    }
+    const TaskRef task = FindById(*current_id);
+    VERIFY(task);
+    current_id = task->parent_task_id();
+  }
+  return false;
+}
+
+const TaskRef& TaskRepository::Put(const Task& task) noexcept {
+  VERIFY(task.id());
+  const Task::Id id = *task.id();
+  TaskRef& stored = tasks_by_id_[id];
+  if (stored) {
+    const Task& old_task = *stored;
+    // Key points to the old snapshot, so it must be removed even if name
+    // is not changed.
+    VERIFY(ids_by_name_.erase(old_task.name()) == 1);
+    if (old_task.parent_task_id() != task.parent_task_id()) {
+      const auto it_siblings =
+          child_ids_by_parent_.find(old_task.parent_task_id());
+      VERIFY(it_siblings != child_ids_by_parent_.end());
+      VERIFY(it_siblings->second.erase(id) == 1);
+      if (it_siblings->second.empty()) {
+        child_ids_by_parent_.erase(it_siblings);
+      }
+    }
+  }
+  stored = std::make_shared<const Task>(task);
+  // Names are unique in DB.
+  VERIFY(ids_by_name_.emplace(stored->name(), id).second);
+  child_ids_by_parent_[task.parent_task_id()].insert(id);
+  return stored;
+}
+
+}  // namespace m_time_tracker
@@ -0,0 +1,71 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "app/database.h"
+#include "app/error_codes.h"
+#include "app/task.h"
+
+namespace m_time_tracker {
+
+// In-memory copy of all tasks, indexed by id, name and parent, so
+// lookups don't touch DB. There are few tasks, and they are never
+// deleted, so all of them are loaded once. Saved tasks must be passed
+// to |Put| to keep the copy coherent.
+// Must be used only from the thread, that owns it.
+class TaskRepository {
+ public:
+  static outcome::std_result<TaskRepository> Load(Database* db) noexcept;
+
+  TaskRepository(TaskRepository&&) = default;
+  TaskRepository& operator = (TaskRepository&&) = default;
+
+  TaskRepository(const TaskRepository&) = delete;
+  TaskRepository& operator = (const TaskRepository&) = delete;
+
+  // Return nullptr if there is no such task. Returned snapshots are not
+  // changed by |Put|.
+  TaskRef FindById(Task::Id id) const noexcept;
+  TaskRef FindByName(std::string_view name) const noexcept;
+  // Ordered by id.
+  std::vector<TaskRef> All() const noexcept;
+
+  // Direct children of |parent_task_id| or, if it is not set, top-level
+  // tasks, ordered by id.
+  const std::set<Task::Id>& ChildIds(
+      std::optional<Task::Id> parent_task_id) const noexcept;
+  // Id of the top-level task, whose subtree contains task |id|. That is
+  // |id| itself for top-level tasks. Task |id| must be present.
+  Task::Id TopLevelAncestorId(Task::Id id) const noexcept;
+  // True if task |id| is |ancestor_id| or one of its descendants.
+  bool IsInSubtree(Task::Id id, Task::Id ancestor_id) const noexcept;
+
+  size_t size() const noexcept {
+    return tasks_by_id_.size();
+  }
+
+  // Adds saved |task| or replaces snapshot of its previous version.
+  // Returns the new snapshot.
+  const TaskRef& Put(const Task& task) noexcept;
+
+ private:
+  TaskRepository() noexcept = default;
+
+  std::unordered_map<Task::Id, TaskRef> tasks_by_id_;
+  // Keys point to names of snapshots in |tasks_by_id_|, so names are not
+  // copied.
+  std::unordered_map<std::string_view, Task::Id> ids_by_name_;
+  std::unordered_map<std::optional<Task::Id>, std::set<Task::Id>>
+      child_ids_by_parent_;
+};
+
+}  // namespace m_time_tracker
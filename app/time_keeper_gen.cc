@@ -0,0 +1,194 @@
+// Copyright 2022 The "TimeKeeper" project authors. All rights reserved.
+// Use of this source code is governed by a GPLv3 license that can be
+// found in the LICENSE file.
+
+// Writes synthetic database, that looks like years of real use, e.g.
+//   time_keeper_gen --output=/tmp/big.dat --activities=10000000 --years=10
+// Result may be opened with the application by copying it to
+// ~/.time_keeper/data.dat.
+
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "app/database.h"
+#include "app/history_generator.h"
+#include "app/schema_migrations.h"
+
+namespace {
+
+using m_time_tracker::HistoryGeneratorParams;
+
+constexpr std::string_view kUsage =
+    "Usage: time_keeper_gen --output=PATH [options]\n"
+    "Options:\n"
+    "  --seed=N               Random seed (default 1)\n"
+    "  --tasks=N[,N...]       Task count on each hierarchy level,\n"
+    "                         starting from top-level (default 40,260)\n"
+    "  --archived=F           Fraction of archived tasks (default 0.3)\n"
+    "  --activities=N         Activity count (default 100000)\n"
+    "  --start=UNIX_TIME      Start of history (default 2015-01-01)\n"
+    "  --years=N              History length (default 5)\n";
+
+template<typename T>
+std::optional<T> ParseNumber(std::string_view text) noexcept {
+  T result{};
+  const char* end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, result);
+  if (ec != std::errc() || ptr != end) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+// std::from_chars for floating point is not available in all supported
+// standard libraries.
+std::optional<double> ParseFraction(std::string_view text) noexcept {
+  const std::string str(text);
+  char* end = nullptr;
+  const double result = std::strtod(str.c_str(), &end);
+  if (str.empty() || *end != '\0' || result < 0 || result > 1) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+std::optional<std::vector<int>> ParseTaskCounts(
+    std::string_view text) noexcept {
+  std::vector<int> result;
+  while (true) {
+    const size_t comma_pos = text.find(',');
+    const auto count = ParseNumber<int>(text.substr(0, comma_pos));
+    if (!count || *count <= 0) {
+      return std::nullopt;
+    }
+    result.push_back(*count);
+    if (comma_pos == std::string_view::npos) {
+      return result;
+    }
+    text.remove_prefix(comma_pos + 1);
+  }
+}
+
+// Returns false if arguments are malformed.
+bool ParseArgs(
+    int argc,
+    char* argv[],
+    std::filesystem::path* output,
+    HistoryGeneratorParams* params) noexcept {
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+    const size_t eq_pos = arg.find('=');
+    if (eq_pos == std::string_view::npos) {
+      return false;
+    }
+    const std::string_view name = arg.substr(0, eq_pos);
+    const std::string_view value = arg.substr(eq_pos + 1);
+    bool ok = false;
+    if (name == "--output") {
+      *output = std::filesystem::path(std::string(value));
+      ok = !value.empty();
+    } else if (name == "--seed") {
+      const auto seed = ParseNumber<uint64_t>(value);
+      if (seed) {
+        params->seed = *seed;
+        ok = true;
+      }
+    } else if (name == "--tasks") {
+      auto counts = ParseTaskCounts(value);
+      if (counts) {
+        params->tasks_per_level = std::move(*counts);
+        ok = true;
+      }
+    } else if (name == "--archived") {
+      const auto fraction = ParseFraction(value);
+      if (fraction) {
+        params->archived_fraction = *fraction;
+        ok = true;
+      }
+    } else if (name == "--activities") {
+      const auto count = ParseNumber<int64_t>(value);
+      if (count && *count >= 0) {
+        params->activity_count = *count;
+        ok = true;
+      }
+    } else if (name == "--start") {
+      const auto start = ParseNumber<int64_t>(value);
+      if (start) {
+        params->history_start =
+            m_time_tracker::Activity::TimePointFromInt(*start);
+        ok = true;
+      }
+    } else if (name == "--years") {
+      const auto years = ParseNumber<int>(value);
+      if (years && *years > 0) {
+        params->history_span = std::chrono::hours(24 * 365) * (*years);
+        ok = true;
+      }
+    }
+    if (!ok) {
+      return false;
+    }
+  }
+  return !output->empty();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  using m_time_tracker::Database;
+
+  std::filesystem::path output;
+  HistoryGeneratorParams params;
+  if (!ParseArgs(argc, argv, &output, &params)) {
+    std::cerr << kUsage;
+    return 1;
+  }
+  // Protects real databases from being accidentally filled with garbage.
+  if (std::filesystem::exists(output)) {
+    std::cerr << "File " << output.native() << " already exists" << std::endl;
+    return 1;
+  }
+  const auto start_time = std::chrono::steady_clock::now();
+  Database::Options options = Database::Options::Desktop();
+  // Result is useless if generation is interrupted anyway. Rollback
+  // journal avoids writing appended pages twice, as WAL does; application
+  // switches DB to WAL mode on open.
+  options.synchronous = Database::Options::Synchronous::kOff;
+  options.journal_mode = Database::Options::JournalMode::kDelete;
+  auto maybe_db = Database::Open(output, options);
+  if (!maybe_db) {
+    std::cerr << "Failed open database " << output.native() << ": "
+              << maybe_db.error().message() << std::endl;
+    return 1;
+  }
+  Database& db = maybe_db.value();
+  auto upgrade_result = m_time_tracker::UpgradeSchema(&db);
+  if (!upgrade_result) {
+    std::cerr << "Failed create tables: "
+              << upgrade_result.error().message() << std::endl;
+    return 1;
+  }
+  auto maybe_history = m_time_tracker::GenerateHistory(&db, params);
+  if (!maybe_history) {
+    std::cerr << "Failed generate history: "
+              << maybe_history.error().message() << std::endl;
+    return 1;
+  }
+  size_t task_count = 0;
+  for (const auto& level_tasks : maybe_history.value().tasks_by_level) {
+    task_count += level_tasks.size();
+  }
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start_time);
+  std::cout << "Generated " << task_count << " tasks and "
+            << params.activity_count << " activities in "
+            << elapsed.count() << " ms" << std::endl;
+  return 0;
+}